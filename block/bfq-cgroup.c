@@ -296,6 +296,9 @@ static void bfqg_stats_reset(struct bfqg_stats *stats)
 	blkg_stat_reset(&stats->idle_time);
 	blkg_stat_reset(&stats->empty_time);
 #endif
+	blkg_stat_reset(&stats->launch_time);
+	blkg_stat_reset(&stats->launch_ios);
+	blkg_stat_reset(&stats->launch_wait_time);
 }
 
 /* @to += @from */
@@ -318,6 +321,9 @@ static void bfqg_stats_add_aux(struct bfqg_stats *to, struct bfqg_stats *from)
 	blkg_stat_add_aux(&to->idle_time, &from->idle_time);
 	blkg_stat_add_aux(&to->empty_time, &from->empty_time);
 #endif
+	blkg_stat_add_aux(&to->launch_time, &from->launch_time);
+	blkg_stat_add_aux(&to->launch_ios, &from->launch_ios);
+	blkg_stat_add_aux(&to->launch_wait_time, &from->launch_wait_time);
 }
 
 /*
@@ -377,6 +383,9 @@ static void bfqg_stats_exit(struct bfqg_stats *stats)
 	blkg_stat_exit(&stats->idle_time);
 	blkg_stat_exit(&stats->empty_time);
 #endif
+	blkg_stat_exit(&stats->launch_time);
+	blkg_stat_exit(&stats->launch_ios);
+	blkg_stat_exit(&stats->launch_wait_time);
 }
 
 static int bfqg_stats_init(struct bfqg_stats *stats, gfp_t gfp)
@@ -397,6 +406,12 @@ static int bfqg_stats_init(struct bfqg_stats *stats, gfp_t gfp)
 		return -ENOMEM;
 	}
 #endif
+	if (blkg_stat_init(&stats->launch_time, gfp) ||
+	    blkg_stat_init(&stats->launch_ios, gfp) ||
+	    blkg_stat_init(&stats->launch_wait_time, gfp)) {
+		bfqg_stats_exit(stats);
+		return -ENOMEM;
+	}
 
 	return 0;
 }
@@ -411,6 +426,38 @@ static struct bfq_group_data *blkcg_to_bfqgd(struct blkcg *blkcg)
 	return cpd_to_bfqgd(blkcg_to_cpd(blkcg, &blkcg_policy_bfq));
 }
 
+void bfqg_stats_update_launch_time(struct bfq_group *bfqg, u64 time_ns)
+{
+	blkg_stat_add(&bfqg->stats.launch_time, time_ns);
+}
+
+void bfqg_stats_update_launch_io(struct bfq_group *bfqg, u64 start_time_ns)
+{
+	u64 now = ktime_get_ns();
+
+	blkg_stat_add(&bfqg->stats.launch_ios, 1);
+	if (time_after64(now, start_time_ns))
+		blkg_stat_add(&bfqg->stats.launch_wait_time,
+			      now - start_time_ns);
+}
+
+/*
+ * Whether the blkcg of the group of @bfqq has been told, through
+ * bfq.launch, that it is launching an application.
+ */
+bool bfq_bfqq_launching(struct bfq_queue *bfqq)
+{
+	struct blkcg_gq *blkg = bfqg_to_blkg(bfqq_group(bfqq));
+	struct bfq_group_data *bfqgd = blkcg_to_bfqgd(blkg->blkcg);
+	unsigned long until;
+
+	if (!bfqgd)
+		return false;
+
+	until = READ_ONCE(bfqgd->launch_until);
+	return until && time_before(jiffies, until);
+}
+
 static struct blkcg_policy_data *bfq_cpd_alloc(gfp_t gfp)
 {
 	struct bfq_group_data *bgd;
@@ -918,18 +965,47 @@ static ssize_t bfq_io_set_weight(struct kernfs_open_file *of,
 	return ret ?: nbytes;
 }
 
-#ifdef CONFIG_DEBUG_BLK_CGROUP
-static int bfqg_print_stat(struct seq_file *sf, void *v)
+static int bfq_io_show_launch(struct seq_file *sf, void *v)
 {
-	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)), blkg_prfill_stat,
-			  &blkcg_policy_bfq, seq_cft(sf)->private, false);
+	struct blkcg *blkcg = css_to_blkcg(seq_css(sf));
+	struct bfq_group_data *bfqgd = blkcg_to_bfqgd(blkcg);
+	unsigned long until = 0;
+
+	if (bfqgd)
+		until = READ_ONCE(bfqgd->launch_until);
+	if (until && time_before(jiffies, until))
+		seq_printf(sf, "%u\n", jiffies_to_msecs(until - jiffies));
+	else
+		seq_puts(sf, "0\n");
+
 	return 0;
 }
 
-static int bfqg_print_rwstat(struct seq_file *sf, void *v)
+/*
+ * Mark the blkcg as launching an application for the next @val ms, or
+ * clear the mark if @val is 0. Its queues get weight-raised as
+ * interactive and idled for until then.
+ */
+static int bfq_io_set_launch(struct cgroup_subsys_state *css,
+			     struct cftype *cftype, u64 val)
 {
-	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)), blkg_prfill_rwstat,
-			  &blkcg_policy_bfq, seq_cft(sf)->private, true);
+	struct bfq_group_data *bfqgd = blkcg_to_bfqgd(css_to_blkcg(css));
+	unsigned long until = 0;
+
+	if (val > BFQ_LAUNCH_MAX_MS)
+		return -ERANGE;
+
+	if (val)
+		until = (jiffies + msecs_to_jiffies(val)) ?: 1;
+	WRITE_ONCE(bfqgd->launch_until, until);
+
+	return 0;
+}
+
+static int bfqg_print_stat(struct seq_file *sf, void *v)
+{
+	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)), blkg_prfill_stat,
+			  &blkcg_policy_bfq, seq_cft(sf)->private, false);
 	return 0;
 }
 
@@ -941,6 +1017,49 @@ static u64 bfqg_prfill_stat_recursive(struct seq_file *sf,
 	return __blkg_prfill_u64(sf, pd, sum);
 }
 
+static int bfqg_print_stat_recursive(struct seq_file *sf, void *v)
+{
+	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)),
+			  bfqg_prfill_stat_recursive, &blkcg_policy_bfq,
+			  seq_cft(sf)->private, false);
+	return 0;
+}
+
+static u64 bfqg_prfill_launch_stat(struct seq_file *sf,
+				   struct blkg_policy_data *pd, int off)
+{
+	struct blkcg_gq *blkg = pd_to_blkg(pd);
+	const char *dname = blkg_dev_name(blkg);
+
+	if (!dname)
+		return 0;
+
+	seq_printf(sf, "%s time=%llu ios=%llu wait_time=%llu\n", dname,
+		   blkg_stat_recursive_sum(blkg, &blkcg_policy_bfq,
+			offsetof(struct bfq_group, stats.launch_time)),
+		   blkg_stat_recursive_sum(blkg, &blkcg_policy_bfq,
+			offsetof(struct bfq_group, stats.launch_ios)),
+		   blkg_stat_recursive_sum(blkg, &blkcg_policy_bfq,
+			offsetof(struct bfq_group, stats.launch_wait_time)));
+	return 0;
+}
+
+/* launch stats of the unified hierarchy, which are all recursive */
+static int bfqg_print_launch_stat(struct seq_file *sf, void *v)
+{
+	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)),
+			  bfqg_prfill_launch_stat, &blkcg_policy_bfq, 0, false);
+	return 0;
+}
+
+#ifdef CONFIG_DEBUG_BLK_CGROUP
+static int bfqg_print_rwstat(struct seq_file *sf, void *v)
+{
+	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)), blkg_prfill_rwstat,
+			  &blkcg_policy_bfq, seq_cft(sf)->private, true);
+	return 0;
+}
+
 static u64 bfqg_prfill_rwstat_recursive(struct seq_file *sf,
 					struct blkg_policy_data *pd, int off)
 {
@@ -950,14 +1069,6 @@ static u64 bfqg_prfill_rwstat_recursive(struct seq_file *sf,
 	return __blkg_prfill_rwstat(sf, pd, &sum);
 }
 
-static int bfqg_print_stat_recursive(struct seq_file *sf, void *v)
-{
-	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)),
-			  bfqg_prfill_stat_recursive, &blkcg_policy_bfq,
-			  seq_cft(sf)->private, false);
-	return 0;
-}
-
 static int bfqg_print_rwstat_recursive(struct seq_file *sf, void *v)
 {
 	blkcg_print_blkgs(sf, css_to_blkcg(seq_css(sf)),
@@ -1059,6 +1170,12 @@ struct cftype bfq_blkcg_legacy_files[] = {
 		.seq_show = bfq_io_show_weight,
 		.write_u64 = bfq_io_set_weight_legacy,
 	},
+	{
+		.name = "bfq.launch",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = bfq_io_show_launch,
+		.write_u64 = bfq_io_set_launch,
+	},
 
 	/* statistics, covers only the tasks in the bfqg */
 	{
@@ -1071,6 +1188,21 @@ struct cftype bfq_blkcg_legacy_files[] = {
 		.private = (unsigned long)&blkcg_policy_bfq,
 		.seq_show = blkg_print_stat_ios,
 	},
+	{
+		.name = "bfq.launch_time",
+		.private = offsetof(struct bfq_group, stats.launch_time),
+		.seq_show = bfqg_print_stat,
+	},
+	{
+		.name = "bfq.launch_ios",
+		.private = offsetof(struct bfq_group, stats.launch_ios),
+		.seq_show = bfqg_print_stat,
+	},
+	{
+		.name = "bfq.launch_wait_time",
+		.private = offsetof(struct bfq_group, stats.launch_wait_time),
+		.seq_show = bfqg_print_stat,
+	},
 #ifdef CONFIG_DEBUG_BLK_CGROUP
 	{
 		.name = "bfq.time",
@@ -1114,6 +1246,21 @@ struct cftype bfq_blkcg_legacy_files[] = {
 		.private = (unsigned long)&blkcg_policy_bfq,
 		.seq_show = blkg_print_stat_ios_recursive,
 	},
+	{
+		.name = "bfq.launch_time_recursive",
+		.private = offsetof(struct bfq_group, stats.launch_time),
+		.seq_show = bfqg_print_stat_recursive,
+	},
+	{
+		.name = "bfq.launch_ios_recursive",
+		.private = offsetof(struct bfq_group, stats.launch_ios),
+		.seq_show = bfqg_print_stat_recursive,
+	},
+	{
+		.name = "bfq.launch_wait_time_recursive",
+		.private = offsetof(struct bfq_group, stats.launch_wait_time),
+		.seq_show = bfqg_print_stat_recursive,
+	},
 #ifdef CONFIG_DEBUG_BLK_CGROUP
 	{
 		.name = "bfq.time_recursive",
@@ -1179,6 +1326,16 @@ struct cftype bfq_blkg_files[] = {
 		.seq_show = bfq_io_show_weight,
 		.write = bfq_io_set_weight,
 	},
+	{
+		.name = "bfq.launch",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = bfq_io_show_launch,
+		.write_u64 = bfq_io_set_launch,
+	},
+	{
+		.name = "bfq.launch_stat",
+		.seq_show = bfqg_print_launch_stat,
+	},
 	{} /* terminate */
 };
 
@@ -1202,6 +1359,14 @@ void bfq_init_entity(struct bfq_entity *entity, struct bfq_group *bfqg)
 
 void bfq_bic_update_cgroup(struct bfq_io_cq *bic, struct bio *bio) {}
 
+void bfqg_stats_update_launch_time(struct bfq_group *bfqg, u64 time_ns) { }
+void bfqg_stats_update_launch_io(struct bfq_group *bfqg, u64 start_time_ns) { }
+
+bool bfq_bfqq_launching(struct bfq_queue *bfqq)
+{
+	return false;
+}
+
 void bfq_end_wr_async(struct bfq_data *bfqd)
 {
 	bfq_end_wr_async_queues(bfqd, bfqd->root_group);
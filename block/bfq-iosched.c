@@ -166,6 +166,7 @@ BFQ_BFQQ_FNS(in_large_burst);
 BFQ_BFQQ_FNS(coop);
 BFQ_BFQQ_FNS(split_coop);
 BFQ_BFQQ_FNS(softrt_update);
+BFQ_BFQQ_FNS(launch_wr);
 #undef BFQ_BFQQ_FNS						\
 
 /* Expiration time of sync (0) and async (1) requests, in ns. */
@@ -1426,6 +1427,29 @@ static unsigned long bfq_smallest_from_now(void)
 	return jiffies - MAX_JIFFY_OFFSET;
 }
 
+/*
+ * Weight raising granted for a launch hint is accounted, as raised time,
+ * in the stats of the group of the queue, until it ends.
+ */
+static void bfq_bfqq_launch_wr_start(struct bfq_queue *bfqq)
+{
+	if (bfqq->wr_coeff == 1 || bfq_bfqq_launch_wr(bfqq))
+		return;
+
+	bfqq->launch_wr_start = jiffies;
+	bfq_mark_bfqq_launch_wr(bfqq);
+}
+
+static void bfq_bfqq_launch_wr_end(struct bfq_queue *bfqq)
+{
+	if (!bfq_bfqq_launch_wr(bfqq))
+		return;
+
+	bfq_clear_bfqq_launch_wr(bfqq);
+	bfqg_stats_update_launch_time(bfqq_group(bfqq),
+		jiffies_to_nsecs(jiffies - bfqq->launch_wr_start));
+}
+
 static void bfq_update_bfqq_wr_on_rq_arrival(struct bfq_data *bfqd,
 					     struct bfq_queue *bfqq,
 					     unsigned int old_wr_coeff,
@@ -1539,7 +1563,7 @@ static void bfq_bfqq_handle_idle_busy_switch(struct bfq_data *bfqd,
 					     bool *interactive)
 {
 	bool soft_rt, in_burst,	wr_or_deserves_wr,
-		bfqq_wants_to_preempt,
+		bfqq_wants_to_preempt, launching = bfq_bfqq_launching(bfqq),
 		idle_for_long_time = bfq_bfqq_idle_for_long_time(bfqd, bfqq),
 		/*
 		 * See the comments on
@@ -1563,7 +1587,13 @@ static void bfq_bfqq_handle_idle_busy_switch(struct bfq_data *bfqd,
 		!in_burst &&
 		time_is_before_jiffies(bfqq->soft_rt_next_start) &&
 		bfqq->dispatched == 0;
-	*interactive = !in_burst && idle_for_long_time;
+	/*
+	 * The queues of a group launching an application, as told by
+	 * userspace, are deemed interactive right away, whether or not
+	 * they have been idle for long or belong to a large burst: the
+	 * burst may just be the package installs going on alongside.
+	 */
+	*interactive = launching || (!in_burst && idle_for_long_time);
 	wr_or_deserves_wr = bfqd->low_latency &&
 		(bfqq->wr_coeff > 1 ||
 		 (bfq_bfqq_sync(bfqq) &&
@@ -1630,6 +1660,8 @@ static void bfq_bfqq_handle_idle_busy_switch(struct bfq_data *bfqd,
 
 			if (old_wr_coeff != bfqq->wr_coeff)
 				bfqq->entity.prio_changed = 1;
+			if (launching)
+				bfq_bfqq_launch_wr_start(bfqq);
 		}
 	}
 
@@ -1697,6 +1729,23 @@ static void bfq_add_request(struct request *rq)
 			bfqd->wr_busy_queues++;
 			bfqq->entity.prio_changed = 1;
 		}
+		/*
+		 * A sync queue already busy when its group starts
+		 * launching gets raised as soon as it gets a request,
+		 * rather than on its next idle-to-busy switch.
+		 */
+		if (bfqd->low_latency && old_wr_coeff == 1 &&
+		    bfq_bfqq_sync(bfqq) && bfqq->bic &&
+		    bfq_bfqq_launching(bfqq)) {
+			bfqq->service_from_wr = 0;
+			bfqq->wr_coeff = bfqd->bfq_wr_coeff;
+			bfqq->wr_cur_max_time = bfq_wr_duration(bfqd);
+
+			bfqd->wr_busy_queues++;
+			bfqq->entity.prio_changed = 1;
+			bfq_bfqq_launch_wr_start(bfqq);
+			interactive = true;
+		}
 		if (prev != bfqq->next_rq)
 			bfq_updated_next_req(bfqd, bfqq);
 	}
@@ -1964,6 +2013,7 @@ static void bfq_requests_merged(struct request_queue *q, struct request *rq,
 /* Must be called with bfqq != NULL */
 static void bfq_bfqq_end_wr(struct bfq_queue *bfqq)
 {
+	bfq_bfqq_launch_wr_end(bfqq);
 	if (bfq_bfqq_busy(bfqq))
 		bfqq->bfqd->wr_busy_queues--;
 	bfqq->wr_coeff = 1;
@@ -2321,6 +2371,7 @@ bfq_merge_bfqqs(struct bfq_data *bfqd, struct bfq_io_cq *bic,
 	}
 
 	if (bfqq->wr_coeff > 1) { /* bfqq has given its wr to new_bfqq */
+		bfq_bfqq_launch_wr_end(bfqq);
 		bfqq->wr_coeff = 1;
 		bfqq->entity.prio_changed = 1;
 		if (bfq_bfqq_busy(bfqq))
@@ -3428,6 +3479,15 @@ static bool bfq_better_to_idle(struct bfq_queue *bfqq)
 	    bfq_class_idle(bfqq))
 		return false;
 
+	/*
+	 * While its group is launching an application, the next
+	 * request of the queue is likely to come soon, from the
+	 * application starting up, and must not wait behind the
+	 * competing I/O dispatched in the meantime: always idle.
+	 */
+	if (bfq_bfqq_launching(bfqq))
+		return true;
+
 	bfqq_sequential_and_IO_bound = !BFQQ_SEEKY(bfqq) &&
 		bfq_bfqq_IO_bound(bfqq) && bfq_bfqq_has_short_ttime(bfqq);
 
@@ -3862,6 +3922,10 @@ static struct request *bfq_dispatch_rq_from_bfqq(struct bfq_data *bfqd,
 
 	bfq_bfqq_served(bfqq, service_to_charge);
 
+	if (bfq_bfqq_launching(bfqq))
+		bfqg_stats_update_launch_io(bfqq_group(bfqq),
+					    rq->start_time_ns);
+
 	bfq_dispatch_remove(bfqd->queue, rq);
 
 	if (bfqq != bfqd->in_service_queue) {
@@ -4124,6 +4188,7 @@ void bfq_put_queue(struct bfq_queue *bfqq)
 			bfqq->bfqd->burst_size--;
 	}
 
+	bfq_bfqq_launch_wr_end(bfqq);
 	kmem_cache_free(bfq_pool, bfqq);
 #ifdef CONFIG_BFQ_GROUP_IOSCHED
 	bfqg_and_blkg_put(bfqg);
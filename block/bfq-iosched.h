@@ -32,6 +32,9 @@
 #define BFQ_DEFAULT_GRP_IOPRIO	0
 #define BFQ_DEFAULT_GRP_CLASS	IOPRIO_CLASS_BE
 
+/* Longest launch hint of a group, in ms */
+#define BFQ_LAUNCH_MAX_MS	10000
+
 /*
  * Soft real-time applications are extremely more latency sensitive
  * than interactive ones. Over-raise the weight of the former to
@@ -347,6 +350,11 @@ struct bfq_queue {
 	 * Value of wr start time when switching to soft rt
 	 */
 	unsigned long wr_start_at_switch_to_srt;
+	/*
+	 * Start time of the weight raising granted for a launch hint of
+	 * the group of the queue, valid if BFQQF_launch_wr is set
+	 */
+	unsigned long launch_wr_start;
 
 	unsigned long split_time; /* time of last split */
 
@@ -690,7 +698,8 @@ enum bfqq_state_flags {
 				 * update
 				 */
 	BFQQF_coop,		/* bfqq is shared */
-	BFQQF_split_coop	/* shared bfqq will be split */
+	BFQQF_split_coop,	/* shared bfqq will be split */
+	BFQQF_launch_wr		/* weight-raised for a launch hint */
 };
 
 #define BFQ_BFQQ_FNS(name)						\
@@ -710,6 +719,7 @@ BFQ_BFQQ_FNS(in_large_burst);
 BFQ_BFQQ_FNS(coop);
 BFQ_BFQQ_FNS(split_coop);
 BFQ_BFQQ_FNS(softrt_update);
+BFQ_BFQQ_FNS(launch_wr);
 #undef BFQ_BFQQ_FNS
 
 /* Expiration reasons. */
@@ -754,6 +764,14 @@ struct bfqg_stats {
 	u64				start_empty_time;
 	uint16_t			flags;
 #endif	/* CONFIG_BFQ_GROUP_IOSCHED && CONFIG_DEBUG_BLK_CGROUP */
+#ifdef CONFIG_BFQ_GROUP_IOSCHED
+	/* time queues have been weight-raised for launch hints, in ns */
+	struct blkg_stat		launch_time;
+	/* number of ios dispatched while launching */
+	struct blkg_stat		launch_ios;
+	/* total time these ios waited in the scheduler, in ns */
+	struct blkg_stat		launch_wait_time;
+#endif	/* CONFIG_BFQ_GROUP_IOSCHED */
 };
 
 #ifdef CONFIG_BFQ_GROUP_IOSCHED
@@ -763,12 +781,14 @@ struct bfqg_stats {
  *
  * @ps: @blkcg_policy_storage that this structure inherits
  * @weight: weight of the bfq_group
+ * @launch_until: end of the launch hint of the blkcg, in jiffies, 0 if none
  */
 struct bfq_group_data {
 	/* must be the first member */
 	struct blkcg_policy_data pd;
 
 	unsigned int weight;
+	unsigned long launch_until;
 };
 
 /**
@@ -883,6 +903,9 @@ void bfqg_stats_set_start_empty_time(struct bfq_group *bfqg);
 void bfqg_stats_update_idle_time(struct bfq_group *bfqg);
 void bfqg_stats_set_start_idle_time(struct bfq_group *bfqg);
 void bfqg_stats_update_avg_queue_size(struct bfq_group *bfqg);
+void bfqg_stats_update_launch_time(struct bfq_group *bfqg, u64 time_ns);
+void bfqg_stats_update_launch_io(struct bfq_group *bfqg, u64 start_time_ns);
+bool bfq_bfqq_launching(struct bfq_queue *bfqq);
 void bfq_bfqq_move(struct bfq_data *bfqd, struct bfq_queue *bfqq,
 		   struct bfq_group *bfqg);
 
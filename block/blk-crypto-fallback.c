@@ -12,12 +12,19 @@
 #include <crypto/skcipher.h>
 #include <linux/blk-cgroup.h>
 #include <linux/blk-crypto.h>
+#include <linux/completion.h>
+#include <linux/cpuhotplug.h>
 #include <linux/crypto.h>
+#include <linux/debugfs.h>
 #include <linux/keyslot-manager.h>
 #include <linux/mempool.h>
 #include <linux/module.h>
 #include <linux/random.h>
+#include <linux/seq_file.h>
+#include <linux/shrinker.h>
+#include <linux/smp.h>
 
+#include "blk.h"
 #include "blk-crypto-internal.h"
 
 static unsigned int num_prealloc_bounce_pg = 32;
@@ -35,6 +42,25 @@ module_param(num_prealloc_fallback_crypt_ctxs, uint, 0);
 MODULE_PARM_DESC(num_prealloc_crypt_fallback_ctxs,
 		 "Number of preallocated bio fallback crypto contexts for blk-crypto to use during crypto API fallback");
 
+/*
+ * Encrypted bios are split at BIO_MAX_PAGES, so the default must let a bio
+ * of that many 4096 byte data units be spread over several CPUs.
+ */
+static unsigned int blk_crypto_parallel_units = 32;
+module_param_named(parallel_units, blk_crypto_parallel_units, uint, 0644);
+MODULE_PARM_DESC(parallel_units,
+		 "Minimum number of data units per CPU when spreading the en/decryption of a bio over CPUs, 0 to never spread");
+
+/* Data units submitted to the crypto API before waiting for them */
+#define BLK_CRYPTO_BATCH_UNITS		16
+
+/* Maximum number of CPUs the en/decryption of a bio is spread over */
+#define BLK_CRYPTO_MAX_CRYPT_JOBS	8
+
+/* Bounce pages cached per CPU, and allocated at once to refill the cache */
+#define BLK_CRYPTO_PAGE_CACHE_SIZE	32
+#define BLK_CRYPTO_PAGE_CACHE_REFILL	8
+
 struct bio_fallback_crypt_ctx {
 	struct bio_crypt_ctx crypt_ctx;
 	/*
@@ -77,9 +103,28 @@ static struct blk_crypto_keyslot {
 /* The following few vars are only used during the crypto API fallback */
 static struct keyslot_manager *blk_crypto_ksm;
 static struct workqueue_struct *blk_crypto_wq;
+static struct workqueue_struct *blk_crypto_crypt_wq;
 static mempool_t *blk_crypto_bounce_page_pool;
 static struct kmem_cache *blk_crypto_decrypt_work_cache;
 
+/*
+ * Bounce pages freed on a CPU are kept for the next bios encrypted there, and
+ * an empty cache is refilled from the page allocator in batches, so that the
+ * bounce page pool is only drawn from, and waited on, under memory pressure.
+ */
+struct blk_crypto_page_cache {
+	unsigned int nr;
+	struct page *pages[BLK_CRYPTO_PAGE_CACHE_SIZE];
+
+	unsigned long hits;
+	unsigned long refills;
+	unsigned long pool_allocs;
+	unsigned long pool_waits;
+	unsigned long pool_frees;
+};
+
+static DEFINE_PER_CPU(struct blk_crypto_page_cache, blk_crypto_page_cache);
+
 bool bio_crypt_fallback_crypted(const struct bio_crypt_ctx *bc)
 {
 	return bc && bc->bc_ksm == blk_crypto_ksm;
@@ -150,14 +195,181 @@ static const struct keyslot_mgmt_ll_ops blk_crypto_ksm_ll_ops = {
 	.keyslot_evict		= blk_crypto_keyslot_evict,
 };
 
+static struct page *blk_crypto_bounce_page_get(void)
+{
+	struct page *pages[BLK_CRYPTO_PAGE_CACHE_REFILL];
+	struct blk_crypto_page_cache *pc;
+	unsigned long flags;
+	struct page *page;
+	int i, n;
+
+	local_irq_save(flags);
+	pc = this_cpu_ptr(&blk_crypto_page_cache);
+	if (pc->nr) {
+		page = pc->pages[--pc->nr];
+		pc->hits++;
+		local_irq_restore(flags);
+		return page;
+	}
+	local_irq_restore(flags);
+
+	/*
+	 * Refill without direct reclaim and without dipping into the pool
+	 * reserves; when memory is tight, fall back to the pool instead.
+	 */
+	for (n = 0; n < BLK_CRYPTO_PAGE_CACHE_REFILL; n++) {
+		pages[n] = alloc_page(GFP_NOWAIT | __GFP_NOWARN);
+		if (!pages[n])
+			break;
+	}
+
+	if (n) {
+		page = pages[--n];
+
+		local_irq_save(flags);
+		pc = this_cpu_ptr(&blk_crypto_page_cache);
+		pc->refills++;
+		for (i = 0; i < n && pc->nr < BLK_CRYPTO_PAGE_CACHE_SIZE; i++)
+			pc->pages[pc->nr++] = pages[i];
+		local_irq_restore(flags);
+
+		/* Raced with frees filling the cache up */
+		for (; i < n; i++)
+			__free_page(pages[i]);
+		return page;
+	}
+
+	this_cpu_inc(blk_crypto_page_cache.pool_allocs);
+	page = mempool_alloc(blk_crypto_bounce_page_pool,
+			     GFP_NOWAIT | __GFP_NOWARN);
+	if (page)
+		return page;
+
+	this_cpu_inc(blk_crypto_page_cache.pool_waits);
+	return mempool_alloc(blk_crypto_bounce_page_pool, GFP_NOIO);
+}
+
+static void blk_crypto_bounce_page_put(struct page *page)
+{
+	struct blk_crypto_page_cache *pc;
+	unsigned long flags;
+
+	/* Refill the pool reserves first, someone may be waiting on them */
+	if (READ_ONCE(blk_crypto_bounce_page_pool->curr_nr) >=
+	    blk_crypto_bounce_page_pool->min_nr) {
+		local_irq_save(flags);
+		pc = this_cpu_ptr(&blk_crypto_page_cache);
+		if (pc->nr < BLK_CRYPTO_PAGE_CACHE_SIZE) {
+			pc->pages[pc->nr++] = page;
+			local_irq_restore(flags);
+			return;
+		}
+		local_irq_restore(flags);
+	}
+
+	this_cpu_inc(blk_crypto_page_cache.pool_frees);
+	mempool_free(page, blk_crypto_bounce_page_pool);
+}
+
+static void blk_crypto_page_cache_drain(struct blk_crypto_page_cache *pc)
+{
+	while (pc->nr)
+		mempool_free(pc->pages[--pc->nr], blk_crypto_bounce_page_pool);
+}
+
+static int blk_crypto_page_cache_dead(unsigned int cpu)
+{
+	blk_crypto_page_cache_drain(per_cpu_ptr(&blk_crypto_page_cache, cpu));
+	return 0;
+}
+
+/* Runs on each CPU, with interrupts disabled, from the shrinker */
+static void blk_crypto_page_cache_drain_local(void *unused)
+{
+	blk_crypto_page_cache_drain(this_cpu_ptr(&blk_crypto_page_cache));
+}
+
+static unsigned long
+blk_crypto_page_cache_count(struct shrinker *shrink,
+			    struct shrink_control *sc)
+{
+	unsigned long nr = 0;
+	int cpu;
+
+	for_each_online_cpu(cpu)
+		nr += READ_ONCE(per_cpu_ptr(&blk_crypto_page_cache, cpu)->nr);
+	return nr;
+}
+
+/*
+ * The per-CPU caches are small and refilled in batches on demand, so under
+ * memory pressure just give all of them back rather than trimming them.
+ */
+static unsigned long
+blk_crypto_page_cache_scan(struct shrinker *shrink,
+			   struct shrink_control *sc)
+{
+	unsigned long nr = blk_crypto_page_cache_count(shrink, sc);
+
+	if (!nr)
+		return SHRINK_STOP;
+	on_each_cpu(blk_crypto_page_cache_drain_local, NULL, 1);
+	return nr;
+}
+
+static struct shrinker blk_crypto_page_cache_shrinker = {
+	.count_objects	= blk_crypto_page_cache_count,
+	.scan_objects	= blk_crypto_page_cache_scan,
+	.seeks		= DEFAULT_SEEKS,
+};
+
+#ifdef CONFIG_DEBUG_FS
+static int blk_crypto_page_cache_show(struct seq_file *m, void *v)
+{
+	struct blk_crypto_page_cache *pc;
+	int cpu;
+
+	seq_puts(m, "cpu cached hits refills pool_allocs pool_waits pool_frees\n");
+	for_each_possible_cpu(cpu) {
+		pc = per_cpu_ptr(&blk_crypto_page_cache, cpu);
+		seq_printf(m, "%d %u %lu %lu %lu %lu %lu\n", cpu,
+			   READ_ONCE(pc->nr), READ_ONCE(pc->hits),
+			   READ_ONCE(pc->refills), READ_ONCE(pc->pool_allocs),
+			   READ_ONCE(pc->pool_waits), READ_ONCE(pc->pool_frees));
+	}
+
+	return 0;
+}
+
+static int blk_crypto_page_cache_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, blk_crypto_page_cache_show, NULL);
+}
+
+static const struct file_operations blk_crypto_page_cache_fops = {
+	.open		= blk_crypto_page_cache_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void blk_crypto_page_cache_debugfs_init(void)
+{
+	debugfs_create_file("crypto_fallback_bounce_pages", 0400,
+			    blk_debugfs_root, NULL,
+			    &blk_crypto_page_cache_fops);
+}
+#else
+static inline void blk_crypto_page_cache_debugfs_init(void) { }
+#endif /* CONFIG_DEBUG_FS */
+
 static void blk_crypto_encrypt_endio(struct bio *enc_bio)
 {
 	struct bio *src_bio = enc_bio->bi_private;
 	int i;
 
 	for (i = 0; i < enc_bio->bi_vcnt; i++)
-		mempool_free(enc_bio->bi_io_vec[i].bv_page,
-			     blk_crypto_bounce_page_pool);
+		blk_crypto_bounce_page_put(enc_bio->bi_io_vec[i].bv_page);
 
 	src_bio->bi_status = enc_bio->bi_status;
 
@@ -197,29 +409,6 @@ static struct bio *blk_crypto_clone_bio(struct bio *bio_src)
 	return bio;
 }
 
-static int blk_crypto_alloc_cipher_req(struct bio *src_bio,
-				       struct skcipher_request **ciph_req_ret,
-				       struct crypto_wait *wait)
-{
-	struct skcipher_request *ciph_req;
-	const struct blk_crypto_keyslot *slotp;
-
-	slotp = &blk_crypto_keyslots[src_bio->bi_crypt_context->bc_keyslot];
-	ciph_req = skcipher_request_alloc(slotp->tfms[slotp->crypto_mode],
-					  GFP_NOIO);
-	if (!ciph_req) {
-		src_bio->bi_status = BLK_STS_RESOURCE;
-		return -ENOMEM;
-	}
-
-	skcipher_request_set_callback(ciph_req,
-				      CRYPTO_TFM_REQ_MAY_BACKLOG |
-				      CRYPTO_TFM_REQ_MAY_SLEEP,
-				      crypto_req_done, wait);
-	*ciph_req_ret = ciph_req;
-	return 0;
-}
-
 static int blk_crypto_split_bio_if_needed(struct bio **bio_ptr)
 {
 	struct bio *bio = *bio_ptr;
@@ -262,6 +451,253 @@ static void blk_crypto_dun_to_iv(const u64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE],
 		iv->dun[i] = cpu_to_le64(dun[i]);
 }
 
+/* One data unit of a batch, followed by the tfm request context */
+struct blk_crypto_unit {
+	union blk_crypto_iv iv;
+	struct scatterlist src;
+	struct scatterlist dst;
+	struct skcipher_request req;
+};
+
+struct blk_crypto_batch {
+	atomic_t pending;
+	int err;
+	struct completion done;
+};
+
+/*
+ * Part of a bio en/decrypted by one CPU: the data units of @bio within @iter
+ * go to the pages of @dst_bvec, or are en/decrypted in place if it's NULL.
+ */
+struct blk_crypto_crypt_job {
+	struct work_struct work;
+	struct bio *bio;
+	struct bvec_iter iter;
+	struct bio_vec *dst_bvec;
+	u64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE];
+	bool encrypt;
+	int err;
+	atomic_t *remaining;
+	struct completion *done;
+};
+
+static void blk_crypto_unit_done(struct crypto_async_request *areq, int err)
+{
+	struct blk_crypto_batch *batch = areq->data;
+
+	/* A backlogged request was started, its completion is still to come */
+	if (err == -EINPROGRESS)
+		return;
+
+	if (err)
+		WRITE_ONCE(batch->err, err);
+	if (atomic_dec_and_test(&batch->pending))
+		complete(&batch->done);
+}
+
+static int blk_crypto_batch_wait(struct blk_crypto_batch *batch)
+{
+	if (!atomic_dec_and_test(&batch->pending))
+		wait_for_completion(&batch->done);
+
+	/* Ready for the next batch */
+	atomic_set(&batch->pending, 1);
+	reinit_completion(&batch->done);
+
+	return batch->err;
+}
+
+/*
+ * En/decrypt the data units of a job. Each data unit needs its own IV, hence
+ * its own request, but up to BLK_CRYPTO_BATCH_UNITS of them are submitted
+ * before waiting, so that asynchronous implementations work on them all at
+ * once and synchronous ones don't pay a wait per data unit.
+ */
+static int blk_crypto_crypt_job(struct blk_crypto_crypt_job *job)
+{
+	struct bio_crypt_ctx *bc = job->bio->bi_crypt_context;
+	const struct blk_crypto_keyslot *slotp =
+		&blk_crypto_keyslots[bc->bc_keyslot];
+	struct crypto_skcipher *tfm = slotp->tfms[slotp->crypto_mode];
+	const unsigned int data_unit_size = bc->bc_key->data_unit_size;
+	unsigned int unit_size, nr_units, n = 0, seg = 0, i;
+	struct blk_crypto_batch batch;
+	struct blk_crypto_unit *unit;
+	struct bvec_iter iter;
+	struct bio_vec bv;
+	void *units;
+	int err;
+
+	unit_size = ALIGN(sizeof(*unit) + crypto_skcipher_reqsize(tfm),
+			  CRYPTO_MINALIGN);
+	nr_units = BLK_CRYPTO_BATCH_UNITS;
+	units = kmalloc_array(nr_units, unit_size, GFP_NOIO | __GFP_NOWARN);
+	if (!units) {
+		nr_units = 1;
+		units = kmalloc(unit_size, GFP_NOIO);
+		if (!units)
+			return -ENOMEM;
+	}
+
+	atomic_set(&batch.pending, 1);
+	batch.err = 0;
+	init_completion(&batch.done);
+
+	__bio_for_each_segment(bv, job->bio, iter, job->iter) {
+		struct page *dst_page = bv.bv_page;
+
+		if (job->dst_bvec)
+			dst_page = job->dst_bvec[seg++].bv_page;
+
+		for (i = 0; i < bv.bv_len; i += data_unit_size) {
+			unit = units + n * unit_size;
+
+			blk_crypto_dun_to_iv(job->dun, &unit->iv);
+			bio_crypt_dun_increment(job->dun, 1);
+
+			sg_init_table(&unit->src, 1);
+			sg_set_page(&unit->src, bv.bv_page, data_unit_size,
+				    bv.bv_offset + i);
+			sg_init_table(&unit->dst, 1);
+			sg_set_page(&unit->dst, dst_page, data_unit_size,
+				    bv.bv_offset + i);
+
+			skcipher_request_set_tfm(&unit->req, tfm);
+			skcipher_request_set_callback(&unit->req,
+						      CRYPTO_TFM_REQ_MAY_BACKLOG |
+						      CRYPTO_TFM_REQ_MAY_SLEEP,
+						      blk_crypto_unit_done,
+						      &batch);
+			skcipher_request_set_crypt(&unit->req, &unit->src,
+						   &unit->dst, data_unit_size,
+						   unit->iv.bytes);
+
+			atomic_inc(&batch.pending);
+			err = job->encrypt ?
+				crypto_skcipher_encrypt(&unit->req) :
+				crypto_skcipher_decrypt(&unit->req);
+			if (err != -EINPROGRESS && err != -EBUSY)
+				blk_crypto_unit_done(&unit->req.base, err);
+
+			if (++n < nr_units)
+				continue;
+
+			n = 0;
+			err = blk_crypto_batch_wait(&batch);
+			if (err)
+				goto out;
+		}
+	}
+
+	err = blk_crypto_batch_wait(&batch);
+out:
+	kfree(units);
+	return err;
+}
+
+static void blk_crypto_crypt_work(struct work_struct *work)
+{
+	struct blk_crypto_crypt_job *job =
+		container_of(work, struct blk_crypto_crypt_job, work);
+
+	job->err = blk_crypto_crypt_job(job);
+	if (atomic_dec_and_test(job->remaining))
+		complete(job->done);
+}
+
+static void blk_crypto_init_job(struct blk_crypto_crypt_job *job,
+				struct bio *bio, struct bvec_iter iter,
+				unsigned int offset, unsigned int len,
+				struct bio_vec *dst_bvec,
+				const u64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE],
+				bool encrypt)
+{
+	job->bio = bio;
+	job->iter = iter;
+	bio_advance_iter(bio, &job->iter, offset);
+	job->iter.bi_size = len;
+	job->dst_bvec = dst_bvec;
+	memcpy(job->dun, dun, sizeof(job->dun));
+	bio_crypt_dun_increment(job->dun,
+		offset >> bio->bi_crypt_context->bc_key->data_unit_size_bits);
+	job->encrypt = encrypt;
+	job->err = 0;
+}
+
+/*
+ * En/decrypt the data units of @bio within @iter, starting at @dun, into the
+ * pages of @dst_bvec, one per segment of @bio, or in place if it's NULL.
+ * Bios of enough data units are cut at segment boundaries into parts of
+ * about the same size, en/decrypted in parallel by the current CPU and
+ * the workers of blk_crypto_crypt_wq.
+ */
+static int blk_crypto_crypt_bio(struct bio *bio, struct bvec_iter iter,
+				struct bio_vec *dst_bvec,
+				const u64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE],
+				bool encrypt)
+{
+	struct bio_crypt_ctx *bc = bio->bi_crypt_context;
+	unsigned int nr_units = iter.bi_size >> bc->bc_key->data_unit_size_bits;
+	unsigned int nr_jobs = 1, i, seg = 0, first_seg = 0;
+	struct blk_crypto_crypt_job onstack_job, *jobs = &onstack_job;
+	DECLARE_COMPLETION_ONSTACK(done);
+	unsigned int bytes = 0, start = 0;
+	struct bvec_iter seg_iter;
+	atomic_t remaining;
+	struct bio_vec bv;
+	int err;
+
+	if (blk_crypto_parallel_units)
+		nr_jobs = min3(nr_units / blk_crypto_parallel_units,
+			       num_online_cpus(), BLK_CRYPTO_MAX_CRYPT_JOBS);
+	if (nr_jobs > 1)
+		jobs = kmalloc_array(nr_jobs, sizeof(*jobs),
+				     GFP_NOIO | __GFP_NOWARN);
+	if (nr_jobs <= 1 || !jobs) {
+		jobs = &onstack_job;
+		nr_jobs = 1;
+	}
+
+	i = 0;
+	__bio_for_each_segment(bv, bio, seg_iter, iter) {
+		if (i + 1 < nr_jobs &&
+		    bytes >= div_u64((u64)iter.bi_size * (i + 1), nr_jobs)) {
+			blk_crypto_init_job(&jobs[i++], bio, iter, start,
+					    bytes - start,
+					    dst_bvec ? dst_bvec + first_seg : NULL,
+					    dun, encrypt);
+			start = bytes;
+			first_seg = seg;
+		}
+		bytes += bv.bv_len;
+		seg++;
+	}
+	blk_crypto_init_job(&jobs[i++], bio, iter, start, bytes - start,
+			    dst_bvec ? dst_bvec + first_seg : NULL, dun, encrypt);
+	nr_jobs = i;
+
+	atomic_set(&remaining, nr_jobs);
+	for (i = 1; i < nr_jobs; i++) {
+		jobs[i].remaining = &remaining;
+		jobs[i].done = &done;
+		INIT_WORK(&jobs[i].work, blk_crypto_crypt_work);
+		queue_work(blk_crypto_crypt_wq, &jobs[i].work);
+	}
+
+	err = blk_crypto_crypt_job(&jobs[0]);
+	if (!atomic_dec_and_test(&remaining))
+		wait_for_completion(&done);
+
+	for (i = 1; i < nr_jobs; i++) {
+		if (!err)
+			err = jobs[i].err;
+	}
+	if (jobs != &onstack_job)
+		kfree(jobs);
+
+	return err;
+}
+
 /*
  * The crypto API fallback's encryption routine.
  * Allocate a bounce bio for encryption, encrypt the input bio using crypto API,
@@ -271,14 +707,8 @@ static void blk_crypto_dun_to_iv(const u64 dun[BLK_CRYPTO_DUN_ARRAY_SIZE],
 static int blk_crypto_encrypt_bio(struct bio **bio_ptr)
 {
 	struct bio *src_bio;
-	struct skcipher_request *ciph_req = NULL;
-	DECLARE_CRYPTO_WAIT(wait);
-	u64 curr_dun[BLK_CRYPTO_DUN_ARRAY_SIZE];
-	union blk_crypto_iv iv;
-	struct scatterlist src, dst;
 	struct bio *enc_bio;
-	unsigned int i, j;
-	int data_unit_size;
+	unsigned int i = 0;
 	struct bio_crypt_ctx *bc;
 	int err = 0;
 
@@ -289,7 +719,6 @@ static int blk_crypto_encrypt_bio(struct bio **bio_ptr)
 
 	src_bio = *bio_ptr;
 	bc = src_bio->bi_crypt_context;
-	data_unit_size = bc->bc_key->data_unit_size;
 
 	/* Allocate bounce bio for encryption */
 	enc_bio = blk_crypto_clone_bio(src_bio);
@@ -308,52 +737,27 @@ static int blk_crypto_encrypt_bio(struct bio **bio_ptr)
 		goto out_put_enc_bio;
 	}
 
-	/* and then allocate an skcipher_request for it */
-	err = blk_crypto_alloc_cipher_req(src_bio, &ciph_req, &wait);
-	if (err)
-		goto out_release_keyslot;
-
-	memcpy(curr_dun, bc->bc_dun, sizeof(curr_dun));
-	sg_init_table(&src, 1);
-	sg_init_table(&dst, 1);
-
-	skcipher_request_set_crypt(ciph_req, &src, &dst, data_unit_size,
-				   iv.bytes);
-
-	/* Encrypt each page in the bounce bio */
+	/*
+	 * Replace the pages of the bounce bio with bounce pages, the plaintext
+	 * is still reachable through the segments of src_bio.
+	 */
 	for (i = 0; i < enc_bio->bi_vcnt; i++) {
-		struct bio_vec *enc_bvec = &enc_bio->bi_io_vec[i];
-		struct page *plaintext_page = enc_bvec->bv_page;
-		struct page *ciphertext_page =
-			mempool_alloc(blk_crypto_bounce_page_pool, GFP_NOIO);
-
-		enc_bvec->bv_page = ciphertext_page;
+		struct page *ciphertext_page = blk_crypto_bounce_page_get();
 
 		if (!ciphertext_page) {
 			src_bio->bi_status = BLK_STS_RESOURCE;
 			err = -ENOMEM;
 			goto out_free_bounce_pages;
 		}
+		enc_bio->bi_io_vec[i].bv_page = ciphertext_page;
+	}
 
-		sg_set_page(&src, plaintext_page, data_unit_size,
-			    enc_bvec->bv_offset);
-		sg_set_page(&dst, ciphertext_page, data_unit_size,
-			    enc_bvec->bv_offset);
-
-		/* Encrypt each data unit in this page */
-		for (j = 0; j < enc_bvec->bv_len; j += data_unit_size) {
-			blk_crypto_dun_to_iv(curr_dun, &iv);
-			err = crypto_wait_req(crypto_skcipher_encrypt(ciph_req),
-					      &wait);
-			if (err) {
-				i++;
-				src_bio->bi_status = BLK_STS_RESOURCE;
-				goto out_free_bounce_pages;
-			}
-			bio_crypt_dun_increment(curr_dun, 1);
-			src.offset += data_unit_size;
-			dst.offset += data_unit_size;
-		}
+	/* Encrypt each data unit of src_bio into the bounce pages */
+	err = blk_crypto_crypt_bio(src_bio, src_bio->bi_iter,
+				   enc_bio->bi_io_vec, bc->bc_dun, true);
+	if (err) {
+		src_bio->bi_status = BLK_STS_RESOURCE;
+		goto out_free_bounce_pages;
 	}
 
 	enc_bio->bi_private = src_bio;
@@ -362,14 +766,11 @@ static int blk_crypto_encrypt_bio(struct bio **bio_ptr)
 
 	enc_bio = NULL;
 	err = 0;
-	goto out_free_ciph_req;
+	goto out_release_keyslot;
 
 out_free_bounce_pages:
 	while (i > 0)
-		mempool_free(enc_bio->bi_io_vec[--i].bv_page,
-			     blk_crypto_bounce_page_pool);
-out_free_ciph_req:
-	skcipher_request_free(ciph_req);
+		blk_crypto_bounce_page_put(enc_bio->bi_io_vec[--i].bv_page);
 out_release_keyslot:
 	bio_crypt_ctx_release_keyslot(bc);
 out_put_enc_bio:
@@ -397,18 +798,9 @@ static void blk_crypto_decrypt_bio(struct work_struct *work)
 	struct blk_crypto_decrypt_work *decrypt_work =
 		container_of(work, struct blk_crypto_decrypt_work, work);
 	struct bio *bio = decrypt_work->bio;
-	struct skcipher_request *ciph_req = NULL;
-	DECLARE_CRYPTO_WAIT(wait);
-	struct bio_vec bv;
-	struct bvec_iter iter;
-	u64 curr_dun[BLK_CRYPTO_DUN_ARRAY_SIZE];
-	union blk_crypto_iv iv;
-	struct scatterlist sg;
 	struct bio_crypt_ctx *bc = bio->bi_crypt_context;
 	struct bio_fallback_crypt_ctx *f_ctx =
 		container_of(bc, struct bio_fallback_crypt_ctx, crypt_ctx);
-	const int data_unit_size = bc->bc_key->data_unit_size;
-	unsigned int i;
 	int err;
 
 	/*
@@ -420,37 +812,13 @@ static void blk_crypto_decrypt_bio(struct work_struct *work)
 		goto out_no_keyslot;
 	}
 
-	/* and then allocate an skcipher_request for it */
-	err = blk_crypto_alloc_cipher_req(bio, &ciph_req, &wait);
+	/* Decrypt each data unit in the bio, in place */
+	err = blk_crypto_crypt_bio(bio, f_ctx->crypt_iter, NULL,
+				   f_ctx->fallback_dun, false);
 	if (err)
-		goto out;
+		bio->bi_status = err == -ENOMEM ? BLK_STS_RESOURCE :
+						  BLK_STS_IOERR;
 
-	memcpy(curr_dun, f_ctx->fallback_dun, sizeof(curr_dun));
-	sg_init_table(&sg, 1);
-	skcipher_request_set_crypt(ciph_req, &sg, &sg, data_unit_size,
-				   iv.bytes);
-
-	/* Decrypt each segment in the bio */
-	__bio_for_each_segment(bv, bio, iter, f_ctx->crypt_iter) {
-		struct page *page = bv.bv_page;
-
-		sg_set_page(&sg, page, data_unit_size, bv.bv_offset);
-
-		/* Decrypt each data unit in the segment */
-		for (i = 0; i < bv.bv_len; i += data_unit_size) {
-			blk_crypto_dun_to_iv(curr_dun, &iv);
-			if (crypto_wait_req(crypto_skcipher_decrypt(ciph_req),
-					    &wait)) {
-				bio->bi_status = BLK_STS_IOERR;
-				goto out;
-			}
-			bio_crypt_dun_increment(curr_dun, 1);
-			sg.offset += data_unit_size;
-		}
-	}
-
-out:
-	skcipher_request_free(ciph_req);
 	bio_crypt_ctx_release_keyslot(bc);
 out_no_keyslot:
 	kmem_cache_free(blk_crypto_decrypt_work_cache, decrypt_work);
@@ -590,7 +958,7 @@ int blk_crypto_fallback_submit_bio(struct bio **bio_ptr)
 
 int __init blk_crypto_fallback_init(void)
 {
-	int i;
+	int i, err;
 	unsigned int crypto_mode_supported[BLK_ENCRYPTION_MODE_MAX];
 
 	prandom_bytes(blank_key, BLK_CRYPTO_MAX_KEY_SIZE);
@@ -614,6 +982,13 @@ int __init blk_crypto_fallback_init(void)
 	if (!blk_crypto_wq)
 		return -ENOMEM;
 
+	/* Parts of bios, never waiting on anything but the crypto API */
+	blk_crypto_crypt_wq = alloc_workqueue("blk_crypto_crypt_wq",
+					      WQ_UNBOUND | WQ_HIGHPRI |
+					      WQ_MEM_RECLAIM, 0);
+	if (!blk_crypto_crypt_wq)
+		return -ENOMEM;
+
 	blk_crypto_keyslots = kcalloc(blk_crypto_num_keyslots,
 				      sizeof(blk_crypto_keyslots[0]),
 				      GFP_KERNEL);
@@ -625,6 +1000,16 @@ int __init blk_crypto_fallback_init(void)
 	if (!blk_crypto_bounce_page_pool)
 		return -ENOMEM;
 
+	err = cpuhp_setup_state_nocalls(CPUHP_BP_PREPARE_DYN,
+					"block/crypto-fallback:dead", NULL,
+					blk_crypto_page_cache_dead);
+	if (err < 0)
+		return err;
+	err = register_shrinker(&blk_crypto_page_cache_shrinker);
+	if (err)
+		return err;
+	blk_crypto_page_cache_debugfs_init();
+
 	blk_crypto_decrypt_work_cache = KMEM_CACHE(blk_crypto_decrypt_work,
 						   SLAB_RECLAIM_ACCOUNT);
 	if (!blk_crypto_decrypt_work_cache)
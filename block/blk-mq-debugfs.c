@@ -51,6 +51,14 @@ static int queue_poll_stat_show(void *data, struct seq_file *m)
 	return 0;
 }
 
+static int queue_stat_hist_show(void *data, struct seq_file *m)
+{
+	struct request_queue *q = data;
+
+	blk_stat_show_hist(q, m);
+	return 0;
+}
+
 static void *queue_requeue_list_start(struct seq_file *m, loff_t *pos)
 	__acquires(&q->requeue_lock)
 {
@@ -140,6 +148,7 @@ static const char *const blk_queue_flag_name[] = {
 	QUEUE_FLAG_NAME(REGISTERED),
 	QUEUE_FLAG_NAME(SCSI_PASSTHROUGH),
 	QUEUE_FLAG_NAME(QUIESCED),
+	QUEUE_FLAG_NAME(COMP_BATCH),
 };
 #undef QUEUE_FLAG_NAME
 
@@ -215,6 +224,7 @@ static ssize_t queue_write_hint_store(void *data, const char __user *buf,
 
 static const struct blk_mq_debugfs_attr blk_mq_debugfs_queue_attrs[] = {
 	{ "poll_stat", 0400, queue_poll_stat_show },
+	{ "stat_hist", 0400, queue_stat_hist_show },
 	{ "requeue_list", 0400, .seq_ops = &queue_requeue_list_seq_ops },
 	{ "pm_only", 0600, queue_pm_only_show, NULL },
 	{ "state", 0600, queue_state_show, queue_state_write },
@@ -560,6 +570,43 @@ static ssize_t hctx_io_poll_write(void *data, const char __user *buf,
 	return count;
 }
 
+static int hctx_comp_batch_show(void *data, struct seq_file *m)
+{
+	struct blk_mq_hw_ctx *hctx = data;
+	unsigned long batches = 0;
+	u64 elapsed, iops = 0;
+	int i;
+
+	for (i = 0; i < BLK_MQ_MAX_BATCH_ORDER; i++)
+		batches += hctx->comp_batched[i];
+
+	elapsed = ktime_get_ns() - hctx->comp_start_ns;
+	if (hctx->comp_start_ns && elapsed)
+		iops = div64_u64((u64)hctx->comp_batched_rqs * NSEC_PER_SEC,
+				 elapsed);
+
+	seq_printf(m, "batches=%lu\n", batches);
+	seq_printf(m, "requests=%lu\n", hctx->comp_batched_rqs);
+	seq_printf(m, "iops=%llu\n", iops);
+	seq_printf(m, "defer_avg_ns=%llu\n",
+		   batches ? div64_u64(hctx->comp_defer_ns, batches) : 0);
+	seq_printf(m, "defer_max_ns=%llu\n", hctx->comp_defer_max_ns);
+
+	for (i = 0; i < BLK_MQ_MAX_BATCH_ORDER - 1; i++)
+		seq_printf(m, "%8u\t%lu\n", 1U << i, hctx->comp_batched[i]);
+	seq_printf(m, "%8u+\t%lu\n", 1U << i, hctx->comp_batched[i]);
+	return 0;
+}
+
+static ssize_t hctx_comp_batch_write(void *data, const char __user *buf,
+				     size_t count, loff_t *ppos)
+{
+	struct blk_mq_hw_ctx *hctx = data;
+
+	blk_mq_complete_batch_reset(hctx);
+	return count;
+}
+
 static int hctx_dispatched_show(void *data, struct seq_file *m)
 {
 	struct blk_mq_hw_ctx *hctx = data;
@@ -796,6 +843,7 @@ static const struct blk_mq_debugfs_attr blk_mq_debugfs_hctx_attrs[] = {
 	{"sched_tags_bitmap", 0400, hctx_sched_tags_bitmap_show},
 	{"io_poll", 0600, hctx_io_poll_show, hctx_io_poll_write},
 	{"dispatched", 0600, hctx_dispatched_show, hctx_dispatched_write},
+	{"comp_batch", 0600, hctx_comp_batch_show, hctx_comp_batch_write},
 	{"queued", 0600, hctx_queued_show, hctx_queued_write},
 	{"run", 0600, hctx_run_show, hctx_run_write},
 	{"active", 0400, hctx_active_show},
@@ -554,17 +554,12 @@ static void __blk_mq_complete_request_remote(void *data)
 	rq->q->softirq_done_fn(rq);
 }
 
-static void __blk_mq_complete_request(struct request *rq)
+static void __blk_mq_complete_request_done(struct request *rq)
 {
 	struct blk_mq_ctx *ctx = rq->mq_ctx;
 	bool shared = false;
 	int cpu;
 
-	if (!blk_mq_mark_complete(rq))
-		return;
-	if (rq->internal_tag != -1)
-		blk_mq_sched_completed_request(rq);
-
 	if (!test_bit(QUEUE_FLAG_SAME_COMP, &rq->q->queue_flags)) {
 		rq->q->softirq_done_fn(rq);
 		return;
@@ -585,6 +580,132 @@ static void __blk_mq_complete_request(struct request *rq)
 	put_cpu();
 }
 
+/*
+ * Completion batching. With QUEUE_FLAG_COMP_BATCH set, requests completed
+ * from interrupt context are queued on a per-cpu list, rather than have
+ * their completion handler run right away. The block softirq then runs the
+ * handlers of all the requests completed by one interrupt, or one poll
+ * iteration, back to back, once the driver is done reaping its completion
+ * queue. The handlers and end_io callbacks run with hot caches, and drivers
+ * completing a request per interrupt don't pay for the block layer
+ * completion in their interrupt handler.
+ */
+struct blk_mq_comp_batch {
+	struct list_head	list;
+	u64			start_ns;	/* first request queued */
+};
+
+static DEFINE_PER_CPU(struct blk_mq_comp_batch, blk_mq_comp_batch);
+
+static bool blk_mq_complete_batch(struct request *rq)
+{
+	struct blk_mq_comp_batch *batch;
+	unsigned long flags;
+
+	/* From process context, the softirq would only run from ksoftirqd */
+	if (!in_interrupt())
+		return false;
+
+	local_irq_save(flags);
+	batch = this_cpu_ptr(&blk_mq_comp_batch);
+	if (list_empty(&batch->list)) {
+		batch->start_ns = ktime_get_ns();
+		raise_softirq_irqoff(BLOCK_SOFTIRQ);
+	}
+	list_add_tail(&rq->ipi_list, &batch->list);
+	local_irq_restore(flags);
+
+	return true;
+}
+
+static void blk_mq_complete_batch_account(struct blk_mq_hw_ctx *hctx,
+					  unsigned int nr, u64 defer_ns)
+{
+	hctx->comp_batched[min(BLK_MQ_MAX_BATCH_ORDER - 1, ilog2(nr))]++;
+	hctx->comp_batched_rqs += nr;
+	hctx->comp_defer_ns += defer_ns;
+	if (defer_ns > hctx->comp_defer_max_ns)
+		hctx->comp_defer_max_ns = defer_ns;
+}
+
+/* Called from the block softirq */
+void blk_mq_complete_batch_run(void)
+{
+	struct blk_mq_comp_batch *batch;
+	struct blk_mq_hw_ctx *hctx, *prev = NULL;
+	struct request *rq, *next;
+	unsigned int nr = 0;
+	LIST_HEAD(list);
+	u64 defer_ns = 0;
+
+	local_irq_disable();
+	batch = this_cpu_ptr(&blk_mq_comp_batch);
+	if (!list_empty(&batch->list)) {
+		list_splice_init(&batch->list, &list);
+		defer_ns = ktime_get_ns() - batch->start_ns;
+	}
+	local_irq_enable();
+
+	if (list_empty(&list))
+		return;
+
+	/*
+	 * Account the requests of each hardware queue as a batch before
+	 * completing any, the queue can go away with its last request.
+	 */
+	list_for_each_entry(rq, &list, ipi_list) {
+		hctx = blk_mq_map_queue(rq->q, rq->mq_ctx->cpu);
+		if (prev && hctx != prev) {
+			blk_mq_complete_batch_account(prev, nr, defer_ns);
+			nr = 0;
+		}
+		prev = hctx;
+		nr++;
+	}
+	blk_mq_complete_batch_account(prev, nr, defer_ns);
+
+	list_for_each_entry_safe(rq, next, &list, ipi_list) {
+		list_del_init(&rq->ipi_list);
+		__blk_mq_complete_request_done(rq);
+	}
+}
+
+void blk_mq_complete_batch_cpu_dead(unsigned int cpu)
+{
+	struct blk_mq_comp_batch *batch = this_cpu_ptr(&blk_mq_comp_batch);
+
+	/* Called with interrupts disabled, the softirq is raised for us */
+	if (list_empty(&batch->list))
+		batch->start_ns = ktime_get_ns();
+	list_splice_tail_init(&per_cpu(blk_mq_comp_batch, cpu).list,
+			      &batch->list);
+}
+
+void blk_mq_complete_batch_reset(struct blk_mq_hw_ctx *hctx)
+{
+	int i;
+
+	for (i = 0; i < BLK_MQ_MAX_BATCH_ORDER; i++)
+		hctx->comp_batched[i] = 0;
+	hctx->comp_batched_rqs = 0;
+	hctx->comp_defer_ns = hctx->comp_defer_max_ns = 0;
+	hctx->comp_start_ns = ktime_get_ns();
+}
+
+static void __blk_mq_complete_request(struct request *rq)
+{
+	if (!blk_mq_mark_complete(rq))
+		return;
+	if (rq->internal_tag != -1)
+		blk_mq_sched_completed_request(rq);
+
+	if (test_bit(QUEUE_FLAG_COMP_BATCH, &rq->q->queue_flags) &&
+	    blk_mq_complete_batch(rq))
+		return;
+
+	__blk_mq_complete_request_done(rq);
+}
+
 static void hctx_unlock(struct blk_mq_hw_ctx *hctx, int srcu_idx)
 	__releases(hctx->srcu)
 {
@@ -3171,7 +3292,16 @@ static bool __blk_mq_poll(struct blk_mq_hw_ctx *hctx, struct request *rq)
 
 		hctx->poll_invoked++;
 
-		ret = q->mq_ops->poll(hctx, rq->tag);
+		/*
+		 * With completion batching, the requests completed by the
+		 * poll are completed as a batch when enabling bottom halves.
+		 */
+		if (test_bit(QUEUE_FLAG_COMP_BATCH, &q->queue_flags)) {
+			local_bh_disable();
+			ret = q->mq_ops->poll(hctx, rq->tag);
+			local_bh_enable();
+		} else
+			ret = q->mq_ops->poll(hctx, rq->tag);
 		if (ret > 0) {
 			hctx->poll_success++;
 			set_current_state(TASK_RUNNING);
@@ -3220,6 +3350,11 @@ static bool blk_mq_poll(struct request_queue *q, blk_qc_t cookie)
 
 static int __init blk_mq_init(void)
 {
+	int i;
+
+	for_each_possible_cpu(i)
+		INIT_LIST_HEAD(&per_cpu(blk_mq_comp_batch, i).list);
+
 	cpuhp_setup_state_multi(CPUHP_BLK_MQ_DEAD, "block/mq:dead", NULL,
 				blk_mq_hctx_notify_dead);
 	return 0;
@@ -40,6 +40,13 @@ bool blk_mq_get_driver_tag(struct request *rq);
 struct request *blk_mq_dequeue_from_ctx(struct blk_mq_hw_ctx *hctx,
 					struct blk_mq_ctx *start);
 
+/*
+ * Completion batching, see blk_mq_complete_batch()
+ */
+void blk_mq_complete_batch_run(void);
+void blk_mq_complete_batch_cpu_dead(unsigned int cpu);
+void blk_mq_complete_batch_reset(struct blk_mq_hw_ctx *hctx);
+
 /*
  * Internal helpers for allocating/freeing the request map
  */
@@ -7,12 +7,14 @@
 #include <linux/init.h>
 #include <linux/bio.h>
 #include <linux/blkdev.h>
+#include <linux/blk-mq.h>
 #include <linux/interrupt.h>
 #include <linux/cpu.h>
 #include <linux/sched.h>
 #include <linux/sched/topology.h>
 
 #include "blk.h"
+#include "blk-mq.h"
 
 static DEFINE_PER_CPU(struct list_head, blk_cpu_done);
 
@@ -36,6 +38,8 @@ static __latent_entropy void blk_done_softirq(struct softirq_action *h)
 		list_del_init(&rq->ipi_list);
 		rq->q->softirq_done_fn(rq);
 	}
+
+	blk_mq_complete_batch_run();
 }
 
 #ifdef CONFIG_SMP
@@ -89,6 +93,7 @@ static int blk_softirq_cpu_dead(unsigned int cpu)
 	local_irq_disable();
 	list_splice_init(&per_cpu(blk_cpu_done, cpu),
 			 this_cpu_ptr(&blk_cpu_done));
+	blk_mq_complete_batch_cpu_dead(cpu);
 	raise_softirq_irqoff(BLOCK_SOFTIRQ);
 	local_irq_enable();
 
@@ -6,6 +6,7 @@
 #include <linux/kernel.h>
 #include <linux/rculist.h>
 #include <linux/blk-mq.h>
+#include <linux/seq_file.h>
 
 #include "blk-stat.h"
 #include "blk-mq.h"
@@ -47,11 +48,95 @@ void blk_rq_stat_add(struct blk_rq_stat *stat, u64 value)
 	stat->nr_samples++;
 }
 
+static unsigned int blk_rq_hist_bucket(u64 value)
+{
+	unsigned int msb, bucket;
+
+	value >>= BLK_RQ_HIST_SHIFT;
+	if (value < BLK_RQ_HIST_SUB)
+		return value;
+
+	msb = fls64(value) - 1;
+	bucket = (msb - BLK_RQ_HIST_SUB_BITS + 1) * BLK_RQ_HIST_SUB +
+		 ((value >> (msb - BLK_RQ_HIST_SUB_BITS)) &
+		  (BLK_RQ_HIST_SUB - 1));
+
+	return min(bucket, BLK_RQ_HIST_BUCKETS - 1);
+}
+
+/* Upper bound of the latencies counted in @bucket, in ns */
+static u64 blk_rq_hist_bucket_max(unsigned int bucket)
+{
+	unsigned int msb;
+	u64 value;
+
+	if (bucket < BLK_RQ_HIST_SUB) {
+		value = bucket + 1;
+	} else {
+		msb = bucket / BLK_RQ_HIST_SUB + BLK_RQ_HIST_SUB_BITS - 1;
+		value = (1ULL << msb) +
+			((u64)(bucket % BLK_RQ_HIST_SUB + 1) <<
+			 (msb - BLK_RQ_HIST_SUB_BITS));
+	}
+
+	return value << BLK_RQ_HIST_SHIFT;
+}
+
+static void blk_rq_hist_add(struct blk_rq_hist *hist, u64 value)
+{
+	hist->buckets[blk_rq_hist_bucket(value)]++;
+	hist->nr_samples++;
+}
+
+/* Merge @src into @dst and reset it */
+static void blk_rq_hist_sum(struct blk_rq_hist *dst, struct blk_rq_hist *src)
+{
+	unsigned int i;
+
+	if (!src->nr_samples)
+		return;
+
+	for (i = 0; i < BLK_RQ_HIST_BUCKETS; i++)
+		dst->buckets[i] += src->buckets[i];
+	dst->nr_samples += src->nr_samples;
+
+	memset(src, 0, sizeof(*src));
+}
+
+static u64 blk_rq_hist_percentile(const struct blk_rq_hist *hist,
+				  unsigned int pct)
+{
+	u64 samples = 0, target;
+	unsigned int i;
+
+	if (!hist->nr_samples)
+		return 0;
+
+	target = DIV_ROUND_UP_ULL((u64)hist->nr_samples * min(pct, 100U), 100);
+	for (i = 0; i < BLK_RQ_HIST_BUCKETS - 1; i++) {
+		samples += hist->buckets[i];
+		if (samples >= target)
+			break;
+	}
+
+	return blk_rq_hist_bucket_max(i);
+}
+
+u64 blk_stat_percentile(struct blk_stat_callback *cb, unsigned int bucket,
+			unsigned int pct)
+{
+	if (!cb->hist || bucket >= cb->buckets)
+		return 0;
+	return blk_rq_hist_percentile(&cb->hist[bucket], pct);
+}
+EXPORT_SYMBOL_GPL(blk_stat_percentile);
+
 void blk_stat_add(struct request *rq, u64 now)
 {
 	struct request_queue *q = rq->q;
 	struct blk_stat_callback *cb;
 	struct blk_rq_stat *stat;
+	struct blk_rq_hist __percpu *cpu_hist;
 	int bucket;
 	u64 value;
 
@@ -70,6 +155,9 @@ void blk_stat_add(struct request *rq, u64 now)
 
 		stat = &get_cpu_ptr(cb->cpu_stat)[bucket];
 		blk_rq_stat_add(stat, value);
+		cpu_hist = READ_ONCE(cb->cpu_hist);
+		if (cpu_hist && READ_ONCE(cb->hist_on))
+			blk_rq_hist_add(&this_cpu_ptr(cpu_hist)[bucket], value);
 		put_cpu_ptr(cb->cpu_stat);
 	}
 	rcu_read_unlock();
@@ -78,20 +166,31 @@ void blk_stat_add(struct request *rq, u64 now)
 static void blk_stat_timer_fn(struct timer_list *t)
 {
 	struct blk_stat_callback *cb = from_timer(cb, t, timer);
+	struct blk_rq_hist __percpu *hists = smp_load_acquire(&cb->cpu_hist);
 	unsigned int bucket;
 	int cpu;
 
 	for (bucket = 0; bucket < cb->buckets; bucket++)
 		blk_rq_stat_init(&cb->stat[bucket]);
+	if (hists)
+		memset(cb->hist, 0, cb->buckets * sizeof(*cb->hist));
 
 	for_each_online_cpu(cpu) {
 		struct blk_rq_stat *cpu_stat;
+		struct blk_rq_hist *cpu_hist;
 
 		cpu_stat = per_cpu_ptr(cb->cpu_stat, cpu);
 		for (bucket = 0; bucket < cb->buckets; bucket++) {
 			blk_rq_stat_sum(&cb->stat[bucket], &cpu_stat[bucket]);
 			blk_rq_stat_init(&cpu_stat[bucket]);
 		}
+
+		if (!hists)
+			continue;
+
+		cpu_hist = per_cpu_ptr(hists, cpu);
+		for (bucket = 0; bucket < cb->buckets; bucket++)
+			blk_rq_hist_sum(&cb->hist[bucket], &cpu_hist[bucket]);
 	}
 
 	cb->timer_fn(cb);
@@ -126,12 +225,47 @@ blk_stat_alloc_callback(void (*timer_fn)(struct blk_stat_callback *),
 	cb->bucket_fn = bucket_fn;
 	cb->data = data;
 	cb->buckets = buckets;
+	cb->cpu_hist = NULL;
+	cb->hist = NULL;
+	cb->hist_on = false;
 	timer_setup(&cb->timer, blk_stat_timer_fn, 0);
 
 	return cb;
 }
 EXPORT_SYMBOL_GPL(blk_stat_alloc_callback);
 
+int blk_stat_enable_hist(struct blk_stat_callback *cb)
+{
+	struct blk_rq_hist __percpu *cpu_hist;
+
+	if (!cb->cpu_hist) {
+		cb->hist = kcalloc(cb->buckets, sizeof(*cb->hist), GFP_KERNEL);
+		if (!cb->hist)
+			return -ENOMEM;
+
+		cpu_hist = __alloc_percpu(cb->buckets * sizeof(*cb->hist),
+					  __alignof__(struct blk_rq_hist));
+		if (!cpu_hist) {
+			kfree(cb->hist);
+			cb->hist = NULL;
+			return -ENOMEM;
+		}
+
+		/* The timer and completions may already be looking */
+		smp_store_release(&cb->cpu_hist, cpu_hist);
+	}
+
+	WRITE_ONCE(cb->hist_on, true);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(blk_stat_enable_hist);
+
+void blk_stat_disable_hist(struct blk_stat_callback *cb)
+{
+	WRITE_ONCE(cb->hist_on, false);
+}
+EXPORT_SYMBOL_GPL(blk_stat_disable_hist);
+
 void blk_stat_add_callback(struct request_queue *q,
 			   struct blk_stat_callback *cb)
 {
@@ -171,6 +305,8 @@ static void blk_stat_free_callback_rcu(struct rcu_head *head)
 	struct blk_stat_callback *cb;
 
 	cb = container_of(head, struct blk_stat_callback, rcu);
+	free_percpu(cb->cpu_hist);
+	kfree(cb->hist);
 	free_percpu(cb->cpu_stat);
 	kfree(cb->stat);
 	kfree(cb);
@@ -183,6 +319,33 @@ void blk_stat_free_callback(struct blk_stat_callback *cb)
 }
 EXPORT_SYMBOL_GPL(blk_stat_free_callback);
 
+/* Percentiles of the last window of the callbacks keeping histograms */
+void blk_stat_show_hist(struct request_queue *q, struct seq_file *m)
+{
+	struct blk_stat_callback *cb;
+	struct blk_rq_hist *hist;
+	unsigned int bucket;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(cb, &q->stats->callbacks, list) {
+		if (!READ_ONCE(cb->hist_on) || !smp_load_acquire(&cb->cpu_hist))
+			continue;
+
+		for (bucket = 0; bucket < cb->buckets; bucket++) {
+			hist = &cb->hist[bucket];
+			seq_printf(m, "%ps bucket %u: samples=%u", cb->timer_fn,
+				   bucket, hist->nr_samples);
+			if (hist->nr_samples)
+				seq_printf(m, ", p50=%llu, p90=%llu, p99=%llu",
+					   blk_rq_hist_percentile(hist, 50),
+					   blk_rq_hist_percentile(hist, 90),
+					   blk_rq_hist_percentile(hist, 99));
+			seq_puts(m, "\n");
+		}
+	}
+	rcu_read_unlock();
+}
+
 void blk_stat_enable_accounting(struct request_queue *q)
 {
 	spin_lock(&q->stats->lock);
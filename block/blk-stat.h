@@ -8,6 +8,26 @@
 #include <linux/rcupdate.h>
 #include <linux/timer.h>
 
+struct seq_file;
+
+/*
+ * Log-linear latency histogram: latencies are counted in units of
+ * 2^BLK_RQ_HIST_SHIFT ns, with 2^BLK_RQ_HIST_SUB_BITS linear buckets per power
+ * of two, up to 2^BLK_RQ_HIST_MAX_BITS units (about 68 seconds). The bucket
+ * width is at most a quarter of the latencies it counts.
+ */
+#define BLK_RQ_HIST_SHIFT	10
+#define BLK_RQ_HIST_SUB_BITS	2
+#define BLK_RQ_HIST_SUB		(1U << BLK_RQ_HIST_SUB_BITS)
+#define BLK_RQ_HIST_MAX_BITS	26
+#define BLK_RQ_HIST_BUCKETS	\
+	((BLK_RQ_HIST_MAX_BITS - BLK_RQ_HIST_SUB_BITS + 1) * BLK_RQ_HIST_SUB)
+
+struct blk_rq_hist {
+	u32 nr_samples;
+	u32 buckets[BLK_RQ_HIST_BUCKETS];
+};
+
 /**
  * struct blk_stat_callback - Block statistics callback.
  *
@@ -49,6 +69,23 @@ struct blk_stat_callback {
 	 */
 	struct blk_rq_stat *stat;
 
+	/**
+	 * @cpu_hist: Per-cpu latency histograms of the statistics buckets,
+	 * NULL until first enabled with blk_stat_enable_hist().
+	 */
+	struct blk_rq_hist __percpu *cpu_hist;
+
+	/**
+	 * @hist_on: Whether completions are added to the histograms.
+	 */
+	bool hist_on;
+
+	/**
+	 * @hist: Array of latency histograms of the statistics buckets, over
+	 * the last window.
+	 */
+	struct blk_rq_hist *hist;
+
 	/**
 	 * @fn: Callback function.
 	 */
@@ -86,6 +123,39 @@ blk_stat_alloc_callback(void (*timer_fn)(struct blk_stat_callback *),
 			int (*bucket_fn)(const struct request *),
 			unsigned int buckets, void *data);
 
+/**
+ * blk_stat_enable_hist() - Also keep latency histograms in a block statistics
+ * callback.
+ * @cb: The callback.
+ *
+ * The histograms are allocated the first time, and kept until the callback is
+ * freed. May sleep, and must be serialized with blk_stat_disable_hist() by the
+ * caller.
+ *
+ * Return: 0 on success or -ENOMEM.
+ */
+int blk_stat_enable_hist(struct blk_stat_callback *cb);
+
+/**
+ * blk_stat_disable_hist() - Stop adding completions to the latency histograms
+ * of a block statistics callback.
+ * @cb: The callback.
+ */
+void blk_stat_disable_hist(struct blk_stat_callback *cb);
+
+/**
+ * blk_stat_percentile() - Latency percentile of a statistics bucket.
+ * @cb: The callback, from its @timer_fn.
+ * @bucket: The statistics bucket.
+ * @pct: The percentile, from 1 to 100.
+ *
+ * Return: Upper bound in nanoseconds of the histogram bucket holding the
+ * @pct percentile of the latencies of the last window, or 0 if there were none
+ * or histograms are not enabled.
+ */
+u64 blk_stat_percentile(struct blk_stat_callback *cb, unsigned int bucket,
+			unsigned int pct);
+
 /**
  * blk_stat_add_callback() - Add a block statistics callback to be run on a
  * request queue.
@@ -168,4 +238,6 @@ void blk_rq_stat_add(struct blk_rq_stat *, u64);
 void blk_rq_stat_sum(struct blk_rq_stat *, struct blk_rq_stat *);
 void blk_rq_stat_init(struct blk_rq_stat *);
 
+void blk_stat_show_hist(struct request_queue *q, struct seq_file *m);
+
 #endif
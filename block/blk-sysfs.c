@@ -420,6 +420,38 @@ static ssize_t queue_poll_store(struct request_queue *q, const char *page,
 	return ret;
 }
 
+static ssize_t queue_comp_batch_show(struct request_queue *q, char *page)
+{
+	return queue_var_show(test_bit(QUEUE_FLAG_COMP_BATCH, &q->queue_flags),
+			      page);
+}
+
+static ssize_t queue_comp_batch_store(struct request_queue *q,
+				      const char *page, size_t count)
+{
+	struct blk_mq_hw_ctx *hctx;
+	unsigned long batch_on;
+	ssize_t ret;
+	int i;
+
+	if (!q->mq_ops)
+		return -EINVAL;
+
+	ret = queue_var_store(&batch_on, page, count);
+	if (ret < 0)
+		return ret;
+
+	if (batch_on) {
+		/* Start the stats afresh, for the IOPS of the batch mode */
+		if (!blk_queue_flag_test_and_set(QUEUE_FLAG_COMP_BATCH, q))
+			queue_for_each_hw_ctx(q, hctx, i)
+				blk_mq_complete_batch_reset(hctx);
+	} else
+		blk_queue_flag_clear(QUEUE_FLAG_COMP_BATCH, q);
+
+	return ret;
+}
+
 static ssize_t queue_wb_lat_show(struct request_queue *q, char *page)
 {
 	if (!wbt_rq_qos(q))
@@ -476,6 +508,60 @@ static ssize_t queue_wb_lat_store(struct request_queue *q, const char *page,
 	return count;
 }
 
+static ssize_t queue_wb_lat_pct_show(struct request_queue *q, char *page)
+{
+	if (!wbt_rq_qos(q))
+		return -EINVAL;
+
+	return sprintf(page, "%u\n", wbt_get_lat_pct(q));
+}
+
+static ssize_t queue_wb_lat_pct_store(struct request_queue *q,
+				      const char *page, size_t count)
+{
+	unsigned long pct;
+	ssize_t ret;
+	int err;
+
+	ret = queue_var_store(&pct, page, count);
+	if (ret < 0)
+		return ret;
+	if (pct > 100)
+		return -EINVAL;
+	if (!wbt_rq_qos(q))
+		return -EINVAL;
+
+	err = wbt_set_lat_pct(q, pct);
+	return err ? err : ret;
+}
+
+static ssize_t queue_wb_gc_mode_show(struct request_queue *q, char *page)
+{
+	if (!wbt_rq_qos(q))
+		return -EINVAL;
+
+	return sprintf(page, "%u\n", wbt_get_gc_mode(q));
+}
+
+static ssize_t queue_wb_gc_mode_store(struct request_queue *q,
+				      const char *page, size_t count)
+{
+	unsigned long mode;
+	ssize_t ret;
+	int err;
+
+	ret = queue_var_store(&mode, page, count);
+	if (ret < 0)
+		return ret;
+	if (mode > 1)
+		return -EINVAL;
+	if (!wbt_rq_qos(q))
+		return -EINVAL;
+
+	err = wbt_set_gc_mode(q, mode);
+	return err ? err : ret;
+}
+
 static ssize_t queue_wc_show(struct request_queue *q, char *page)
 {
 	if (test_bit(QUEUE_FLAG_WC, &q->queue_flags))
@@ -673,6 +759,12 @@ static struct queue_sysfs_entry queue_poll_delay_entry = {
 	.store = queue_poll_delay_store,
 };
 
+static struct queue_sysfs_entry queue_comp_batch_entry = {
+	.attr = {.name = "io_comp_batch", .mode = 0644 },
+	.show = queue_comp_batch_show,
+	.store = queue_comp_batch_store,
+};
+
 static struct queue_sysfs_entry queue_wc_entry = {
 	.attr = {.name = "write_cache", .mode = 0644 },
 	.show = queue_wc_show,
@@ -695,6 +787,18 @@ static struct queue_sysfs_entry queue_wb_lat_entry = {
 	.store = queue_wb_lat_store,
 };
 
+static struct queue_sysfs_entry queue_wb_lat_pct_entry = {
+	.attr = {.name = "wbt_lat_pct", .mode = 0644 },
+	.show = queue_wb_lat_pct_show,
+	.store = queue_wb_lat_pct_store,
+};
+
+static struct queue_sysfs_entry queue_wb_gc_mode_entry = {
+	.attr = {.name = "wbt_gc_mode", .mode = 0644 },
+	.show = queue_wb_gc_mode_show,
+	.store = queue_wb_gc_mode_store,
+};
+
 #ifdef CONFIG_BLK_DEV_THROTTLING_LOW
 static struct queue_sysfs_entry throtl_sample_time_entry = {
 	.attr = {.name = "throttle_sample_time", .mode = 0644 },
@@ -736,7 +840,10 @@ static struct attribute *default_attrs[] = {
 	&queue_fua_entry.attr,
 	&queue_dax_entry.attr,
 	&queue_wb_lat_entry.attr,
+	&queue_wb_lat_pct_entry.attr,
+	&queue_wb_gc_mode_entry.attr,
 	&queue_poll_delay_entry.attr,
+	&queue_comp_batch_entry.attr,
 #ifdef CONFIG_BLK_DEV_THROTTLING_LOW
 	&throtl_sample_time_entry.attr,
 #endif
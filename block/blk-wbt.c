@@ -14,6 +14,10 @@
  *   scaling step of 0 if reads show up or the heavy writers finish. Unlike
  *   positive scaling steps where we shrink the monitoring window, a negative
  *   scaling step retains the default step==0 window size.
+ * - In gc mode, also scale down when the write latency rises sharply, or
+ *   when the writes in flight would take too long to drain. Flash devices
+ *   doing garbage collection get slow on writes before reads queue up
+ *   behind them, so this backs off before the read latency suffers.
  *
  * Copyright (C) 2016 Jens Axboe
  *
@@ -33,6 +37,7 @@
 static inline void wbt_clear_state(struct request *rq)
 {
 	rq->wbt_flags = 0;
+	rq->wbt_sectors = 0;
 }
 
 static inline enum wbt_flags wbt_flags(struct request *rq)
@@ -72,6 +77,25 @@ enum {
 	 * information to scale up or down, scale up.
 	 */
 	RWB_UNKNOWN_BUMP	= 5,
+
+	/*
+	 * In gc mode, percentile of the write latencies of a window that
+	 * is compared to their moving average, and how far above the
+	 * average it may go before we back off.
+	 */
+	RWB_GC_WLAT_PCT		= 90,
+	RWB_GC_RISE_PCT		= 200,
+
+	/*
+	 * Weight of the last window in the moving average, as a shift
+	 */
+	RWB_GC_EWMA_SHIFT	= 3,
+
+	/*
+	 * In gc mode, the writes in flight may take this many times the
+	 * latency target to drain, at the rate of the last window.
+	 */
+	RWB_GC_DRAIN_MULT	= 4,
 };
 
 static inline bool rwb_enabled(struct rq_wb *rwb)
@@ -165,6 +189,21 @@ static void wbt_rqw_done(struct rq_wb *rwb, struct rq_wait *rqw,
 	}
 }
 
+/*
+ * Account the end of a tracked write issued to the device, @done if it
+ * completed rather than got requeued.
+ */
+static void wbt_sectors_done(struct rq_wb *rwb, struct request *rq, bool done)
+{
+	if (!rq->wbt_sectors)
+		return;
+
+	atomic_sub(rq->wbt_sectors, &rwb->inflight_sectors);
+	if (done)
+		atomic_add(rq->wbt_sectors, &rwb->comp_sectors);
+	rq->wbt_sectors = 0;
+}
+
 static void __wbt_done(struct rq_qos *rqos, enum wbt_flags wb_acct)
 {
 	struct rq_wb *rwb = RQWB(rqos);
@@ -195,6 +234,7 @@ static void wbt_done(struct rq_qos *rqos, struct request *rq)
 			wb_timestamp(rwb, &rwb->last_comp);
 	} else {
 		WARN_ON_ONCE(rq == rwb->sync_cookie);
+		wbt_sectors_done(rwb, rq, true);
 		__wbt_done(rqos, wbt_flags(rq));
 	}
 	wbt_clear_state(rq);
@@ -228,12 +268,14 @@ enum {
 	LAT_UNKNOWN,
 	LAT_UNKNOWN_WRITES,
 	LAT_EXCEEDED,
+	LAT_WRITE_PRESSURE,
 };
 
 static int latency_exceeded(struct rq_wb *rwb, struct blk_rq_stat *stat)
 {
 	struct backing_dev_info *bdi = rwb->rqos.q->backing_dev_info;
 	struct rq_depth *rqd = &rwb->rq_depth;
+	unsigned int lat_pct = READ_ONCE(rwb->lat_pct);
 	u64 thislat;
 
 	/*
@@ -269,10 +311,14 @@ static int latency_exceeded(struct rq_wb *rwb, struct blk_rq_stat *stat)
 	}
 
 	/*
-	 * If the 'min' latency exceeds our target, step down.
+	 * If the 'min' latency, or the configured percentile of the read
+	 * latencies, exceeds our target, step down.
 	 */
-	if (stat[READ].min > rwb->min_lat_nsec) {
-		trace_wbt_lat(bdi, stat[READ].min);
+	thislat = stat[READ].min;
+	if (lat_pct)
+		thislat = blk_stat_percentile(rwb->cb, READ, lat_pct);
+	if (thislat > rwb->min_lat_nsec) {
+		trace_wbt_lat(bdi, thislat);
 		trace_wbt_stat(bdi, stat);
 		return LAT_EXCEEDED;
 	}
@@ -289,7 +335,44 @@ static void rwb_trace_step(struct rq_wb *rwb, const char *msg)
 	struct rq_depth *rqd = &rwb->rq_depth;
 
 	trace_wbt_step(bdi, msg, rqd->scale_step, rwb->cur_win_nsec,
-			rwb->wb_background, rwb->wb_normal, rqd->max_depth);
+			rwb->wb_background, rwb->wb_normal, rqd->max_depth,
+			rwb->wlat, rwb->wlat_avg,
+			atomic_read(&rwb->inflight_sectors),
+			rwb->drain_sectors);
+}
+
+/*
+ * Update the write pressure model with the last window, and return true if
+ * we should back off. That's the case if the write latency went well above
+ * its moving average, or if the writes in flight would take more than a
+ * few latency targets to complete at the rate they did in the window. A
+ * stalled device, with writes in flight but none completed, backs off too.
+ */
+static bool wbt_write_pressure(struct rq_wb *rwb, struct blk_rq_stat *stat)
+{
+	u64 comp = atomic_xchg(&rwb->comp_sectors, 0);
+	unsigned int inflight = atomic_read(&rwb->inflight_sectors);
+	bool rising = false;
+
+	rwb->drain_sectors = min_t(u64, UINT_MAX,
+				   div64_u64(comp * rwb->min_lat_nsec *
+					     RWB_GC_DRAIN_MULT,
+					     rwb->cur_win_nsec));
+
+	if (stat[WRITE].nr_samples >= RWB_MIN_WRITE_SAMPLES) {
+		rwb->wlat = blk_stat_percentile(rwb->cb, WRITE,
+						RWB_GC_WLAT_PCT);
+		if (!rwb->wlat_avg) {
+			rwb->wlat_avg = rwb->wlat;
+		} else {
+			rising = rwb->wlat * 100 >
+				 rwb->wlat_avg * RWB_GC_RISE_PCT;
+			rwb->wlat_avg += (rwb->wlat >> RWB_GC_EWMA_SHIFT) -
+					 (rwb->wlat_avg >> RWB_GC_EWMA_SHIFT);
+		}
+	}
+
+	return rising || inflight > rwb->drain_sectors;
 }
 
 static void calc_wb_limits(struct rq_wb *rwb)
@@ -356,6 +439,9 @@ static void wb_timer_fn(struct blk_stat_callback *cb)
 	int status;
 
 	status = latency_exceeded(rwb, cb->stat);
+	if (READ_ONCE(rwb->gc_mode) && wbt_write_pressure(rwb, cb->stat) &&
+	    status != LAT_EXCEEDED)
+		status = LAT_WRITE_PRESSURE;
 
 	trace_wbt_timer(rwb->rqos.q->backing_dev_info, status, rqd->scale_step,
 			inflight);
@@ -369,6 +455,14 @@ static void wb_timer_fn(struct blk_stat_callback *cb)
 	case LAT_EXCEEDED:
 		scale_down(rwb, true);
 		break;
+	case LAT_WRITE_PRESSURE:
+		/*
+		 * Reads are still fine, but writes are slowing down. Back
+		 * off one step, without dropping a negative step to the
+		 * center as if reads had suffered.
+		 */
+		scale_down(rwb, false);
+		break;
 	case LAT_OK:
 		scale_up(rwb);
 		break;
@@ -443,6 +537,66 @@ void wbt_set_min_lat(struct request_queue *q, u64 val)
 	__wbt_update_limits(RQWB(rqos));
 }
 
+unsigned int wbt_get_lat_pct(struct request_queue *q)
+{
+	struct rq_qos *rqos = wbt_rq_qos(q);
+	if (!rqos)
+		return 0;
+	return RQWB(rqos)->lat_pct;
+}
+
+/*
+ * Only a read percentile and the gc mode use the latency histograms, don't
+ * make every completion pay for them otherwise. Serialized by the sysfs lock.
+ */
+static int wbt_update_hist(struct rq_wb *rwb, unsigned int lat_pct,
+			   unsigned int gc_mode)
+{
+	if (lat_pct || gc_mode)
+		return blk_stat_enable_hist(rwb->cb);
+
+	blk_stat_disable_hist(rwb->cb);
+	return 0;
+}
+
+int wbt_set_lat_pct(struct request_queue *q, unsigned int pct)
+{
+	struct rq_qos *rqos = wbt_rq_qos(q);
+	int ret;
+
+	if (!rqos)
+		return 0;
+	ret = wbt_update_hist(RQWB(rqos), pct, RQWB(rqos)->gc_mode);
+	if (ret)
+		return ret;
+	WRITE_ONCE(RQWB(rqos)->lat_pct, pct);
+	return 0;
+}
+
+unsigned int wbt_get_gc_mode(struct request_queue *q)
+{
+	struct rq_qos *rqos = wbt_rq_qos(q);
+	if (!rqos)
+		return 0;
+	return RQWB(rqos)->gc_mode;
+}
+
+int wbt_set_gc_mode(struct request_queue *q, unsigned int mode)
+{
+	struct rq_qos *rqos = wbt_rq_qos(q);
+	int ret;
+
+	if (!rqos)
+		return 0;
+	ret = wbt_update_hist(RQWB(rqos), RQWB(rqos)->lat_pct, mode);
+	if (ret)
+		return ret;
+	/* The model restarts from scratch, the timer isn't synchronized */
+	RQWB(rqos)->wlat = RQWB(rqos)->wlat_avg = 0;
+	WRITE_ONCE(RQWB(rqos)->gc_mode, mode);
+	return 0;
+}
+
 
 static bool close_io(struct rq_wb *rwb)
 {
@@ -668,11 +822,26 @@ void wbt_issue(struct rq_qos *rqos, struct request *rq)
 		rwb->sync_cookie = rq;
 		rwb->sync_issue = rq->io_start_time_ns;
 	}
+
+	/*
+	 * Account the size of the writes in flight. Discards don't tell how
+	 * busy the device is, and the size is gone once the request is
+	 * completed, so we store it.
+	 */
+	if ((wbt_flags(rq) & (WBT_TRACKED | WBT_DISCARD)) == WBT_TRACKED) {
+		rq->wbt_sectors = min_t(unsigned int, blk_rq_sectors(rq),
+					USHRT_MAX);
+		atomic_add(rq->wbt_sectors, &rwb->inflight_sectors);
+	}
 }
 
 void wbt_requeue(struct rq_qos *rqos, struct request *rq)
 {
 	struct rq_wb *rwb = RQWB(rqos);
+
+	/* Issued again later, when it gets accounted again */
+	wbt_sectors_done(rwb, rq, false);
+
 	if (!rwb_enabled(rwb))
 		return;
 	if (rq == rwb->sync_cookie) {
@@ -64,6 +64,18 @@ struct rq_wb {
 	unsigned long last_issue;		/* last non-throttled issue */
 	unsigned long last_comp;		/* last non-throttled comp */
 	unsigned long min_lat_nsec;
+	unsigned int lat_pct;			/* read percentile, 0 for min */
+
+	/*
+	 * Write pressure model of gc mode, see wbt_write_pressure()
+	 */
+	unsigned int gc_mode;
+	atomic_t inflight_sectors;		/* tracked writes issued */
+	atomic_t comp_sectors;			/* tracked writes completed */
+	u64 wlat;				/* last window write latency */
+	u64 wlat_avg;				/* moving average of wlat */
+	unsigned int drain_sectors;		/* outstanding writes limit */
+
 	struct rq_qos rqos;
 	struct rq_wait rq_wait[WBT_NUM_RWQ];
 	struct rq_depth rq_depth;
@@ -95,6 +107,12 @@ void wbt_enable_default(struct request_queue *);
 u64 wbt_get_min_lat(struct request_queue *q);
 void wbt_set_min_lat(struct request_queue *q, u64 val);
 
+unsigned int wbt_get_lat_pct(struct request_queue *q);
+int wbt_set_lat_pct(struct request_queue *q, unsigned int pct);
+
+unsigned int wbt_get_gc_mode(struct request_queue *q);
+int wbt_set_gc_mode(struct request_queue *q, unsigned int mode);
+
 void wbt_set_queue_depth(struct request_queue *, unsigned int);
 void wbt_set_write_cache(struct request_queue *, bool);
 
@@ -131,6 +149,22 @@ static inline u64 wbt_get_min_lat(struct request_queue *q)
 static inline void wbt_set_min_lat(struct request_queue *q, u64 val)
 {
 }
+static inline unsigned int wbt_get_lat_pct(struct request_queue *q)
+{
+	return 0;
+}
+static inline int wbt_set_lat_pct(struct request_queue *q, unsigned int pct)
+{
+	return 0;
+}
+static inline unsigned int wbt_get_gc_mode(struct request_queue *q)
+{
+	return 0;
+}
+static inline int wbt_set_gc_mode(struct request_queue *q, unsigned int mode)
+{
+	return 0;
+}
 static inline u64 wbt_default_latency_nsec(struct request_queue *q)
 {
 	return 0;
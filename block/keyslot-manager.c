@@ -24,12 +24,18 @@
  *
  * Upper layers will call keyslot_manager_get_slot_for_key() to program a
  * key into some slot in the inline encryption hardware.
+ *
+ * Keys already in use by some request are looked up under RCU and grabbed by
+ * taking one more reference to their slot, without ksm->lock.  Since a slot
+ * is only reprogrammed or evicted once idle, i.e. with no reference, the key
+ * of a slot we hold a reference to can't change under us.
  */
 #include <crypto/algapi.h>
 #include <linux/keyslot-manager.h>
 #include <linux/atomic.h>
 #include <linux/mutex.h>
 #include <linux/pm_runtime.h>
+#include <linux/rculist.h>
 #include <linux/wait.h>
 #include <linux/blkdev.h>
 
@@ -63,9 +69,10 @@ struct keyslot_manager {
 
 	/*
 	 * Hash table which maps key hashes to keyslots, so that we can find a
-	 * key's keyslot in O(1) time rather than O(num_slots).  Protected by
-	 * 'lock'.  A cryptographic hash function is used so that timing attacks
-	 * can't leak information about the raw keys.
+	 * key's keyslot in O(1) time rather than O(num_slots).  Modified under
+	 * 'lock', walked under either 'lock' or RCU.  A cryptographic hash
+	 * function is used so that timing attacks can't leak information about
+	 * the raw keys.
 	 */
 	struct hlist_head *slot_hashtable;
 	unsigned int slot_hashtable_size;
@@ -240,23 +247,66 @@ static void remove_slot_from_lru_list(struct keyslot_manager *ksm, int slot)
 	spin_unlock_irqrestore(&ksm->idle_slots_lock, flags);
 }
 
+static bool keyslot_has_key(const struct keyslot *slotp,
+			    const struct blk_crypto_key *key)
+{
+	return slotp->key.hash == key->hash &&
+	       slotp->key.crypto_mode == key->crypto_mode &&
+	       slotp->key.size == key->size &&
+	       slotp->key.data_unit_size == key->data_unit_size &&
+	       !crypto_memneq(slotp->key.raw, key->raw, key->size);
+}
+
+/*
+ * Called with ksm->lock held, or under RCU in which case the result may be
+ * stale, or even wrong as the key of an idle slot may be rewritten while we
+ * compare it.
+ */
 static int find_keyslot(struct keyslot_manager *ksm,
 			const struct blk_crypto_key *key)
 {
 	const struct hlist_head *head = hash_bucket_for_key(ksm, key);
 	const struct keyslot *slotp;
 
-	hlist_for_each_entry(slotp, head, hash_node) {
-		if (slotp->key.hash == key->hash &&
-		    slotp->key.crypto_mode == key->crypto_mode &&
-		    slotp->key.size == key->size &&
-		    slotp->key.data_unit_size == key->data_unit_size &&
-		    !crypto_memneq(slotp->key.raw, key->raw, key->size))
+	hlist_for_each_entry_rcu(slotp, head, hash_node) {
+		if (keyslot_has_key(slotp, key))
 			return slotp - ksm->slots;
 	}
 	return -ENOKEY;
 }
 
+/*
+ * Grab the slot of @key if it's already in use, without ksm->lock.  Taking the
+ * first reference of a slot takes it off the LRU list, which is left to the
+ * callers holding ksm->lock.
+ */
+static int find_and_grab_keyslot_rcu(struct keyslot_manager *ksm,
+				     const struct blk_crypto_key *key)
+{
+	struct keyslot *slotp;
+	int slot;
+
+	rcu_read_lock();
+	slot = find_keyslot(ksm, key);
+	rcu_read_unlock();
+	if (slot < 0)
+		return slot;
+
+	slotp = &ksm->slots[slot];
+	if (!atomic_inc_not_zero(&slotp->slot_refs))
+		return -ENOKEY;
+
+	/*
+	 * The slot may have been reprogrammed since we looked at it, but now
+	 * that we hold a reference it can't be anymore: check the key again.
+	 */
+	if (!keyslot_has_key(slotp, key)) {
+		keyslot_manager_put_slot(ksm, slot);
+		return -ENOKEY;
+	}
+	return slot;
+}
+
 static int find_and_grab_keyslot(struct keyslot_manager *ksm,
 				 const struct blk_crypto_key *key)
 {
@@ -282,7 +332,8 @@ static int find_and_grab_keyslot(struct keyslot_manager *ksm,
  * exists, return it with incremented refcount.  Otherwise, wait for a keyslot
  * to become idle and program it.
  *
- * Context: Process context. Takes and releases ksm->lock.
+ * Context: Process context. Takes and releases ksm->lock, unless the key is
+ *	    already in use.
  * Return: The keyslot on success, else a -errno value.
  */
 int keyslot_manager_get_slot_for_key(struct keyslot_manager *ksm,
@@ -295,6 +346,10 @@ int keyslot_manager_get_slot_for_key(struct keyslot_manager *ksm,
 	if (keyslot_manager_is_passthrough(ksm))
 		return 0;
 
+	slot = find_and_grab_keyslot_rcu(ksm, key);
+	if (slot >= 0)
+		return slot;
+
 	down_read(&ksm->lock);
 	slot = find_and_grab_keyslot(ksm, key);
 	up_read(&ksm->lock);
@@ -332,16 +387,21 @@ int keyslot_manager_get_slot_for_key(struct keyslot_manager *ksm,
 		return err;
 	}
 
-	/* Move this slot to the hash list for the new key. */
+	/*
+	 * Move this slot to the hash list for the new key.  Lockless lookups
+	 * racing with the move may miss a key and fall back to taking the lock,
+	 * or find the wrong slot and check the key again once it's grabbed.
+	 */
 	if (idle_slot->key.crypto_mode != BLK_ENCRYPTION_MODE_INVALID)
-		hlist_del(&idle_slot->hash_node);
-	hlist_add_head(&idle_slot->hash_node, hash_bucket_for_key(ksm, key));
-
-	atomic_set(&idle_slot->slot_refs, 1);
+		hlist_del_rcu(&idle_slot->hash_node);
 	idle_slot->key = *key;
+	hlist_add_head_rcu(&idle_slot->hash_node, hash_bucket_for_key(ksm, key));
 
 	remove_slot_from_lru_list(ksm, slot);
 
+	/* Publish the new key before lockless lookups can grab the slot */
+	atomic_set_release(&idle_slot->slot_refs, 1);
+
 	keyslot_manager_hw_exit(ksm);
 	return slot;
 }
@@ -482,7 +542,7 @@ int keyslot_manager_evict_key(struct keyslot_manager *ksm,
 	if (err)
 		goto out_unlock;
 
-	hlist_del(&slotp->hash_node);
+	hlist_del_rcu(&slotp->hash_node);
 	memzero_explicit(&slotp->key, sizeof(slotp->key));
 	err = 0;
 out_unlock:
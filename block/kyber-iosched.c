@@ -19,6 +19,7 @@
 
 #include <linux/kernel.h>
 #include <linux/blkdev.h>
+#include <linux/blk-cgroup.h>
 #include <linux/blk-mq.h>
 #include <linux/elevator.h>
 #include <linux/module.h>
@@ -36,9 +37,29 @@ enum {
 	KYBER_READ,
 	KYBER_SYNC_WRITE,
 	KYBER_OTHER, /* Async writes, discard, etc. */
+	KYBER_FG_READ, /* Reads of the foreground priority class */
 	KYBER_NUM_DOMAINS,
 };
 
+/*
+ * Priority classes of the blkcgs. Reads of foreground blkcgs get tokens of
+ * their own, are dispatched first when a new batch starts, and have their 99th
+ * percentile latency checked against fg_read_lat_nsec, throttling all the other
+ * domains when it's missed.
+ */
+enum {
+	KYBER_PRIO_CLASS_BE,
+	KYBER_PRIO_CLASS_FG,
+	KYBER_NUM_PRIO_CLASSES,
+};
+
+/*
+ * Foreground read latencies are sorted into blk-stat buckets of a quarter of
+ * the target each, the last one gathering everything from twice the target.
+ */
+#define KYBER_FG_LAT_SCALE	4
+#define KYBER_FG_LAT_BUCKETS	(2 * KYBER_FG_LAT_SCALE + 1)
+
 enum {
 	KYBER_MIN_DEPTH = 256,
 
@@ -61,6 +82,7 @@ static const unsigned int kyber_depth[] = {
 	[KYBER_READ] = 256,
 	[KYBER_SYNC_WRITE] = 128,
 	[KYBER_OTHER] = 64,
+	[KYBER_FG_READ] = 64,
 };
 
 /*
@@ -70,6 +92,7 @@ static const unsigned int kyber_batch_size[] = {
 	[KYBER_READ] = 16,
 	[KYBER_SYNC_WRITE] = 8,
 	[KYBER_OTHER] = 8,
+	[KYBER_FG_READ] = 16,
 };
 
 /*
@@ -105,6 +128,9 @@ struct kyber_queue_data {
 
 	/* Target latencies in nanoseconds. */
 	u64 read_lat_nsec, write_lat_nsec;
+
+	/* Target 99th percentile latency of foreground reads in nanoseconds. */
+	u64 fg_read_lat_nsec;
 };
 
 struct kyber_hctx_data {
@@ -122,16 +148,72 @@ struct kyber_hctx_data {
 static int kyber_domain_wake(wait_queue_entry_t *wait, unsigned mode, int flags,
 			     void *key);
 
-static unsigned int kyber_sched_domain(unsigned int op)
+#ifdef CONFIG_BLK_CGROUP
+struct kyber_blkcg_data {
+	struct blkcg_policy_data cpd;
+	unsigned int prio_class;
+};
+
+static struct blkcg_policy blkcg_policy_kyber;
+
+static struct kyber_blkcg_data *cpd_to_kbd(struct blkcg_policy_data *cpd)
+{
+	return cpd ? container_of(cpd, struct kyber_blkcg_data, cpd) : NULL;
+}
+
+static struct kyber_blkcg_data *blkcg_to_kbd(struct blkcg *blkcg)
+{
+	return cpd_to_kbd(blkcg_to_cpd(blkcg, &blkcg_policy_kyber));
+}
+
+static unsigned int kyber_bio_prio_class(struct bio *bio)
+{
+	struct kyber_blkcg_data *kbd;
+	unsigned int prio_class = KYBER_PRIO_CLASS_BE;
+
+	rcu_read_lock();
+	kbd = blkcg_to_kbd(bio_blkcg(bio));
+	if (kbd)
+		prio_class = READ_ONCE(kbd->prio_class);
+	rcu_read_unlock();
+
+	return prio_class;
+}
+#else
+static unsigned int kyber_bio_prio_class(struct bio *bio)
+{
+	return KYBER_PRIO_CLASS_BE;
+}
+#endif /* CONFIG_BLK_CGROUP */
+
+static unsigned int kyber_sched_domain(unsigned int op, unsigned int prio_class)
 {
 	if ((op & REQ_OP_MASK) == REQ_OP_READ)
-		return KYBER_READ;
+		return prio_class == KYBER_PRIO_CLASS_FG ? KYBER_FG_READ :
+							   KYBER_READ;
 	else if ((op & REQ_OP_MASK) == REQ_OP_WRITE && op_is_sync(op))
 		return KYBER_SYNC_WRITE;
 	else
 		return KYBER_OTHER;
 }
 
+static unsigned int kyber_bio_sched_domain(struct bio *bio)
+{
+	unsigned int prio_class = KYBER_PRIO_CLASS_BE;
+
+	if (bio_op(bio) == REQ_OP_READ)
+		prio_class = kyber_bio_prio_class(bio);
+	return kyber_sched_domain(bio->bi_opf, prio_class);
+}
+
+/* Set up by kyber_prepare_request() for the requests we schedule */
+static unsigned int kyber_rq_sched_domain(const struct request *rq)
+{
+	if (rq->rq_flags & RQF_ELVPRIV)
+		return (long)rq->elv.priv[1];
+	return kyber_sched_domain(rq->cmd_flags, KYBER_PRIO_CLASS_BE);
+}
+
 enum {
 	NONE = 0,
 	GOOD = 1,
@@ -261,6 +343,64 @@ static void kyber_adjust_other_depth(struct kyber_queue_data *kqd,
 		sbitmap_queue_resize(&kqd->domain_tokens[KYBER_OTHER], depth);
 }
 
+/*
+ * Status of foreground reads, from the bucket of their 99th percentile
+ * latency.
+ */
+static int kyber_fg_lat_status(struct blk_stat_callback *cb)
+{
+	struct blk_rq_stat *stat = &cb->stat[KYBER_NUM_DOMAINS];
+	unsigned int bucket, nr_samples = 0, samples = 0;
+
+	for (bucket = 0; bucket < KYBER_FG_LAT_BUCKETS; bucket++)
+		nr_samples += stat[bucket].nr_samples;
+	if (!nr_samples)
+		return NONE;
+
+	for (bucket = 0; bucket < KYBER_FG_LAT_BUCKETS - 1; bucket++) {
+		samples += stat[bucket].nr_samples;
+		if (samples * 100ULL >= nr_samples * 99ULL)
+			break;
+	}
+
+	if (bucket >= 2 * KYBER_FG_LAT_SCALE)
+		return AWFUL;
+	else if (bucket >= KYBER_FG_LAT_SCALE)
+		return BAD;
+	else if (bucket < KYBER_FG_LAT_SCALE / 2)
+		return GREAT;
+	else
+		return GOOD;
+}
+
+/*
+ * Throttle all the other domains while foreground reads miss their target,
+ * whatever their own latencies.
+ */
+static void kyber_adjust_fg_depth(struct kyber_queue_data *kqd, int fg_status)
+{
+	unsigned int orig_depth, depth;
+	int i;
+
+	if (!IS_BAD(fg_status))
+		return;
+
+	for (i = 0; i < KYBER_NUM_DOMAINS; i++) {
+		if (i == KYBER_FG_READ)
+			continue;
+
+		orig_depth = depth = kqd->domain_tokens[i].sb.depth;
+		if (fg_status == AWFUL)
+			depth /= 2;
+		else
+			depth -= max(depth / 4, 1U);
+
+		depth = clamp(depth, 1U, kyber_depth[i]);
+		if (depth != orig_depth)
+			sbitmap_queue_resize(&kqd->domain_tokens[i], depth);
+	}
+}
+
 /*
  * Apply heuristics for limiting queue depths based on gathered latency
  * statistics.
@@ -268,15 +408,17 @@ static void kyber_adjust_other_depth(struct kyber_queue_data *kqd,
 static void kyber_stat_timer_fn(struct blk_stat_callback *cb)
 {
 	struct kyber_queue_data *kqd = cb->data;
-	int read_status, write_status;
+	int read_status, write_status, fg_status;
 
 	read_status = kyber_lat_status(cb, KYBER_READ, kqd->read_lat_nsec);
 	write_status = kyber_lat_status(cb, KYBER_SYNC_WRITE, kqd->write_lat_nsec);
+	fg_status = kyber_fg_lat_status(cb);
 
 	kyber_adjust_rw_depth(kqd, KYBER_READ, read_status, write_status);
 	kyber_adjust_rw_depth(kqd, KYBER_SYNC_WRITE, write_status, read_status);
 	kyber_adjust_other_depth(kqd, read_status, write_status,
 				 cb->stat[KYBER_OTHER].nr_samples != 0);
+	kyber_adjust_fg_depth(kqd, fg_status);
 
 	/*
 	 * Continue monitoring latencies if we aren't hitting the targets or
@@ -284,6 +426,7 @@ static void kyber_stat_timer_fn(struct blk_stat_callback *cb)
 	 */
 	if (!blk_stat_is_active(kqd->cb) &&
 	    ((IS_BAD(read_status) || IS_BAD(write_status) ||
+	      IS_BAD(fg_status) ||
 	      kqd->domain_tokens[KYBER_OTHER].sb.depth < kyber_depth[KYBER_OTHER])))
 		blk_stat_activate_msecs(kqd->cb, 100);
 }
@@ -297,9 +440,27 @@ static unsigned int kyber_sched_tags_shift(struct kyber_queue_data *kqd)
 	return kqd->q->queue_hw_ctx[0]->sched_tags->bitmap_tags.sb.shift;
 }
 
+/*
+ * Foreground reads go to the latency buckets following the domain ones, the
+ * bucket of their domain is left empty.
+ */
 static int kyber_bucket_fn(const struct request *rq)
 {
-	return kyber_sched_domain(rq->cmd_flags);
+	unsigned int sched_domain = kyber_rq_sched_domain(rq);
+	struct kyber_queue_data *kqd;
+	u64 now, target, bucket;
+
+	if (sched_domain != KYBER_FG_READ)
+		return sched_domain;
+
+	kqd = rq->q->elevator->elevator_data;
+	target = max_t(u64, READ_ONCE(kqd->fg_read_lat_nsec), 1);
+	now = ktime_get_ns();
+	bucket = now > rq->io_start_time_ns ?
+		 div64_u64((now - rq->io_start_time_ns) * KYBER_FG_LAT_SCALE,
+			   target) : 0;
+
+	return KYBER_NUM_DOMAINS + min_t(u64, bucket, KYBER_FG_LAT_BUCKETS - 1);
 }
 
 static struct kyber_queue_data *kyber_queue_data_alloc(struct request_queue *q)
@@ -316,7 +477,8 @@ static struct kyber_queue_data *kyber_queue_data_alloc(struct request_queue *q)
 	kqd->q = q;
 
 	kqd->cb = blk_stat_alloc_callback(kyber_stat_timer_fn, kyber_bucket_fn,
-					  KYBER_NUM_DOMAINS, kqd);
+					  KYBER_NUM_DOMAINS +
+					  KYBER_FG_LAT_BUCKETS, kqd);
 	if (!kqd->cb)
 		goto err_kqd;
 
@@ -346,6 +508,7 @@ static struct kyber_queue_data *kyber_queue_data_alloc(struct request_queue *q)
 
 	kqd->read_lat_nsec = 2000000ULL;
 	kqd->write_lat_nsec = 10000000ULL;
+	kqd->fg_read_lat_nsec = 2000000ULL;
 
 	return kqd;
 
@@ -487,7 +650,7 @@ static void rq_clear_domain_token(struct kyber_queue_data *kqd,
 
 	nr = rq_get_domain_token(rq);
 	if (nr != -1) {
-		sched_domain = kyber_sched_domain(rq->cmd_flags);
+		sched_domain = kyber_rq_sched_domain(rq);
 		sbitmap_queue_clear(&kqd->domain_tokens[sched_domain], nr,
 				    rq->mq_ctx->cpu);
 	}
@@ -511,7 +674,7 @@ static bool kyber_bio_merge(struct blk_mq_hw_ctx *hctx, struct bio *bio)
 	struct kyber_hctx_data *khd = hctx->sched_data;
 	struct blk_mq_ctx *ctx = blk_mq_get_ctx(hctx->queue);
 	struct kyber_ctx_queue *kcq = &khd->kcqs[ctx->index_hw];
-	unsigned int sched_domain = kyber_sched_domain(bio->bi_opf);
+	unsigned int sched_domain = kyber_bio_sched_domain(bio);
 	struct list_head *rq_list = &kcq->rq_list[sched_domain];
 	bool merged;
 
@@ -525,7 +688,16 @@ static bool kyber_bio_merge(struct blk_mq_hw_ctx *hctx, struct bio *bio)
 
 static void kyber_prepare_request(struct request *rq, struct bio *bio)
 {
+	unsigned int sched_domain;
+
 	rq_set_domain_token(rq, -1);
+
+	if (bio)
+		sched_domain = kyber_bio_sched_domain(bio);
+	else
+		sched_domain = kyber_sched_domain(rq->cmd_flags,
+						  KYBER_PRIO_CLASS_BE);
+	rq->elv.priv[1] = (void *)(long)sched_domain;
 }
 
 static void kyber_insert_requests(struct blk_mq_hw_ctx *hctx,
@@ -535,7 +707,7 @@ static void kyber_insert_requests(struct blk_mq_hw_ctx *hctx,
 	struct request *rq, *next;
 
 	list_for_each_entry_safe(rq, next, rq_list, queuelist) {
-		unsigned int sched_domain = kyber_sched_domain(rq->cmd_flags);
+		unsigned int sched_domain = kyber_rq_sched_domain(rq);
 		struct kyber_ctx_queue *kcq = &khd->kcqs[rq->mq_ctx->index_hw];
 		struct list_head *head = &kcq->rq_list[sched_domain];
 
@@ -569,7 +741,7 @@ static void kyber_completed_request(struct request *rq)
 	 * Check if this request met our latency goal. If not, quickly gather
 	 * some statistics and start throttling.
 	 */
-	sched_domain = kyber_sched_domain(rq->cmd_flags);
+	sched_domain = kyber_rq_sched_domain(rq);
 	switch (sched_domain) {
 	case KYBER_READ:
 		target = kqd->read_lat_nsec;
@@ -577,6 +749,9 @@ static void kyber_completed_request(struct request *rq)
 	case KYBER_SYNC_WRITE:
 		target = kqd->write_lat_nsec;
 		break;
+	case KYBER_FG_READ:
+		target = kqd->fg_read_lat_nsec;
+		break;
 	default:
 		return;
 	}
@@ -755,10 +930,20 @@ static struct request *kyber_dispatch_request(struct blk_mq_hw_ctx *hctx)
 	 * 2. The domain we were batching didn't have any requests.
 	 * 3. The domain we were batching was out of tokens.
 	 *
-	 * Start another batch. Note that this wraps back around to the original
-	 * domain if no other domains have requests or tokens.
+	 * Start another batch, with foreground reads if there are any.
+	 * Otherwise, note that this wraps back around to the original domain
+	 * if no other domains have requests or tokens.
 	 */
 	khd->batching = 0;
+	if (khd->cur_domain != KYBER_FG_READ) {
+		unsigned int cur_domain = khd->cur_domain;
+
+		khd->cur_domain = KYBER_FG_READ;
+		rq = kyber_dispatch_cur_domain(kqd, khd, hctx);
+		if (rq)
+			goto out;
+		khd->cur_domain = cur_domain;
+	}
 	for (i = 0; i < KYBER_NUM_DOMAINS; i++) {
 		if (khd->cur_domain == KYBER_NUM_DOMAINS - 1)
 			khd->cur_domain = 0;
@@ -816,12 +1001,14 @@ static ssize_t kyber_##op##_lat_store(struct elevator_queue *e,		\
 }
 KYBER_LAT_SHOW_STORE(read);
 KYBER_LAT_SHOW_STORE(write);
+KYBER_LAT_SHOW_STORE(fg_read);
 #undef KYBER_LAT_SHOW_STORE
 
 #define KYBER_LAT_ATTR(op) __ATTR(op##_lat_nsec, 0644, kyber_##op##_lat_show, kyber_##op##_lat_store)
 static struct elv_fs_entry kyber_sched_attrs[] = {
 	KYBER_LAT_ATTR(read),
 	KYBER_LAT_ATTR(write),
+	KYBER_LAT_ATTR(fg_read),
 	__ATTR_NULL
 };
 #undef KYBER_LAT_ATTR
@@ -884,6 +1071,7 @@ static int kyber_##name##_waiting_show(void *data, struct seq_file *m)	\
 KYBER_DEBUGFS_DOMAIN_ATTRS(KYBER_READ, read)
 KYBER_DEBUGFS_DOMAIN_ATTRS(KYBER_SYNC_WRITE, sync_write)
 KYBER_DEBUGFS_DOMAIN_ATTRS(KYBER_OTHER, other)
+KYBER_DEBUGFS_DOMAIN_ATTRS(KYBER_FG_READ, fg_read)
 #undef KYBER_DEBUGFS_DOMAIN_ATTRS
 
 static int kyber_async_depth_show(void *data, struct seq_file *m)
@@ -910,6 +1098,9 @@ static int kyber_cur_domain_show(void *data, struct seq_file *m)
 	case KYBER_OTHER:
 		seq_puts(m, "OTHER\n");
 		break;
+	case KYBER_FG_READ:
+		seq_puts(m, "FG_READ\n");
+		break;
 	default:
 		seq_printf(m, "%u\n", khd->cur_domain);
 		break;
@@ -932,6 +1123,7 @@ static const struct blk_mq_debugfs_attr kyber_queue_debugfs_attrs[] = {
 	KYBER_QUEUE_DOMAIN_ATTRS(read),
 	KYBER_QUEUE_DOMAIN_ATTRS(sync_write),
 	KYBER_QUEUE_DOMAIN_ATTRS(other),
+	KYBER_QUEUE_DOMAIN_ATTRS(fg_read),
 	{"async_depth", 0400, kyber_async_depth_show},
 	{},
 };
@@ -944,6 +1136,7 @@ static const struct blk_mq_debugfs_attr kyber_hctx_debugfs_attrs[] = {
 	KYBER_HCTX_DOMAIN_ATTRS(read),
 	KYBER_HCTX_DOMAIN_ATTRS(sync_write),
 	KYBER_HCTX_DOMAIN_ATTRS(other),
+	KYBER_HCTX_DOMAIN_ATTRS(fg_read),
 	{"cur_domain", 0400, kyber_cur_domain_show},
 	{"batching", 0400, kyber_batching_show},
 	{},
@@ -977,14 +1170,103 @@ static struct elevator_type kyber_sched = {
 	.elevator_owner = THIS_MODULE,
 };
 
+#ifdef CONFIG_BLK_CGROUP
+static u64 kyber_prio_class_read(struct cgroup_subsys_state *css,
+				 struct cftype *cft)
+{
+	struct kyber_blkcg_data *kbd = blkcg_to_kbd(css_to_blkcg(css));
+
+	return kbd ? kbd->prio_class : KYBER_PRIO_CLASS_BE;
+}
+
+static int kyber_prio_class_write(struct cgroup_subsys_state *css,
+				  struct cftype *cft, u64 val)
+{
+	struct kyber_blkcg_data *kbd = blkcg_to_kbd(css_to_blkcg(css));
+
+	if (val >= KYBER_NUM_PRIO_CLASSES)
+		return -EINVAL;
+	if (!kbd)
+		return -ENODEV;
+
+	WRITE_ONCE(kbd->prio_class, val);
+	return 0;
+}
+
+static struct cftype kyber_blkcg_files[] = {
+	{
+		.name = "kyber.prio_class",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = kyber_prio_class_read,
+		.write_u64 = kyber_prio_class_write,
+	},
+	{}	/* terminate */
+};
+
+static struct cftype kyber_blkcg_legacy_files[] = {
+	{
+		.name = "kyber.prio_class",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = kyber_prio_class_read,
+		.write_u64 = kyber_prio_class_write,
+	},
+	{}	/* terminate */
+};
+
+static struct blkcg_policy_data *kyber_cpd_alloc(gfp_t gfp)
+{
+	struct kyber_blkcg_data *kbd;
+
+	kbd = kzalloc(sizeof(*kbd), gfp);
+	if (!kbd)
+		return NULL;
+	return &kbd->cpd;
+}
+
+static void kyber_cpd_init(struct blkcg_policy_data *cpd)
+{
+	cpd_to_kbd(cpd)->prio_class = KYBER_PRIO_CLASS_BE;
+}
+
+static void kyber_cpd_free(struct blkcg_policy_data *cpd)
+{
+	kfree(cpd_to_kbd(cpd));
+}
+
+static struct blkcg_policy blkcg_policy_kyber = {
+	.dfl_cftypes		= kyber_blkcg_files,
+	.legacy_cftypes		= kyber_blkcg_legacy_files,
+
+	.cpd_alloc_fn		= kyber_cpd_alloc,
+	.cpd_init_fn		= kyber_cpd_init,
+	.cpd_free_fn		= kyber_cpd_free,
+};
+#endif /* CONFIG_BLK_CGROUP */
+
 static int __init kyber_init(void)
 {
-	return elv_register(&kyber_sched);
+	int ret;
+
+#ifdef CONFIG_BLK_CGROUP
+	ret = blkcg_policy_register(&blkcg_policy_kyber);
+	if (ret)
+		return ret;
+#endif
+
+	ret = elv_register(&kyber_sched);
+#ifdef CONFIG_BLK_CGROUP
+	if (ret)
+		blkcg_policy_unregister(&blkcg_policy_kyber);
+#endif
+	return ret;
 }
 
 static void __exit kyber_exit(void)
 {
 	elv_unregister(&kyber_sched);
+#ifdef CONFIG_BLK_CGROUP
+	blkcg_policy_unregister(&blkcg_policy_kyber);
+#endif
 }
 
 module_init(kyber_init);
@@ -16,6 +16,7 @@
 #include <linux/compiler.h>
 #include <linux/rbtree.h>
 #include <linux/sbitmap.h>
+#include <linux/hrtimer.h>
 
 #include "blk.h"
 #include "blk-mq.h"
@@ -31,6 +32,7 @@ static const int write_expire = 5 * HZ; /* ditto for writes, these limits are SO
 static const int writes_starved = 2;    /* max times reads can starve a write */
 static const int fifo_batch = 16;       /* # of sequential requests treated as one
 				     by the above parameters. For throughput. */
+static const int write_stage_kb = 64;   /* max size of a staged write */
 
 struct deadline_data {
 	/*
@@ -57,6 +59,19 @@ struct deadline_data {
 	int fifo_batch;
 	int writes_starved;
 	int front_merges;
+	int write_stage_usec;
+	int write_stage_kb;
+
+	/*
+	 * write staging window and merge statistics, under lock
+	 */
+	struct request_queue *q;
+	struct hrtimer stage_timer;
+	unsigned long stage_windows;
+	unsigned long stage_bio_merges;
+	unsigned long stage_rq_merges;
+	unsigned long stage_dispatched;
+	unsigned long long stage_sectors;
 
 	spinlock_t lock;
 	spinlock_t zone_lock;
@@ -134,11 +149,19 @@ static void dd_request_merged(struct request_queue *q, struct request *req,
 		elv_rb_del(deadline_rb_root(dd, req), req);
 		deadline_add_rq_rb(dd, req);
 	}
+
+	if (rq_data_dir(req) == WRITE)
+		dd->stage_bio_merges++;
 }
 
 static void dd_merged_requests(struct request_queue *q, struct request *req,
 			       struct request *next)
 {
+	struct deadline_data *dd = q->elevator->elevator_data;
+
+	if (rq_data_dir(req) == WRITE)
+		dd->stage_rq_merges++;
+
 	/*
 	 * if next expires before rq, assign its expire time to rq
 	 * and move into next position (next will be deleted) in fifo
@@ -263,6 +286,48 @@ deadline_next_request(struct deadline_data *dd, int data_dir)
 	return rq;
 }
 
+/*
+ * Small writes are held for up to write_stage_usec after the oldest queued
+ * write was allocated, as a plug would, so that adjacent writes coming from
+ * other submitters get merged into them before they reach the device.
+ * Returns true if rq must be held back, in which case the queue is run
+ * again at the end of the window.
+ */
+static bool deadline_write_staged(struct deadline_data *dd, struct request *rq)
+{
+	struct request *first;
+	u64 now, end;
+
+	if (!dd->write_stage_usec || rq_data_dir(rq) != WRITE ||
+	    !rq_mergeable(rq) || blk_queue_is_zoned(rq->q) ||
+	    blk_rq_bytes(rq) >= (unsigned int)dd->write_stage_kb << 10 ||
+	    deadline_check_fifo(dd, WRITE))
+		return false;
+
+	first = rq_entry_fifo(dd->fifo_list[WRITE].next);
+	end = first->start_time_ns +
+		(u64)dd->write_stage_usec * NSEC_PER_USEC;
+	now = ktime_get_ns();
+	if (now >= end)
+		return false;
+
+	if (!hrtimer_is_queued(&dd->stage_timer)) {
+		dd->stage_windows++;
+		hrtimer_start(&dd->stage_timer, ns_to_ktime(end - now),
+			      HRTIMER_MODE_REL);
+	}
+	return true;
+}
+
+static enum hrtimer_restart deadline_stage_timer_fn(struct hrtimer *timer)
+{
+	struct deadline_data *dd = container_of(timer, struct deadline_data,
+						stage_timer);
+
+	blk_mq_run_hw_queues(dd->q, true);
+	return HRTIMER_NORESTART;
+}
+
 /*
  * deadline_dispatch_requests selects the best request according to
  * read/write expire, fifo_batch, etc
@@ -289,7 +354,8 @@ static struct request *__dd_dispatch_request(struct deadline_data *dd)
 	if (!rq)
 		rq = deadline_next_request(dd, READ);
 
-	if (rq && dd->batching < dd->fifo_batch)
+	if (rq && dd->batching < dd->fifo_batch &&
+	    !deadline_write_staged(dd, rq))
 		/* we have a next request are still entitled to batch */
 		goto dispatch_request;
 
@@ -354,12 +420,26 @@ dispatch_find_request:
 	if (!rq)
 		return NULL;
 
+	/*
+	 * Writes still in their staging window let reads go first, if any.
+	 */
+	if (data_dir == WRITE && deadline_write_staged(dd, rq)) {
+		if (!reads)
+			return NULL;
+		data_dir = READ;
+		goto dispatch_find_request;
+	}
+
 	dd->batching = 0;
 
 dispatch_request:
 	/*
 	 * rq is the selected appropriate request.
 	 */
+	if (rq_data_dir(rq) == WRITE) {
+		dd->stage_dispatched++;
+		dd->stage_sectors += blk_rq_sectors(rq);
+	}
 	dd->batching++;
 	deadline_move_request(dd, rq);
 done:
@@ -396,6 +476,7 @@ static void dd_exit_queue(struct elevator_queue *e)
 	BUG_ON(!list_empty(&dd->fifo_list[READ]));
 	BUG_ON(!list_empty(&dd->fifo_list[WRITE]));
 
+	hrtimer_cancel(&dd->stage_timer);
 	kfree(dd);
 }
 
@@ -427,6 +508,10 @@ static int dd_init_queue(struct request_queue *q, struct elevator_type *e)
 	dd->writes_starved = writes_starved;
 	dd->front_merges = 1;
 	dd->fifo_batch = fifo_batch;
+	dd->write_stage_kb = write_stage_kb;
+	dd->q = q;
+	hrtimer_init(&dd->stage_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	dd->stage_timer.function = deadline_stage_timer_fn;
 	spin_lock_init(&dd->lock);
 	spin_lock_init(&dd->zone_lock);
 	INIT_LIST_HEAD(&dd->dispatch);
@@ -617,6 +702,8 @@ SHOW_FUNCTION(deadline_write_expire_show, dd->fifo_expire[WRITE], 1);
 SHOW_FUNCTION(deadline_writes_starved_show, dd->writes_starved, 0);
 SHOW_FUNCTION(deadline_front_merges_show, dd->front_merges, 0);
 SHOW_FUNCTION(deadline_fifo_batch_show, dd->fifo_batch, 0);
+SHOW_FUNCTION(deadline_write_stage_usec_show, dd->write_stage_usec, 0);
+SHOW_FUNCTION(deadline_write_stage_kb_show, dd->write_stage_kb, 0);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX, __CONV)			\
@@ -640,8 +727,26 @@ STORE_FUNCTION(deadline_write_expire_store, &dd->fifo_expire[WRITE], 0, INT_MAX,
 STORE_FUNCTION(deadline_writes_starved_store, &dd->writes_starved, INT_MIN, INT_MAX, 0);
 STORE_FUNCTION(deadline_front_merges_store, &dd->front_merges, 0, 1, 0);
 STORE_FUNCTION(deadline_fifo_batch_store, &dd->fifo_batch, 0, INT_MAX, 0);
+STORE_FUNCTION(deadline_write_stage_usec_store, &dd->write_stage_usec, 0, USEC_PER_SEC, 0);
+STORE_FUNCTION(deadline_write_stage_kb_store, &dd->write_stage_kb, 1, INT_MAX >> 10, 0);
 #undef STORE_FUNCTION
 
+static ssize_t deadline_write_stage_stats_show(struct elevator_queue *e,
+					       char *page)
+{
+	struct deadline_data *dd = e->elevator_data;
+	ssize_t ret;
+
+	spin_lock(&dd->lock);
+	ret = sprintf(page, "windows %lu\nbio_merges %lu\nrq_merges %lu\n"
+		      "dispatched %lu\nsectors %llu\n", dd->stage_windows,
+		      dd->stage_bio_merges, dd->stage_rq_merges,
+		      dd->stage_dispatched, dd->stage_sectors);
+	spin_unlock(&dd->lock);
+
+	return ret;
+}
+
 #define DD_ATTR(name) \
 	__ATTR(name, 0644, deadline_##name##_show, deadline_##name##_store)
 
@@ -651,6 +756,9 @@ static struct elv_fs_entry deadline_attrs[] = {
 	DD_ATTR(writes_starved),
 	DD_ATTR(front_merges),
 	DD_ATTR(fifo_batch),
+	DD_ATTR(write_stage_usec),
+	DD_ATTR(write_stage_kb),
+	__ATTR(write_stage_stats, 0444, deadline_write_stage_stats_show, NULL),
 	__ATTR_NULL
 };
 
@@ -912,8 +912,18 @@ static void loop_config_discard(struct loop_device *lo)
 
 static void loop_unprepare_queue(struct loop_device *lo)
 {
-	kthread_flush_worker(&lo->worker);
-	kthread_stop(lo->worker_task);
+	unsigned int i;
+
+	for (i = 0; i < lo->tag_set.nr_hw_queues; i++) {
+		struct loop_worker *w = &lo->workers[i];
+
+		if (IS_ERR_OR_NULL(w->task))
+			continue;
+		kthread_flush_worker(&w->worker);
+		kthread_stop(w->task);
+	}
+	kfree(lo->workers);
+	lo->workers = NULL;
 }
 
 static int loop_kthread_worker_fn(void *worker_ptr)
@@ -922,14 +932,36 @@ static int loop_kthread_worker_fn(void *worker_ptr)
 	return kthread_worker_fn(worker_ptr);
 }
 
+/*
+ * Each hw queue gets its own worker, so that requests mapped to different
+ * queues are submitted to the backing file in parallel.
+ */
 static int loop_prepare_queue(struct loop_device *lo)
 {
-	kthread_init_worker(&lo->worker);
-	lo->worker_task = kthread_run(loop_kthread_worker_fn,
-			&lo->worker, "loop%d", lo->lo_number);
-	if (IS_ERR(lo->worker_task))
+	unsigned int nr = lo->tag_set.nr_hw_queues;
+	unsigned int i;
+
+	lo->workers = kcalloc(nr, sizeof(*lo->workers), GFP_KERNEL);
+	if (!lo->workers)
 		return -ENOMEM;
-	set_user_nice(lo->worker_task, MIN_NICE);
+
+	for (i = 0; i < nr; i++) {
+		struct loop_worker *w = &lo->workers[i];
+
+		kthread_init_worker(&w->worker);
+		if (nr == 1)
+			w->task = kthread_run(loop_kthread_worker_fn,
+					&w->worker, "loop%d", lo->lo_number);
+		else
+			w->task = kthread_run(loop_kthread_worker_fn,
+					&w->worker, "loop%d/%u",
+					lo->lo_number, i);
+		if (IS_ERR(w->task)) {
+			loop_unprepare_queue(lo);
+			return -ENOMEM;
+		}
+		set_user_nice(w->task, MIN_NICE);
+	}
 	return 0;
 }
 
@@ -1841,6 +1873,9 @@ static const struct block_device_operations lo_fops = {
 static int max_loop;
 module_param(max_loop, int, 0444);
 MODULE_PARM_DESC(max_loop, "Maximum number of loop devices");
+static unsigned int hw_queues = 1;
+module_param(hw_queues, uint, 0444);
+MODULE_PARM_DESC(hw_queues, "Number of hw queues and workers per loop device");
 module_param(max_part, int, 0444);
 MODULE_PARM_DESC(max_part, "Maximum number of partitions per loop device");
 MODULE_LICENSE("GPL");
@@ -1915,7 +1950,7 @@ static blk_status_t loop_queue_rq(struct blk_mq_hw_ctx *hctx,
 	} else
 #endif
 		cmd->css = NULL;
-	kthread_queue_work(&lo->worker, &cmd->work);
+	kthread_queue_work(&lo->workers[hctx->queue_num].worker, &cmd->work);
 
 	return BLK_STS_OK;
 }
@@ -1991,7 +2026,7 @@ static int loop_add(struct loop_device **l, int i)
 
 	err = -ENOMEM;
 	lo->tag_set.ops = &loop_mq_ops;
-	lo->tag_set.nr_hw_queues = 1;
+	lo->tag_set.nr_hw_queues = hw_queues;
 	lo->tag_set.queue_depth = 128;
 	lo->tag_set.numa_node = NUMA_NO_NODE;
 	lo->tag_set.cmd_size = sizeof(struct loop_cmd);
@@ -2223,6 +2258,8 @@ static int __init loop_init(void)
 		max_part = (1UL << part_shift) - 1;
 	}
 
+	hw_queues = clamp_t(unsigned int, hw_queues, 1, nr_cpu_ids);
+
 	if ((1UL << part_shift) > DISK_MAX_PARTS) {
 		err = -EINVAL;
 		goto err_out;
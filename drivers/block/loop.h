@@ -26,6 +26,11 @@ enum {
 
 struct loop_func_table;
 
+struct loop_worker {
+	struct kthread_worker	worker;
+	struct task_struct	*task;
+};
+
 struct loop_device {
 	int		lo_number;
 	atomic_t	lo_refcnt;
@@ -54,8 +59,7 @@ struct loop_device {
 
 	spinlock_t		lo_lock;
 	int			lo_state;
-	struct kthread_worker	worker;
-	struct task_struct	*worker_task;
+	struct loop_worker	*workers;	/* one per hw queue */
 	bool			use_dio;
 	bool			sysfs_inited;
 
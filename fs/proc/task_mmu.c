@@ -21,6 +21,7 @@
 #include <linux/pkeys.h>
 #include <linux/mm_inline.h>
 #include <linux/ctype.h>
+#include <linux/hash.h>
 
 #include <asm/elf.h>
 #include <asm/tlb.h>
@@ -1668,6 +1669,68 @@ const struct file_operations proc_pagemap_operations = {
 #endif /* CONFIG_PROC_PAGE_MONITOR */
 
 #ifdef CONFIG_PROCESS_RECLAIM
+#define MM_RECLAIM_EVICTED_BITS	12
+
+static inline unsigned long mm_reclaim_key(struct address_space *mapping,
+					   pgoff_t index)
+{
+	return hash_long((unsigned long)mapping ^ index,
+			 MM_RECLAIM_EVICTED_BITS);
+}
+
+/*
+ * Allocate the bitmap of the pages evicted from @mm. Without it, pages
+ * are still reclaimed but their refaults are not tracked.
+ */
+static void mm_reclaim_alloc(struct mm_struct *mm)
+{
+	unsigned long *evicted;
+
+	if (READ_ONCE(mm->reclaim_stat.evicted))
+		return;
+
+	evicted = kzalloc(BITS_TO_LONGS(1 << MM_RECLAIM_EVICTED_BITS) *
+			  sizeof(long), GFP_KERNEL);
+	if (evicted && cmpxchg(&mm->reclaim_stat.evicted, NULL, evicted))
+		kfree(evicted);
+}
+
+void mm_reclaim_free(struct mm_struct *mm)
+{
+	kfree(mm->reclaim_stat.evicted);
+}
+
+/*
+ * Remember @page as evicted from @mm before it is reclaimed, and forget
+ * it again if it could not be. Anon pages are keyed by their index in
+ * the mm, file pages by their mapping and index.
+ */
+void mm_reclaim_mark(struct mm_struct *mm, struct page *page, bool evicted)
+{
+	unsigned long *bitmap = READ_ONCE(mm->reclaim_stat.evicted);
+	struct address_space *mapping;
+	unsigned long key;
+
+	if (!bitmap)
+		return;
+
+	mapping = PageAnon(page) ? NULL : page->mapping;
+	key = mm_reclaim_key(mapping, page->index);
+	if (evicted)
+		set_bit(key, bitmap);
+	else
+		clear_bit(key, bitmap);
+}
+
+void __mm_reclaim_refault(struct mm_struct *mm, struct address_space *mapping,
+			  pgoff_t index)
+{
+	unsigned long *bitmap = READ_ONCE(mm->reclaim_stat.evicted);
+
+	if (test_and_clear_bit(mm_reclaim_key(mapping, index), bitmap))
+		atomic_long_inc(&mm->reclaim_stat.nr_refault);
+}
+
 static BLOCKING_NOTIFIER_HEAD(proc_reclaim_notifier);
 
 int proc_reclaim_notifier_register(struct notifier_block *nb)
@@ -1850,6 +1913,7 @@ struct reclaim_param reclaim_task_anon(struct task_struct *task,
 
 	reclaim_walk.private = &rp;
 
+	mm_reclaim_alloc(mm);
 	down_read(&mm->mmap_sem);
 	for (vma = mm->mmap; vma; vma = vma->vm_next) {
 		if (is_vm_hugetlb_page(vma))
@@ -1868,12 +1932,74 @@ struct reclaim_param reclaim_task_anon(struct task_struct *task,
 
 	flush_tlb_mm(mm);
 	up_read(&mm->mmap_sem);
+	mm_reclaim_account(mm, rp.nr_reclaimed);
 	mmput(mm);
 out:
 	put_task_struct(task);
 	return rp;
 }
 
+/*
+ * Fold the refaults seen since the previous call into the decayed
+ * percentage of reclaimed pages that came back, and return it.
+ * Only called from the process reclaim worker, which serializes
+ * updates of the snapshots.
+ */
+unsigned int reclaim_task_refault_ratio(struct task_struct *task)
+{
+	struct mm_reclaim_stat *stat;
+	struct mm_struct *mm;
+	unsigned long reclaimed, refault;
+	unsigned long ratio;
+
+	mm = get_task_mm(task);
+	if (!mm)
+		return 0;
+
+	stat = &mm->reclaim_stat;
+	reclaimed = atomic_long_read(&stat->nr_reclaimed);
+	refault = atomic_long_read(&stat->nr_refault);
+
+	if (reclaimed != stat->reclaimed_snap) {
+		ratio = ((refault - stat->refault_snap) * 100) /
+				(reclaimed - stat->reclaimed_snap);
+		ratio = min(ratio, 100UL);
+		stat->refault_ratio = (stat->refault_ratio + ratio) / 2;
+	} else {
+		/*
+		 * Nothing was reclaimed since, e.g. because the task was
+		 * skipped for its ratio: let the ratio decay so that the
+		 * task is tried again after a few passes.
+		 */
+		stat->refault_ratio -= stat->refault_ratio / 4;
+	}
+	stat->reclaimed_snap = reclaimed;
+	stat->refault_snap = refault;
+	ratio = stat->refault_ratio;
+
+	mmput(mm);
+	return ratio;
+}
+
+int proc_pid_reclaim_stat(struct seq_file *m, struct pid_namespace *ns,
+			struct pid *pid, struct task_struct *task)
+{
+	struct mm_struct *mm = get_task_mm(task);
+
+	if (!mm)
+		return 0;
+
+	seq_printf(m, "reclaimed %lu\n",
+		   atomic_long_read(&mm->reclaim_stat.nr_reclaimed));
+	seq_printf(m, "refault %lu\n",
+		   atomic_long_read(&mm->reclaim_stat.nr_refault));
+	seq_printf(m, "refault_ratio %u\n",
+		   READ_ONCE(mm->reclaim_stat.refault_ratio));
+	mmput(mm);
+
+	return 0;
+}
+
 static ssize_t reclaim_write(struct file *file, const char __user *buf,
 				size_t count, loff_t *ppos)
 {
@@ -1953,6 +2079,7 @@ static ssize_t reclaim_write(struct file *file, const char __user *buf,
 	rp.nr_reclaimed = 0;
 	reclaim_walk.private = &rp;
 
+	mm_reclaim_alloc(mm);
 	down_read(&mm->mmap_sem);
 	if (type == RECLAIM_RANGE) {
 		vma = find_vma(mm, start);
@@ -1987,6 +2114,7 @@ static ssize_t reclaim_write(struct file *file, const char __user *buf,
 
 	flush_tlb_mm(mm);
 	up_read(&mm->mmap_sem);
+	mm_reclaim_account(mm, rp.nr_reclaimed);
 	mmput(mm);
 out:
 	put_task_struct(task);
@@ -65,6 +65,13 @@ struct blk_mq_hw_ctx {
 	unsigned long		poll_invoked;
 	unsigned long		poll_success;
 
+#define BLK_MQ_MAX_BATCH_ORDER	7
+	unsigned long		comp_batched[BLK_MQ_MAX_BATCH_ORDER];
+	unsigned long		comp_batched_rqs;
+	u64			comp_defer_ns;
+	u64			comp_defer_max_ns;
+	u64			comp_start_ns;
+
 #ifdef CONFIG_BLK_DEBUG_FS
 	struct dentry		*debugfs_dir;
 	struct dentry		*sched_debugfs_dir;
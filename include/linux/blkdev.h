@@ -220,6 +220,7 @@ struct request {
 
 #ifdef CONFIG_BLK_WBT
 	unsigned short wbt_flags;
+	unsigned short wbt_sectors;
 #endif
 #ifdef CONFIG_BLK_DEV_THROTTLING_LOW
 	unsigned short throtl_size;
@@ -710,6 +711,7 @@ struct request_queue {
 #define QUEUE_FLAG_REGISTERED  26	/* queue has been registered to a disk */
 #define QUEUE_FLAG_SCSI_PASSTHROUGH 27	/* queue supports SCSI commands */
 #define QUEUE_FLAG_QUIESCED    28	/* queue has been quiesced */
+#define QUEUE_FLAG_COMP_BATCH  29	/* batch completions in softirq */
 
 #define QUEUE_FLAG_DEFAULT	((1 << QUEUE_FLAG_IO_STAT) |		\
 				 (1 << QUEUE_FLAG_SAME_COMP)	|	\
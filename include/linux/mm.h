@@ -3040,6 +3040,33 @@ extern int reclaim_address_space(struct address_space *mapping,
 		struct reclaim_param *rp);
 extern int proc_reclaim_notifier_register(struct notifier_block *nb);
 extern int proc_reclaim_notifier_unregister(struct notifier_block *nb);
+extern unsigned int reclaim_task_refault_ratio(struct task_struct *task);
+extern void mm_reclaim_mark(struct mm_struct *mm, struct page *page,
+		bool evicted);
+extern void __mm_reclaim_refault(struct mm_struct *mm,
+		struct address_space *mapping, pgoff_t index);
+extern void mm_reclaim_free(struct mm_struct *mm);
+
+static inline void mm_reclaim_account(struct mm_struct *mm, int nr_reclaimed)
+{
+	if (nr_reclaimed > 0)
+		atomic_long_add(nr_reclaimed, &mm->reclaim_stat.nr_reclaimed);
+}
+
+/*
+ * Note the refault of the page at @index of @mapping, NULL for anon
+ * pages, if process reclaim evicted it from @mm.
+ */
+static inline void mm_reclaim_refault(struct mm_struct *mm,
+		struct address_space *mapping, pgoff_t index)
+{
+	if (mm && READ_ONCE(mm->reclaim_stat.evicted))
+		__mm_reclaim_refault(mm, mapping, index);
+}
+#else
+static inline void mm_reclaim_refault(struct mm_struct *mm,
+		struct address_space *mapping, pgoff_t index) {}
+static inline void mm_reclaim_free(struct mm_struct *mm) {}
 #endif
 
 #endif /* __KERNEL__ */
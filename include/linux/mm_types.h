@@ -358,6 +358,24 @@ struct core_state {
 	struct completion startup;
 };
 
+#ifdef CONFIG_PROCESS_RECLAIM
+/*
+ * Pages reclaimed from an mm by process reclaim and the refaults of
+ * those pages seen since. evicted is a hashed bitmap of the pages
+ * process reclaim evicted and that have not refaulted yet, allocated
+ * on the first reclaim. The snapshots and the decayed refault ratio
+ * are only updated from the process reclaim worker.
+ */
+struct mm_reclaim_stat {
+	atomic_long_t nr_reclaimed;
+	atomic_long_t nr_refault;
+	unsigned long *evicted;
+	unsigned long reclaimed_snap;
+	unsigned long refault_snap;
+	unsigned int refault_ratio;
+};
+#endif
+
 struct kioctx_table;
 struct mm_struct {
 	struct {
@@ -509,6 +527,9 @@ struct mm_struct {
 		struct uprobes_state uprobes_state;
 #ifdef CONFIG_HUGETLB_PAGE
 		atomic_long_t hugetlb_usage;
+#endif
+#ifdef CONFIG_PROCESS_RECLAIM
+		struct mm_reclaim_stat reclaim_stat;
 #endif
 		struct work_struct async_put_work;
 
@@ -25,6 +25,7 @@ extern void get_iowait_load(unsigned long *nr_waiters, unsigned long *load);
 #ifdef CONFIG_SCHED_WALT
 extern void sched_update_nr_prod(int cpu, long delta, bool inc);
 extern unsigned int sched_get_cpu_util(int cpu);
+extern unsigned int sched_get_cpu_pred_util(int cpu);
 extern void sched_update_hyst_times(void);
 extern u64 sched_lpm_disallowed_time(int cpu);
 #else
@@ -35,6 +36,10 @@ static inline unsigned int sched_get_cpu_util(int cpu)
 {
 	return 0;
 }
+static inline unsigned int sched_get_cpu_pred_util(int cpu)
+{
+	return 0;
+}
 static inline void sched_update_hyst_times(void)
 {
 }
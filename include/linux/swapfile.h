@@ -14,8 +14,11 @@ extern struct swap_info_struct *swap_info[];
 extern int try_to_unuse(unsigned int, bool, unsigned long);
 extern unsigned long generic_max_swapfile_size(void);
 extern unsigned long max_swapfile_size(void);
-extern int swap_ratio(struct swap_info_struct **si, int node);
+extern int swap_ratio(struct swap_info_struct **si, int node, int n_goal);
 extern void setup_swap_ratio(struct swap_info_struct *p, int prio);
 extern bool is_swap_ratio_group(int prio);
+extern u64 swap_ratio_write_start(struct swap_info_struct *si);
+extern void swap_ratio_write_done(struct swap_info_struct *si, int nr_pages,
+				  u64 start);
 
 #endif /* _LINUX_SWAPFILE_H */
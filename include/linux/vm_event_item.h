@@ -59,6 +59,8 @@ enum vm_event_item { PGPGIN, PGPGOUT, PGPGOUTCLEAN, PSWPIN, PSWPOUT,
 		COMPACTSTALL, COMPACTFAIL, COMPACTSUCCESS,
 		KCOMPACTD_WAKE,
 		KCOMPACTD_MIGRATE_SCANNED, KCOMPACTD_FREE_SCANNED,
+		KCOMPACTD_PROACTIVE_WAKE, KCOMPACTD_PROACTIVE_THROTTLE,
+		COMPACT_COSTLY_FASTPATH,
 #endif
 #ifdef CONFIG_HUGETLB_PAGE
 		HTLB_BUDDY_PGALLOC, HTLB_BUDDY_PGALLOC_FAIL,
@@ -113,6 +115,14 @@ enum vm_event_item { PGPGIN, PGPGOUT, PGPGOUTCLEAN, PSWPIN, PSWPOUT,
 #ifdef CONFIG_SPECULATIVE_PAGE_FAULT
 		SPECULATIVE_PGFAULT_ANON,	/* Speculative page fault field */
 		SPECULATIVE_PGFAULT_FILE,	/* Speculative page fault field */
+		SPECULATIVE_PGFAULT_SWAP,
+		SPECULATIVE_PGFAULT_ANON_ABORT,
+		SPECULATIVE_PGFAULT_FILE_ABORT,
+		SPECULATIVE_PGFAULT_SWAP_ABORT,
+		SPECULATIVE_PGFAULT_VMA_CHANGED,	/* Abort reasons */
+		SPECULATIVE_PGFAULT_VMA_NOTSUP,
+		SPECULATIVE_PGFAULT_PGTABLE,
+		SPECULATIVE_PGFAULT_PTE_LOCK,
 #endif
 		NR_VM_EVENT_ITEMS
 };
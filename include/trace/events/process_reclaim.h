@@ -71,6 +71,28 @@ TRACE_EVENT(process_reclaim_eff,
 		__entry->reclaim_avg_efficiency)
 );
 
+TRACE_EVENT(process_reclaim_refault,
+
+	TP_PROTO(pid_t pid, int refault_ratio, int refault_skip_ratio),
+
+	TP_ARGS(pid, refault_ratio, refault_skip_ratio),
+
+	TP_STRUCT__entry(
+		__field(pid_t, pid)
+		__field(int, refault_ratio)
+		__field(int, refault_skip_ratio)
+	),
+
+	TP_fast_assign(
+		__entry->pid			= pid;
+		__entry->refault_ratio		= refault_ratio;
+		__entry->refault_skip_ratio	= refault_skip_ratio;
+	),
+
+	TP_printk("pid=%d refault_ratio=%d skip_ratio=%d", __entry->pid,
+		__entry->refault_ratio, __entry->refault_skip_ratio)
+);
+
 #endif
 
 #include <trace/define_trace.h>
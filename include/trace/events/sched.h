@@ -1380,6 +1380,27 @@ TRACE_EVENT(core_ctl_eval_need,
 			__entry->old_need, __entry->new_need, __entry->updated)
 );
 
+TRACE_EVENT(core_ctl_pred_need,
+
+	TP_PROTO(unsigned int cpu, unsigned int pred_busy,
+		unsigned int need, unsigned int pred_need),
+	TP_ARGS(cpu, pred_busy, need, pred_need),
+	TP_STRUCT__entry(
+		__field(u32, cpu)
+		__field(u32, pred_busy)
+		__field(u32, need)
+		__field(u32, pred_need)
+	),
+	TP_fast_assign(
+		__entry->cpu = cpu;
+		__entry->pred_busy = pred_busy;
+		__entry->need = need;
+		__entry->pred_need = pred_need;
+	),
+	TP_printk("cpu=%u, pred_busy=%u, need=%u, pred_need=%u", __entry->cpu,
+			__entry->pred_busy, __entry->need, __entry->pred_need)
+);
+
 TRACE_EVENT(core_ctl_set_busy,
 
 	TP_PROTO(unsigned int cpu, unsigned int busy,
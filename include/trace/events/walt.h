@@ -538,4 +538,29 @@ TRACE_EVENT(sched_load_to_gov,
 		__entry->nt_ps, __entry->grp_nt_ps, __entry->pl, __entry->load,
 		__entry->big_task_rotation, __entry->user_hint)
 );
+
+TRACE_EVENT(sched_walt_rollover,
+
+	TP_PROTO(u64 window_start, u64 irqoff_ns, u64 lock_ns, bool resized),
+
+	TP_ARGS(window_start, irqoff_ns, lock_ns, resized),
+
+	TP_STRUCT__entry(
+		__field(u64,	window_start)
+		__field(u64,	irqoff_ns)
+		__field(u64,	lock_ns)
+		__field(bool,	resized)
+	),
+
+	TP_fast_assign(
+		__entry->window_start	= window_start;
+		__entry->irqoff_ns	= irqoff_ns;
+		__entry->lock_ns	= lock_ns;
+		__entry->resized	= resized;
+	),
+
+	TP_printk("window_start=%llu irqoff_ns=%llu max_rq_lock_ns=%llu resized=%d",
+		__entry->window_start, __entry->irqoff_ns, __entry->lock_ns,
+		__entry->resized)
+);
 #endif
@@ -85,14 +85,20 @@ TRACE_EVENT(wbt_lat,
  * @bg: the current background queue limit
  * @normal: the current normal writeback limit
  * @max: the current max throughput writeback limit
+ * @wlat: the write latency of the last window, in gc mode
+ * @wlat_avg: the moving average of the write latency, in gc mode
+ * @inflight: the size of the tracked writes in flight, in sectors
+ * @drain: the size of the writes in flight we back off above, in sectors
  */
 TRACE_EVENT(wbt_step,
 
 	TP_PROTO(struct backing_dev_info *bdi, const char *msg,
 		 int step, unsigned long window, unsigned int bg,
-		 unsigned int normal, unsigned int max),
+		 unsigned int normal, unsigned int max, u64 wlat,
+		 u64 wlat_avg, unsigned int inflight, unsigned int drain),
 
-	TP_ARGS(bdi, msg, step, window, bg, normal, max),
+	TP_ARGS(bdi, msg, step, window, bg, normal, max, wlat, wlat_avg,
+		inflight, drain),
 
 	TP_STRUCT__entry(
 		__array(char, name, 32)
@@ -102,6 +108,10 @@ TRACE_EVENT(wbt_step,
 		__field(unsigned int, bg)
 		__field(unsigned int, normal)
 		__field(unsigned int, max)
+		__field(u64, wlat)
+		__field(u64, wlat_avg)
+		__field(unsigned int, inflight)
+		__field(unsigned int, drain)
 	),
 
 	TP_fast_assign(
@@ -113,11 +123,20 @@ TRACE_EVENT(wbt_step,
 		__entry->bg	= bg;
 		__entry->normal	= normal;
 		__entry->max	= max;
+		__entry->wlat	= div_u64(wlat, 1000);
+		__entry->wlat_avg = div_u64(wlat_avg, 1000);
+		__entry->inflight = inflight >> 1;
+		__entry->drain	= drain >> 1;
 	),
 
-	TP_printk("%s: %s: step=%d, window=%luus, background=%u, normal=%u, max=%u\n",
+	TP_printk("%s: %s: step=%d, window=%luus, background=%u, normal=%u, "
+		  "max=%u, wlat=%lluus, wlat_avg=%lluus, inflight=%uKB, "
+		  "drain=%uKB\n",
 		  __entry->name, __entry->msg, __entry->step, __entry->window,
-		  __entry->bg, __entry->normal, __entry->max)
+		  __entry->bg, __entry->normal, __entry->max,
+		  (unsigned long long)__entry->wlat,
+		  (unsigned long long)__entry->wlat_avg,
+		  __entry->inflight, __entry->drain)
 );
 
 /**
@@ -0,0 +1,50 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+#ifndef _UAPI_LINUX_SCHED_PLACEMENT_H
+#define _UAPI_LINUX_SCHED_PLACEMENT_H
+
+#include <linux/types.h>
+
+/*
+ * Records of the energy aware wakeup placement decisions, read from
+ * <tracefs>/sched_placement/cpuN. Each record describes one call of
+ * find_energy_efficient_cpu() that went past the early exits.
+ */
+
+#define SCHED_PLACEMENT_VERSION		1
+
+/* CPUs whose state and energy estimate are recorded */
+#define SCHED_PLACEMENT_MAX_CPUS	8
+
+/* sched_placement_rec::flags */
+#define SCHED_PLACEMENT_F_SYNC		0x0001	/* sync wakeup */
+#define SCHED_PLACEMENT_F_NEED_IDLE	0x0002
+#define SCHED_PLACEMENT_F_RTG		0x0004	/* in a related thread group */
+#define SCHED_PLACEMENT_F_BOOSTED	0x0008
+#define SCHED_PLACEMENT_F_ENERGY	0x0010	/* energy fields are valid */
+
+struct sched_placement_cpu {
+	__u16	util;		/* cpu_util() at wakeup */
+	__u16	capacity;	/* capacity_orig_of() */
+	__s8	idle_idx;	/* idle state index, -1 if busy */
+	__u8	nr_running;
+};
+
+struct sched_placement_rec {
+	__u64	ts;		/* sched_clock() in ns */
+	__s32	pid;
+	__u16	task_util;	/* task_util_est() */
+	__s16	boost;		/* schedtune boost of the task */
+	__s8	prev_cpu;
+	__s8	start_cpu;
+	__s8	target_cpu;	/* CPU picked */
+	__u8	fastpath;	/* find_best_target() fast path taken */
+	__u16	flags;		/* SCHED_PLACEMENT_F_* */
+	__u16	nr_cpus;	/* valid entries of energy[] and cpu[] */
+	__u64	candidates;	/* mask of the candidate CPUs */
+	__u64	prev_energy;	/* estimate with the task on prev_cpu */
+	__u64	best_energy;	/* estimate with the task on target_cpu */
+	__u32	energy[SCHED_PLACEMENT_MAX_CPUS]; /* 0 if not estimated */
+	struct sched_placement_cpu cpu[SCHED_PLACEMENT_MAX_CPUS];
+};
+
+#endif /* _UAPI_LINUX_SCHED_PLACEMENT_H */
@@ -2090,6 +2090,7 @@ static int select_fallback_rq(int cpu, struct task_struct *p, bool allow_iso)
 	enum { cpuset, possible, fail, bug } state = cpuset;
 	int dest_cpu;
 	int isolated_candidate = -1;
+	int parked_candidate = -1;
 	int backup_cpu = -1;
 	unsigned int max_nr = UINT_MAX;
 
@@ -2105,7 +2106,7 @@ static int select_fallback_rq(int cpu, struct task_struct *p, bool allow_iso)
 		for_each_cpu(dest_cpu, nodemask) {
 			if (!cpu_active(dest_cpu))
 				continue;
-			if (cpu_isolated(dest_cpu))
+			if (cpu_isolated(dest_cpu) || cpu_parked(dest_cpu))
 				continue;
 			if (cpumask_test_cpu(dest_cpu, &p->cpus_allowed)) {
 				if (cpu_rq(dest_cpu)->nr_running < 32)
@@ -2131,6 +2132,16 @@ static int select_fallback_rq(int cpu, struct task_struct *p, bool allow_iso)
 					isolated_candidate = dest_cpu;
 				continue;
 			}
+			if (cpu_parked(dest_cpu)) {
+				parked_candidate = dest_cpu;
+				continue;
+			}
+			goto out;
+		}
+
+		/* Parked CPUs still run tasks, prefer them to isolated ones */
+		if (parked_candidate != -1) {
+			dest_cpu = parked_candidate;
 			goto out;
 		}
 
@@ -2208,7 +2219,8 @@ int select_task_rq(struct task_struct *p, int cpu, int sd_flags, int wake_flags,
 	 *   not worry about this generic constraint ]
 	 */
 	if (unlikely(!is_cpu_allowed(p, cpu)) ||
-			(cpu_isolated(cpu) && !allow_isolated))
+			((cpu_isolated(cpu) || cpu_parked(cpu)) &&
+			 !allow_isolated))
 		cpu = select_fallback_rq(task_cpu(p), p, allow_isolated);
 
 #ifdef CONFIG_NO_HZ_COMMON
@@ -3829,6 +3841,8 @@ void scheduler_tick(void)
 
 	rcu_read_lock();
 	grp = task_related_thread_group(curr);
+	if (grp)
+		rtg_pack_tick(grp, cpu);
 	if (update_preferred_cluster(grp, curr, old_load, true))
 		set_preferred_cluster(grp);
 	rcu_read_unlock();
@@ -4277,6 +4291,7 @@ static void __sched notrace __schedule(bool preempt)
 
 		update_task_ravg(prev, rq, PUT_PREV_TASK, wallclock, 0);
 		update_task_ravg(next, rq, PICK_NEXT_TASK, wallclock, 0);
+		rtg_pack_switch(next, cpu);
 		rq->nr_switches++;
 		rq->curr = next;
 		/*
@@ -6889,6 +6904,61 @@ int sched_unisolate_cpu(int cpu)
 	return ret_code;
 }
 
+struct cpumask __cpu_parked_mask __read_mostly;
+
+/*
+ * Soft isolation: wakeup placement, RT push and load balancing stop
+ * using @cpu, but the tasks and timers already on it are left to drain
+ * on their own. Unlike sched_isolate_cpu() this does not stop the CPU
+ * or migrate anything, so it only costs the update of the mask.
+ */
+int sched_park_cpu(int cpu)
+{
+	cpumask_t avail_cpus;
+	int ret_code = 0;
+
+	if (cpu < 0 || cpu >= nr_cpu_ids || !cpu_possible(cpu))
+		return -EINVAL;
+
+	cpu_maps_update_begin();
+
+	if (!cpu_online(cpu) || cpu_isolated(cpu)) {
+		ret_code = -EINVAL;
+		goto out;
+	}
+
+	if (cpu_parked(cpu))
+		goto out;
+
+	/* We cannot park ALL cpus in the system */
+	cpumask_andnot(&avail_cpus, cpu_online_mask, cpu_isolated_mask);
+	cpumask_andnot(&avail_cpus, &avail_cpus, cpu_parked_mask);
+	if (cpumask_weight(&avail_cpus) == 1) {
+		ret_code = -EINVAL;
+		goto out;
+	}
+
+	cpumask_set_cpu(cpu, &__cpu_parked_mask);
+out:
+	cpu_maps_update_done();
+	return ret_code;
+}
+
+/*
+ * Callable from the CPU hotplug callbacks, the mask update does not need
+ * the cpu maps lock.
+ */
+void sched_unpark_cpu(int cpu)
+{
+	if (!cpumask_test_and_clear_cpu(cpu, &__cpu_parked_mask))
+		return;
+
+	/* Kick CPU to immediately do load balancing */
+	if (cpu_online(cpu) &&
+	    !atomic_fetch_or(NOHZ_KICK_MASK, nohz_flags(cpu)))
+		smp_send_reschedule(cpu);
+}
+
 #endif /* CONFIG_HOTPLUG_CPU */
 
 void set_rq_online(struct rq *rq)
@@ -48,16 +48,34 @@ struct cluster_data {
 	unsigned int boost;
 	struct kobject kobj;
 	unsigned int strict_nrrun;
+	bool soft_park;
+	bool predict;
+	unsigned int pred_need;
+	u64 pred_window;
+	unsigned long pred_hits;
+	unsigned long pred_misses;
+	unsigned long pred_unisolated;
+	u64 need_raise_ns;
+	bool need_raise_pred;
+	unsigned long online_lat_count;
+	u64 online_lat_avg_ns;
+	u64 online_lat_max_ns;
 };
 
 struct cpu_data {
 	bool is_busy;
 	unsigned int busy;
+	unsigned int pred_busy;
 	unsigned int cpu;
 	bool not_preferred;
 	struct cluster_data *cluster;
 	struct list_head sib;
 	bool isolated_by_us;
+	bool parked;
+	u64 isolate_lat_ns;
+	u64 isolate_lat_max_ns;
+	u64 unisolate_lat_ns;
+	u64 unisolate_lat_max_ns;
 };
 
 static DEFINE_PER_CPU(struct cpu_data, cpu_state);
@@ -77,6 +95,7 @@ ATOMIC_NOTIFIER_HEAD(core_ctl_notifier);
 static unsigned int last_nr_big;
 
 static unsigned int get_active_cpu_count(const struct cluster_data *cluster);
+static u64 core_ctl_check_timestamp;
 
 /* ========================= sysfs interface =========================== */
 
@@ -274,6 +293,67 @@ static ssize_t show_enable(const struct cluster_data *state, char *buf)
 	return scnprintf(buf, PAGE_SIZE, "%u\n", state->enable);
 }
 
+static ssize_t store_soft_park(struct cluster_data *state,
+			       const char *buf, size_t count)
+{
+	unsigned int val;
+
+	if (sscanf(buf, "%u\n", &val) != 1)
+		return -EINVAL;
+
+	/* CPUs already isolated keep the mode they were isolated with */
+	state->soft_park = !!val;
+
+	return count;
+}
+
+static ssize_t show_soft_park(const struct cluster_data *state, char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%u\n", state->soft_park);
+}
+
+static ssize_t store_predict(struct cluster_data *state,
+			     const char *buf, size_t count)
+{
+	unsigned int val;
+	bool bval;
+
+	if (sscanf(buf, "%u\n", &val) != 1)
+		return -EINVAL;
+
+	bval = !!val;
+	if (bval != state->predict) {
+		state->predict = bval;
+		apply_need(state);
+	}
+
+	return count;
+}
+
+static ssize_t show_predict(const struct cluster_data *state, char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%u\n", state->predict);
+}
+
+static ssize_t show_pred_stats(const struct cluster_data *state, char *buf)
+{
+	unsigned long flags;
+	ssize_t count;
+
+	spin_lock_irqsave(&state_lock, flags);
+	count = scnprintf(buf, PAGE_SIZE,
+			  "hits: %lu\nmisses: %lu\nunisolated: %lu\n"
+			  "online_lat_count: %lu\nonline_lat_avg_us: %llu\n"
+			  "online_lat_max_us: %llu\n",
+			  state->pred_hits, state->pred_misses,
+			  state->pred_unisolated, state->online_lat_count,
+			  div_u64(state->online_lat_avg_ns, NSEC_PER_USEC),
+			  div_u64(state->online_lat_max_ns, NSEC_PER_USEC));
+	spin_unlock_irqrestore(&state_lock, flags);
+
+	return count;
+}
+
 static ssize_t show_need_cpus(const struct cluster_data *state, char *buf)
 {
 	return snprintf(buf, PAGE_SIZE, "%u\n", state->need_cpus);
@@ -308,6 +388,17 @@ static ssize_t show_global_state(const struct cluster_data *state, char *buf)
 		count += snprintf(buf + count, PAGE_SIZE - count,
 					"\tIsolated: %u\n",
 					cpu_isolated(c->cpu));
+		count += snprintf(buf + count, PAGE_SIZE - count,
+					"\tParked: %u\n",
+					cpu_parked(c->cpu));
+		count += snprintf(buf + count, PAGE_SIZE - count,
+					"\tIsolate lat us: %llu max: %llu\n",
+				div_u64(c->isolate_lat_ns, NSEC_PER_USEC),
+				div_u64(c->isolate_lat_max_ns, NSEC_PER_USEC));
+		count += snprintf(buf + count, PAGE_SIZE - count,
+					"\tUnisolate lat us: %llu max: %llu\n",
+				div_u64(c->unisolate_lat_ns, NSEC_PER_USEC),
+				div_u64(c->unisolate_lat_max_ns, NSEC_PER_USEC));
 		count += snprintf(buf + count, PAGE_SIZE - count,
 					"\tFirst CPU: %u\n",
 						cluster->first_cpu);
@@ -315,6 +406,8 @@ static ssize_t show_global_state(const struct cluster_data *state, char *buf)
 					"\tBusy%%: %u\n", c->busy);
 		count += snprintf(buf + count, PAGE_SIZE - count,
 					"\tIs busy: %u\n", c->is_busy);
+		count += snprintf(buf + count, PAGE_SIZE - count,
+					"\tPred busy%%: %u\n", c->pred_busy);
 		count += snprintf(buf + count, PAGE_SIZE - count,
 					"\tNot preferred: %u\n",
 						c->not_preferred);
@@ -324,11 +417,15 @@ static ssize_t show_global_state(const struct cluster_data *state, char *buf)
 			"\tActive CPUs: %u\n", get_active_cpu_count(cluster));
 		count += snprintf(buf + count, PAGE_SIZE - count,
 				"\tNeed CPUs: %u\n", cluster->need_cpus);
+		count += snprintf(buf + count, PAGE_SIZE - count,
+				"\tPred need CPUs: %u\n", cluster->pred_need);
 		count += snprintf(buf + count, PAGE_SIZE - count,
 				"\tNr isolated CPUs: %u\n",
 						cluster->nr_isolated_cpus);
 		count += snprintf(buf + count, PAGE_SIZE - count,
 				"\tBoost: %u\n", (unsigned int) cluster->boost);
+		count += snprintf(buf + count, PAGE_SIZE - count,
+				"\tSoft park: %u\n", cluster->soft_park);
 	}
 	spin_unlock_irq(&state_lock);
 
@@ -408,6 +505,9 @@ core_ctl_attr_ro(active_cpus);
 core_ctl_attr_ro(global_state);
 core_ctl_attr_rw(not_preferred);
 core_ctl_attr_rw(enable);
+core_ctl_attr_rw(soft_park);
+core_ctl_attr_rw(predict);
+core_ctl_attr_ro(pred_stats);
 
 static struct attribute *default_attrs[] = {
 	&min_cpus.attr,
@@ -422,6 +522,9 @@ static struct attribute *default_attrs[] = {
 	&active_cpus.attr,
 	&global_state.attr,
 	&not_preferred.attr,
+	&soft_park.attr,
+	&predict.attr,
+	&pred_stats.attr,
 	NULL
 };
 
@@ -739,6 +842,47 @@ static unsigned int apply_task_need(const struct cluster_data *cluster,
 	return new_need;
 }
 
+/*
+ * Raise the need to the number of CPUs the WALT predicted demand of the
+ * cluster will keep above the busy up threshold, so CPUs get unisolated
+ * a window ahead of the load showing up in the busy time. The prediction
+ * made for a window is checked against the busy based need once that
+ * window is over.
+ */
+static unsigned int apply_pred_need(struct cluster_data *cluster,
+				    unsigned int need, unsigned int thres_idx)
+{
+	unsigned int pred_busy = 0, thres;
+	struct cpu_data *c;
+
+	if (cluster->pred_window == core_ctl_check_timestamp)
+		return max(need, cluster->pred_need);
+
+	cluster->pred_window = core_ctl_check_timestamp;
+	if (cluster->pred_need) {
+		if (need >= cluster->pred_need)
+			cluster->pred_hits++;
+		else
+			cluster->pred_misses++;
+		cluster->pred_need = 0;
+	}
+
+	if (!cluster->predict)
+		return need;
+
+	list_for_each_entry(c, &cluster->lru, sib)
+		pred_busy += c->pred_busy;
+
+	thres = max(cluster->busy_up_thres[thres_idx], 1U);
+	if (DIV_ROUND_UP(pred_busy, thres) > need)
+		cluster->pred_need = DIV_ROUND_UP(pred_busy, thres);
+
+	trace_core_ctl_pred_need(cluster->first_cpu, pred_busy, need,
+				 cluster->pred_need);
+
+	return max(need, cluster->pred_need);
+}
+
 /* ======================= load based core count  ====================== */
 
 static unsigned int apply_limits(const struct cluster_data *cluster,
@@ -749,13 +893,19 @@ static unsigned int apply_limits(const struct cluster_data *cluster,
 
 static unsigned int get_active_cpu_count(const struct cluster_data *cluster)
 {
-	return cluster->num_cpus -
+	cpumask_t parked;
+
+	cpumask_and(&parked, &cluster->cpu_mask, cpu_parked_mask);
+	cpumask_and(&parked, &parked, cpu_online_mask);
+
+	return cluster->num_cpus - cpumask_weight(&parked) -
 				sched_isolate_count(&cluster->cpu_mask, true);
 }
 
 static bool is_active(const struct cpu_data *state)
 {
-	return cpu_online(state->cpu) && !cpu_isolated(state->cpu);
+	return cpu_online(state->cpu) && !cpu_isolated(state->cpu) &&
+	       !cpu_parked(state->cpu);
 }
 
 static bool adjustment_possible(const struct cluster_data *cluster,
@@ -777,6 +927,7 @@ static bool eval_need(struct cluster_data *cluster)
 	unsigned long flags;
 	struct cpu_data *c;
 	unsigned int need_cpus = 0, last_need, thres_idx;
+	unsigned int busy_need = UINT_MAX;
 	int ret = 0;
 	bool need_flag = false;
 	unsigned int new_need;
@@ -806,6 +957,8 @@ static bool eval_need(struct cluster_data *cluster)
 			need_cpus += c->is_busy;
 		}
 		need_cpus = apply_task_need(cluster, need_cpus);
+		busy_need = apply_limits(cluster, need_cpus);
+		need_cpus = apply_pred_need(cluster, need_cpus, thres_idx);
 	}
 	new_need = apply_limits(cluster, need_cpus);
 	need_flag = adjustment_possible(cluster, new_need);
@@ -815,7 +968,13 @@ static bool eval_need(struct cluster_data *cluster)
 
 	if (new_need > cluster->active_cpus) {
 		ret = 1;
+		if (!cluster->need_raise_ns) {
+			cluster->need_raise_ns = ktime_get_ns();
+			cluster->need_raise_pred =
+				busy_need <= cluster->active_cpus;
+		}
 	} else {
+		cluster->need_raise_ns = 0;
 		/*
 		 * When there is no change in need and there are no more
 		 * active CPUs than currently needed, just update the
@@ -861,8 +1020,6 @@ static void wake_up_core_ctl_thread(struct cluster_data *cluster)
 	wake_up_process(cluster->core_ctl_thread);
 }
 
-static u64 core_ctl_check_timestamp;
-
 int core_ctl_set_boost(bool boost)
 {
 	unsigned int index = 0;
@@ -964,6 +1121,7 @@ void core_ctl_check(u64 window_start)
 			continue;
 
 		c->busy = sched_get_cpu_util(cpu);
+		c->pred_busy = sched_get_cpu_pred_util(cpu);
 	}
 	spin_unlock_irqrestore(&state_lock, flags);
 
@@ -992,6 +1150,51 @@ static bool should_we_isolate(int cpu, struct cluster_data *cluster)
 	return true;
 }
 
+/*
+ * In soft park mode a CPU only stops taking new tasks and its current
+ * ones drain on their own, instead of being migrated away by the stop
+ * machine work of sched_isolate_cpu().
+ */
+static int core_ctl_isolate_cpu(struct cluster_data *cluster,
+				struct cpu_data *c)
+{
+	bool park = cluster->soft_park;
+	u64 start = ktime_get_ns();
+	int ret;
+
+	ret = park ? sched_park_cpu(c->cpu) : sched_isolate_cpu(c->cpu);
+	if (ret)
+		return ret;
+
+	c->isolated_by_us = true;
+	c->parked = park;
+	c->isolate_lat_ns = ktime_get_ns() - start;
+	c->isolate_lat_max_ns = max(c->isolate_lat_max_ns, c->isolate_lat_ns);
+
+	return 0;
+}
+
+static int core_ctl_unisolate_cpu(struct cpu_data *c)
+{
+	u64 start = ktime_get_ns();
+	int ret = 0;
+
+	if (c->parked)
+		sched_unpark_cpu(c->cpu);
+	else
+		ret = sched_unisolate_cpu(c->cpu);
+	if (ret)
+		return ret;
+
+	c->isolated_by_us = false;
+	c->parked = false;
+	c->unisolate_lat_ns = ktime_get_ns() - start;
+	c->unisolate_lat_max_ns = max(c->unisolate_lat_max_ns,
+				      c->unisolate_lat_ns);
+
+	return 0;
+}
+
 static void try_to_isolate(struct cluster_data *cluster, unsigned int need)
 {
 	struct cpu_data *c, *tmp;
@@ -1031,8 +1234,7 @@ static void try_to_isolate(struct cluster_data *cluster, unsigned int need)
 		spin_unlock_irqrestore(&state_lock, flags);
 
 		pr_debug("Trying to isolate CPU%u\n", c->cpu);
-		if (!sched_isolate_cpu(c->cpu)) {
-			c->isolated_by_us = true;
+		if (!core_ctl_isolate_cpu(cluster, c)) {
 			move_cpu_lru(c);
 			nr_isolated++;
 		} else {
@@ -1070,8 +1272,7 @@ again:
 		spin_unlock_irqrestore(&state_lock, flags);
 
 		pr_debug("Trying to isolate CPU%u\n", c->cpu);
-		if (!sched_isolate_cpu(c->cpu)) {
-			c->isolated_by_us = true;
+		if (!core_ctl_isolate_cpu(cluster, c)) {
 			move_cpu_lru(c);
 			nr_isolated++;
 		} else {
@@ -1108,8 +1309,7 @@ static void __try_to_unisolate(struct cluster_data *cluster,
 
 		if (!c->isolated_by_us)
 			continue;
-		if ((cpu_online(c->cpu) && !cpu_isolated(c->cpu)) ||
-			(!force && c->not_preferred))
+		if (is_active(c) || (!force && c->not_preferred))
 			continue;
 		if (cluster->active_cpus == need)
 			break;
@@ -1117,8 +1317,7 @@ static void __try_to_unisolate(struct cluster_data *cluster,
 		spin_unlock_irqrestore(&state_lock, flags);
 
 		pr_debug("Trying to unisolate CPU%u\n", c->cpu);
-		if (!sched_unisolate_cpu(c->cpu)) {
-			c->isolated_by_us = false;
+		if (!core_ctl_unisolate_cpu(c)) {
 			move_cpu_lru(c);
 			nr_unisolated++;
 		} else {
@@ -1128,6 +1327,22 @@ static void __try_to_unisolate(struct cluster_data *cluster,
 		spin_lock_irqsave(&state_lock, flags);
 	}
 	cluster->nr_isolated_cpus -= nr_unisolated;
+	if (nr_unisolated && cluster->need_raise_ns) {
+		u64 lat = ktime_get_ns() - cluster->need_raise_ns;
+
+		if (cluster->need_raise_pred)
+			cluster->pred_unisolated += nr_unisolated;
+		cluster->online_lat_count++;
+		cluster->online_lat_max_ns = max(cluster->online_lat_max_ns,
+						 lat);
+		/* Average with a 1/8 weight for the new sample */
+		if (cluster->online_lat_avg_ns)
+			cluster->online_lat_avg_ns += div64_s64((s64)lat -
+					(s64)cluster->online_lat_avg_ns, 8);
+		else
+			cluster->online_lat_avg_ns = lat;
+		cluster->need_raise_ns = 0;
+	}
 	spin_unlock_irqrestore(&state_lock, flags);
 }
 
@@ -1213,8 +1428,12 @@ static int isolation_cpuhp_state(unsigned int cpu,  bool online)
 		 * So unisolate a CPU that went down if it was isolated by us.
 		 */
 		if (state->isolated_by_us) {
-			sched_unisolate_cpu_unlocked(cpu);
+			if (state->parked)
+				sched_unpark_cpu(cpu);
+			else
+				sched_unisolate_cpu_unlocked(cpu);
 			state->isolated_by_us = false;
+			state->parked = false;
 			unisolated = true;
 		}
 
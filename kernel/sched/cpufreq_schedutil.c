@@ -25,6 +25,7 @@ struct sugov_tunables {
 	unsigned int		hispeed_freq;
 	unsigned int		rtg_boost_freq;
 	bool			pl;
+	bool			adaptive_rate_limit;
 };
 
 struct sugov_policy {
@@ -55,9 +56,17 @@ struct sugov_policy {
 	struct			kthread_worker worker;
 	struct task_struct	*thread;
 	bool			work_in_progress;
+	bool			work_pending;
 
 	bool			limits_changed;
 	bool			need_freq_update;
+
+	/* Frequency request statistics, reported by stats_show() */
+	u64			stats_start_ns;
+	unsigned long		nr_requests;
+	unsigned long		nr_coalesced;
+	unsigned long		nr_switches;
+	u64			switch_lat_ns;
 };
 
 struct sugov_cpu {
@@ -88,8 +97,32 @@ static DEFINE_PER_CPU(struct sugov_cpu, sugov_cpu);
 static unsigned int stale_ns;
 static DEFINE_PER_CPU(struct sugov_tunables *, cached_tunables);
 
+/*
+ * With adaptive_rate_limit set, frequency requests are not issued more
+ * often than this many times the average driver switch latency.
+ */
+#define SUGOV_SWITCH_LAT_MULT	2
+
 /************************ Governor internals ***********************/
 
+static inline s64 sugov_rate_limit_floor(struct sugov_policy *sg_policy)
+{
+	if (!sg_policy->tunables->adaptive_rate_limit)
+		return 0;
+
+	return READ_ONCE(sg_policy->switch_lat_ns) * SUGOV_SWITCH_LAT_MULT;
+}
+
+/* Average the driver switch latency with a 1/8 weight for the new sample */
+static void sugov_account_switch(struct sugov_policy *sg_policy, u64 lat)
+{
+	u64 avg = sg_policy->switch_lat_ns;
+
+	avg = avg ? avg - (avg >> 3) + (lat >> 3) : lat;
+	WRITE_ONCE(sg_policy->switch_lat_ns, avg);
+	sg_policy->nr_switches++;
+}
+
 static bool sugov_should_update_freq(struct sugov_policy *sg_policy, u64 time)
 {
 	s64 delta_ns;
@@ -125,7 +158,8 @@ static bool sugov_should_update_freq(struct sugov_policy *sg_policy, u64 time)
 	 */
 
 	delta_ns = time - sg_policy->last_freq_update_time;
-	return delta_ns >= sg_policy->min_rate_limit_ns;
+	return delta_ns >= max(sg_policy->min_rate_limit_ns,
+			       sugov_rate_limit_floor(sg_policy));
 }
 
 static inline bool use_pelt(void)
@@ -149,16 +183,17 @@ static inline bool conservative_pl(void)
 static bool sugov_up_down_rate_limit(struct sugov_policy *sg_policy, u64 time,
 				     unsigned int next_freq)
 {
-	s64 delta_ns;
+	s64 delta_ns, floor_ns;
 
 	delta_ns = time - sg_policy->last_freq_update_time;
+	floor_ns = sugov_rate_limit_floor(sg_policy);
 
 	if (next_freq > sg_policy->next_freq &&
-	    delta_ns < sg_policy->up_rate_delay_ns)
+	    delta_ns < max(sg_policy->up_rate_delay_ns, floor_ns))
 			return true;
 
 	if (next_freq < sg_policy->next_freq &&
-	    delta_ns < sg_policy->down_rate_delay_ns)
+	    delta_ns < max(sg_policy->down_rate_delay_ns, floor_ns))
 			return true;
 
 	return false;
@@ -175,6 +210,7 @@ static bool sugov_update_next_freq(struct sugov_policy *sg_policy, u64 time,
 
 	sg_policy->next_freq = next_freq;
 	sg_policy->last_freq_update_time = time;
+	sg_policy->nr_requests++;
 
 	return true;
 }
@@ -240,12 +276,15 @@ static void sugov_fast_switch(struct sugov_policy *sg_policy, u64 time,
 {
 	struct cpufreq_policy *policy = sg_policy->policy;
 	unsigned int cpu;
+	u64 start;
 
 	if (!sugov_update_next_freq(sg_policy, time, next_freq))
 		return;
 
 	sugov_track_cycles(sg_policy, sg_policy->policy->cur, time);
+	start = ktime_get_ns();
 	next_freq = cpufreq_driver_fast_switch(policy, next_freq);
+	sugov_account_switch(sg_policy, ktime_get_ns() - start);
 	if (!next_freq)
 		return;
 
@@ -263,6 +302,17 @@ static void sugov_deferred_update(struct sugov_policy *sg_policy, u64 time,
 	if (!sugov_update_next_freq(sg_policy, time, next_freq))
 		return;
 
+	/*
+	 * Until sugov_work() has read next_freq, later requests of any CPU
+	 * of the policy only update it and ride on the queued work instead
+	 * of waking the kthread again.
+	 */
+	if (sg_policy->work_pending) {
+		sg_policy->nr_coalesced++;
+		return;
+	}
+
+	sg_policy->work_pending = true;
 	if (use_pelt())
 		sg_policy->work_in_progress = true;
 	irq_work_queue(&sg_policy->irq_work);
@@ -824,6 +874,7 @@ static void sugov_work(struct kthread_work *work)
 	struct sugov_policy *sg_policy = container_of(work, struct sugov_policy, work);
 	unsigned int freq;
 	unsigned long flags;
+	u64 start;
 
 	/*
 	 * Hold sg_policy->update_lock shortly to handle the case where:
@@ -837,6 +888,7 @@ static void sugov_work(struct kthread_work *work)
 	 */
 	raw_spin_lock_irqsave(&sg_policy->update_lock, flags);
 	freq = sg_policy->next_freq;
+	sg_policy->work_pending = false;
 	if (use_pelt())
 		sg_policy->work_in_progress = false;
 	sugov_track_cycles(sg_policy, sg_policy->policy->cur,
@@ -844,7 +896,9 @@ static void sugov_work(struct kthread_work *work)
 	raw_spin_unlock_irqrestore(&sg_policy->update_lock, flags);
 
 	mutex_lock(&sg_policy->work_lock);
+	start = ktime_get_ns();
 	__cpufreq_driver_target(sg_policy->policy, freq, CPUFREQ_RELATION_L);
+	sugov_account_switch(sg_policy, ktime_get_ns() - start);
 	mutex_unlock(&sg_policy->work_lock);
 }
 
@@ -1034,10 +1088,56 @@ static ssize_t pl_store(struct gov_attr_set *attr_set, const char *buf,
 	return count;
 }
 
+static ssize_t adaptive_rate_limit_show(struct gov_attr_set *attr_set,
+					char *buf)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n",
+			 tunables->adaptive_rate_limit);
+}
+
+static ssize_t adaptive_rate_limit_store(struct gov_attr_set *attr_set,
+					 const char *buf, size_t count)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+
+	if (kstrtobool(buf, &tunables->adaptive_rate_limit))
+		return -EINVAL;
+
+	return count;
+}
+
+static ssize_t stats_show(struct gov_attr_set *attr_set, char *buf)
+{
+	struct sugov_policy *sg_policy;
+	ssize_t count = 0;
+	u64 elapsed, rate;
+
+	list_for_each_entry(sg_policy, &attr_set->policy_list, tunables_hook) {
+		elapsed = ktime_get_ns() - sg_policy->stats_start_ns;
+		rate = div64_u64((u64)sg_policy->nr_requests * NSEC_PER_SEC,
+				 max_t(u64, elapsed, 1));
+
+		count += scnprintf(buf + count, PAGE_SIZE - count,
+			"policy%u: requests %lu rate %llu/s coalesced %lu switches %lu switch_lat_us %llu rate_limit_us %llu\n",
+			sg_policy->policy->cpu, sg_policy->nr_requests, rate,
+			sg_policy->nr_coalesced, sg_policy->nr_switches,
+			div_u64(sg_policy->switch_lat_ns, NSEC_PER_USEC),
+			div_u64(max(sg_policy->min_rate_limit_ns,
+				    sugov_rate_limit_floor(sg_policy)),
+				NSEC_PER_USEC));
+	}
+
+	return count;
+}
+
 static struct governor_attr hispeed_load = __ATTR_RW(hispeed_load);
 static struct governor_attr hispeed_freq = __ATTR_RW(hispeed_freq);
 static struct governor_attr rtg_boost_freq = __ATTR_RW(rtg_boost_freq);
 static struct governor_attr pl = __ATTR_RW(pl);
+static struct governor_attr adaptive_rate_limit = __ATTR_RW(adaptive_rate_limit);
+static struct governor_attr stats = __ATTR_RO(stats);
 
 static struct attribute *sugov_attributes[] = {
 	&up_rate_limit_us.attr,
@@ -1046,6 +1146,8 @@ static struct attribute *sugov_attributes[] = {
 	&hispeed_freq.attr,
 	&rtg_boost_freq.attr,
 	&pl.attr,
+	&adaptive_rate_limit.attr,
+	&stats.attr,
 	NULL
 };
 
@@ -1157,6 +1259,7 @@ static void sugov_tunables_save(struct cpufreq_policy *policy,
 	}
 
 	cached->pl = tunables->pl;
+	cached->adaptive_rate_limit = tunables->adaptive_rate_limit;
 	cached->hispeed_load = tunables->hispeed_load;
 	cached->rtg_boost_freq = tunables->rtg_boost_freq;
 	cached->hispeed_freq = tunables->hispeed_freq;
@@ -1182,6 +1285,7 @@ static void sugov_tunables_restore(struct cpufreq_policy *policy)
 		return;
 
 	tunables->pl = cached->pl;
+	tunables->adaptive_rate_limit = cached->adaptive_rate_limit;
 	tunables->hispeed_load = cached->hispeed_load;
 	tunables->rtg_boost_freq = cached->rtg_boost_freq;
 	tunables->hispeed_freq = cached->hispeed_freq;
@@ -1324,9 +1428,15 @@ static int sugov_start(struct cpufreq_policy *policy)
 	sg_policy->last_freq_update_time	= 0;
 	sg_policy->next_freq			= 0;
 	sg_policy->work_in_progress		= false;
+	sg_policy->work_pending			= false;
 	sg_policy->limits_changed		= false;
 	sg_policy->need_freq_update		= false;
 	sg_policy->cached_raw_freq		= 0;
+	sg_policy->stats_start_ns		= ktime_get_ns();
+	sg_policy->nr_requests			= 0;
+	sg_policy->nr_coalesced			= 0;
+	sg_policy->nr_switches			= 0;
+	sg_policy->switch_lat_ns		= 0;
 
 	for_each_cpu(cpu, policy->cpus) {
 		struct sugov_cpu *sg_cpu = &per_cpu(sugov_cpu, cpu);
@@ -3994,6 +3994,7 @@ struct find_best_target_env {
 	bool is_rtg;
 	bool boosted;
 	bool strict_max;
+	const struct cpumask *pack_cpus;
 };
 
 static inline void adjust_cpus_for_packing(struct task_struct *p,
@@ -6386,6 +6387,10 @@ find_idlest_group_cpu(struct sched_group *group, struct task_struct *p, int this
 
 	/* Traverse only the allowed CPUs */
 	for_each_cpu_and(i, sched_group_span(group), &p->cpus_allowed) {
+		/* Parked CPUs are idle but must not get new tasks */
+		if (cpu_parked(i))
+			continue;
+
 		if (available_idle_cpu(i)) {
 			struct rq *rq = cpu_rq(i);
 			struct cpuidle_state *idle = idle_get_state(rq);
@@ -6641,7 +6646,7 @@ static int select_idle_cpu(struct task_struct *p, struct sched_domain *sd, int t
 			return -1;
 		if (!cpumask_test_cpu(cpu, &p->cpus_allowed))
 			continue;
-		if (cpu_isolated(cpu))
+		if (cpu_isolated(cpu) || cpu_parked(cpu))
 			continue;
 		if (available_idle_cpu(cpu))
 			break;
@@ -6663,14 +6668,16 @@ static int select_idle_sibling(struct task_struct *p, int prev, int target)
 	struct sched_domain *sd;
 	int i, recent_used_cpu;
 
-	if (available_idle_cpu(target) && !cpu_isolated(target))
+	if (available_idle_cpu(target) && !cpu_isolated(target) &&
+	    !cpu_parked(target))
 		return target;
 
 	/*
 	 * If the previous CPU is cache affine and idle, don't be stupid:
 	 */
 	if (prev != target && cpus_share_cache(prev, target) &&
-			available_idle_cpu(prev) && !cpu_isolated(prev))
+			available_idle_cpu(prev) && !cpu_isolated(prev) &&
+			!cpu_parked(prev))
 		return prev;
 
 	/* Check a recently used CPU as a potential idle candidate: */
@@ -6679,6 +6686,7 @@ static int select_idle_sibling(struct task_struct *p, int prev, int target)
 	    recent_used_cpu != target &&
 	    cpus_share_cache(recent_used_cpu, target) &&
 	    available_idle_cpu(recent_used_cpu) &&
+	    !cpu_parked(recent_used_cpu) &&
 	    cpumask_test_cpu(p->recent_used_cpu, &p->cpus_allowed)) {
 		/*
 		 * Replace recent_used_cpu with prev as it is a potential
@@ -6849,6 +6857,21 @@ static inline bool task_skip_min_cpu(struct task_struct *p)
 		get_rtg_status(p) && p->unfilter;
 }
 
+/* CPUs the related thread group of @p is packed on, if any */
+static inline const struct cpumask *rtg_pack_cpus_of(struct task_struct *p)
+{
+	struct related_thread_group *grp;
+
+	if (!sysctl_sched_coloc_cache_pack)
+		return NULL;
+
+	grp = task_related_thread_group(p);
+	if (!grp || !cpumask_intersects(&grp->pack_cpus, &p->cpus_allowed))
+		return NULL;
+
+	return &grp->pack_cpus;
+}
+
 static inline bool is_many_wakeup(int sibling_count_hint)
 {
 	return sibling_count_hint >= sysctl_sched_many_wakeup_threshold;
@@ -6865,6 +6888,11 @@ static inline bool task_skip_min_cpu(struct task_struct *p)
 	return false;
 }
 
+static inline const struct cpumask *rtg_pack_cpus_of(struct task_struct *p)
+{
+	return NULL;
+}
+
 static inline bool is_many_wakeup(int sibling_count_hint)
 {
 	return false;
@@ -6975,8 +7003,10 @@ static void find_best_target(struct sched_domain *sd, cpumask_t *cpus,
 	/* fast path for prev_cpu */
 	if (((capacity_orig_of(prev_cpu) == capacity_orig_of(start_cpu)) ||
 		asym_cap_siblings(prev_cpu, start_cpu)) &&
-		!cpu_isolated(prev_cpu) && cpu_online(prev_cpu) &&
-		idle_cpu(prev_cpu)) {
+		!cpu_isolated(prev_cpu) && !cpu_parked(prev_cpu) &&
+		(!fbt_env->pack_cpus ||
+		 cpumask_test_cpu(prev_cpu, fbt_env->pack_cpus)) &&
+		cpu_online(prev_cpu) && idle_cpu(prev_cpu)) {
 
 		if (idle_get_state_idx(cpu_rq(prev_cpu)) <= 1) {
 			target_cpu = prev_cpu;
@@ -6998,7 +7028,7 @@ static void find_best_target(struct sched_domain *sd, cpumask_t *cpus,
 
 			trace_sched_cpu_util(i);
 
-			if (!cpu_online(i) || cpu_isolated(i))
+			if (!cpu_online(i) || cpu_isolated(i) || cpu_parked(i))
 				continue;
 
 			if (isolated_candidate == -1)
@@ -7018,6 +7048,11 @@ static void find_best_target(struct sched_domain *sd, cpumask_t *cpus,
 			if (fbt_env->skip_cpu == i)
 				continue;
 
+			/* Keep related thread groups on their shared cache */
+			if (fbt_env->pack_cpus &&
+			    !cpumask_test_cpu(i, fbt_env->pack_cpus))
+				continue;
+
 			/*
 			 * p's blocked utilization is still accounted for on prev_cpu
 			 * so prev_cpu will receive a negative bias due to the double
@@ -7368,7 +7403,7 @@ static void find_best_target(struct sched_domain *sd, cpumask_t *cpus,
 		target_cpu = most_spare_cap_cpu;
 
 	if (target_cpu == -1 && isolated_candidate != -1 &&
-					cpu_isolated(prev_cpu))
+		(cpu_isolated(prev_cpu) || cpu_parked(prev_cpu)))
 		target_cpu = isolated_candidate;
 
 	if (backup_cpu >= 0)
@@ -7495,18 +7530,81 @@ cpu_util_next_walt(int cpu, struct task_struct *p, int dst_cpu)
 #endif
 
 /*
- * compute_energy(): Estimates the energy that would be consumed if @p was
- * migrated to @dst_cpu. compute_energy() predicts what will be the utilization
- * landscape of the * CPUs after the task migration, and uses the Energy Model
- * to compute what would be the energy if we decided to actually migrate that
- * task.
+ * Contribution of @cpu to the energy estimate of its performance domain if
+ * @p was migrated to @dst_cpu (-1 to have @p on no CPU): its busy time in
+ * @sum_util and the utilization driving the domain frequency in @freq_util.
  */
-static long
-compute_energy(struct task_struct *p, int dst_cpu, struct perf_domain *pd)
+static inline void
+cpu_energy_util(struct task_struct *p, int cpu, int dst_cpu,
+		unsigned long cpu_cap, unsigned long *sum_util,
+		unsigned int *freq_util)
 {
-	unsigned int max_util, cpu_util, cpu_cap;
-	unsigned long sum_util, energy = 0;
-	int cpu;
+#ifdef CONFIG_SCHED_WALT
+	*freq_util = cpu_util_next_walt(cpu, p, dst_cpu);
+	*sum_util = *freq_util;
+#else
+	unsigned int util_cfs;
+	struct task_struct *tsk;
+
+	util_cfs = cpu_util_next(cpu, p, dst_cpu);
+
+	/*
+	 * Busy time computation: utilization clamping is not
+	 * required since the ratio (sum_util / cpu_capacity)
+	 * is already enough to scale the EM reported power
+	 * consumption at the (eventually clamped) cpu_capacity.
+	 */
+	*sum_util = schedutil_cpu_util(cpu, util_cfs, cpu_cap,
+				       ENERGY_UTIL, NULL);
+
+	/*
+	 * Performance domain frequency: utilization clamping
+	 * must be considered since it affects the selection
+	 * of the performance domain frequency.
+	 * NOTE: in case RT tasks are running, by default the
+	 * FREQUENCY_UTIL's utilization can be max OPP.
+	 */
+	tsk = cpu == dst_cpu ? p : NULL;
+	*freq_util = schedutil_cpu_util(cpu, util_cfs, cpu_cap,
+					FREQUENCY_UTIL, tsk);
+#endif
+}
+
+/*
+ * Per wakeup cache of the energy landscape with the waking task placed on
+ * no CPU. Moving the task to a CPU only changes the utilization of that
+ * CPU, so the energy of every other performance domain is reused as is and
+ * only the domain of the candidate is re-estimated, from its cached busy
+ * time sum and max frequency utilization.
+ */
+struct energy_env {
+	unsigned long base_energy;
+	/* Indexed by the first CPU of the performance domain */
+	struct {
+		unsigned long sum_util;
+		unsigned int max_util;
+		unsigned long energy;
+	} pd[NR_CPUS];
+#ifdef CONFIG_SCHED_PLACEMENT_TRACE
+	/* Estimates computed for the first CPUs, for the placement log */
+	unsigned long cpu_energy[SCHED_PLACEMENT_MAX_CPUS];
+#endif
+};
+
+static DEFINE_PER_CPU(struct energy_env, energy_env);
+
+static void
+energy_env_init(struct energy_env *eenv, struct task_struct *p,
+		struct perf_domain *pd)
+{
+	unsigned long sum_util, cpu_sum, cpu_cap;
+	unsigned int max_util, cpu_util;
+	int cpu, first;
+
+	eenv->base_energy = 0;
+#ifdef CONFIG_SCHED_PLACEMENT_TRACE
+	memset(eenv->cpu_energy, 0, sizeof(eenv->cpu_energy));
+#endif
 
 	for (; pd; pd = pd->next) {
 		struct cpumask *pd_mask = perf_domain_span(pd);
@@ -7515,7 +7613,8 @@ compute_energy(struct task_struct *p, int dst_cpu, struct perf_domain *pd)
 		 * The energy model mandates all the CPUs of a performance
 		 * domain have the same capacity.
 		 */
-		cpu_cap = arch_scale_cpu_capacity(NULL, cpumask_first(pd_mask));
+		first = cpumask_first(pd_mask);
+		cpu_cap = arch_scale_cpu_capacity(NULL, first);
 		max_util = sum_util = 0;
 
 		/*
@@ -7529,44 +7628,119 @@ compute_energy(struct task_struct *p, int dst_cpu, struct perf_domain *pd)
 		 * by compute_energy().
 		 */
 		for_each_cpu_and(cpu, pd_mask, cpu_online_mask) {
-#ifdef CONFIG_SCHED_WALT
-			cpu_util = cpu_util_next_walt(cpu, p, dst_cpu);
-			sum_util += cpu_util;
-#else
-			unsigned int util_cfs;
-			struct task_struct *tsk;
+			cpu_energy_util(p, cpu, -1, cpu_cap, &cpu_sum,
+					&cpu_util);
+			sum_util += cpu_sum;
+			max_util = max(max_util, cpu_util);
+		}
 
-			util_cfs = cpu_util_next(cpu, p, dst_cpu);
+		eenv->pd[first].sum_util = sum_util;
+		eenv->pd[first].max_util = max_util;
+		eenv->pd[first].energy = em_pd_energy(pd->em_pd, max_util,
+						      sum_util);
+		eenv->base_energy += eenv->pd[first].energy;
+	}
+}
 
-			/*
-			 * Busy time computation: utilization clamping is not
-			 * required since the ratio (sum_util / cpu_capacity)
-			 * is already enough to scale the EM reported power
-			 * consumption at the (eventually clamped) cpu_capacity.
-			 */
-			sum_util += schedutil_cpu_util(cpu, util_cfs, cpu_cap,
-						       ENERGY_UTIL, NULL);
+/*
+ * compute_energy(): Estimates the energy that would be consumed if @p was
+ * migrated to @dst_cpu. compute_energy() predicts what will be the utilization
+ * landscape of the * CPUs after the task migration, and uses the Energy Model
+ * to compute what would be the energy if we decided to actually migrate that
+ * task.
+ *
+ * @eenv must have been set up by energy_env_init() for the same @p and @pd.
+ * Adding @p to @dst_cpu can only raise its utilization, so the domain max
+ * is the cached max or the new utilization of @dst_cpu.
+ */
+static long
+compute_energy(struct energy_env *eenv, struct task_struct *p, int dst_cpu,
+	       struct perf_domain *pd)
+{
+	unsigned long sum_util, old_sum, new_sum, cpu_cap, energy;
+	unsigned int max_util, old_util, new_util;
+	int first;
 
-			/*
-			 * Performance domain frequency: utilization clamping
-			 * must be considered since it affects the selection
-			 * of the performance domain frequency.
-			 * NOTE: in case RT tasks are running, by default the
-			 * FREQUENCY_UTIL's utilization can be max OPP.
-			 */
-			tsk = cpu == dst_cpu ? p : NULL;
-			cpu_util = schedutil_cpu_util(cpu, util_cfs, cpu_cap,
-						      FREQUENCY_UTIL, tsk);
-#endif
-			max_util = max(max_util, cpu_util);
-		}
+	energy = eenv->base_energy;
+	if (!cpu_online(dst_cpu))
+		goto out;
 
-		energy += em_pd_energy(pd->em_pd, max_util, sum_util);
+	for (; pd; pd = pd->next) {
+		if (cpumask_test_cpu(dst_cpu, perf_domain_span(pd)))
+			break;
 	}
+	if (!pd)
+		goto out;
+
+	first = cpumask_first(perf_domain_span(pd));
+	cpu_cap = arch_scale_cpu_capacity(NULL, first);
+
+	cpu_energy_util(p, dst_cpu, -1, cpu_cap, &old_sum, &old_util);
+	cpu_energy_util(p, dst_cpu, dst_cpu, cpu_cap, &new_sum, &new_util);
 
+	sum_util = eenv->pd[first].sum_util - old_sum + new_sum;
+	max_util = max(eenv->pd[first].max_util, new_util);
+
+	energy += em_pd_energy(pd->em_pd, max_util, sum_util) -
+		  eenv->pd[first].energy;
+out:
+#ifdef CONFIG_SCHED_PLACEMENT_TRACE
+	if (dst_cpu < SCHED_PLACEMENT_MAX_CPUS)
+		eenv->cpu_energy[dst_cpu] = energy;
+#endif
 	return energy;
 }
 
+#ifdef CONFIG_SCHED_PLACEMENT_TRACE
+static noinline void
+log_placement(struct task_struct *p, int prev_cpu, int target_cpu,
+	      cpumask_t *candidates, struct energy_env *eenv,
+	      unsigned long prev_energy, unsigned long best_energy,
+	      struct find_best_target_env *fbt_env, int sync, bool boosted)
+{
+	struct sched_placement_rec rec;
+	int cpu;
+
+	memset(&rec, 0, sizeof(rec));
+	rec.pid = p->pid;
+	rec.task_util = min_t(unsigned long, task_util_est(p), U16_MAX);
+	rec.boost = schedtune_task_boost(p);
+	rec.prev_cpu = prev_cpu;
+	rec.start_cpu = fbt_env->start_cpu;
+	rec.target_cpu = target_cpu;
+	rec.fastpath = fbt_env->fastpath;
+	rec.candidates = cpumask_bits(candidates)[0];
+
+	if (sync)
+		rec.flags |= SCHED_PLACEMENT_F_SYNC;
+	if (fbt_env->need_idle)
+		rec.flags |= SCHED_PLACEMENT_F_NEED_IDLE;
+	if (fbt_env->is_rtg)
+		rec.flags |= SCHED_PLACEMENT_F_RTG;
+	if (boosted)
+		rec.flags |= SCHED_PLACEMENT_F_BOOSTED;
+
+	if (eenv) {
+		rec.flags |= SCHED_PLACEMENT_F_ENERGY;
+		rec.prev_energy = prev_energy;
+		rec.best_energy = best_energy;
+		for (cpu = 0; cpu < SCHED_PLACEMENT_MAX_CPUS; cpu++)
+			rec.energy[cpu] = min_t(unsigned long,
+						eenv->cpu_energy[cpu], U32_MAX);
+	}
+
+	sched_placement_push(&rec);
+}
+#else
+static inline void
+log_placement(struct task_struct *p, int prev_cpu, int target_cpu,
+	      cpumask_t *candidates, struct energy_env *eenv,
+	      unsigned long prev_energy, unsigned long best_energy,
+	      struct find_best_target_env *fbt_env, int sync, bool boosted)
+{
+}
+#endif
+
 static void select_cpu_candidates(struct sched_domain *sd, cpumask_t *cpus,
 		struct perf_domain *pd, struct task_struct *p, int prev_cpu)
 {
@@ -7718,13 +7892,14 @@ static DEFINE_PER_CPU(cpumask_t, energy_cpus);
  * let's keep things simple by re-using the existing slow path.
  */
 
-static int find_energy_efficient_cpu(struct task_struct *p, int prev_cpu,
-				     int sync, int sibling_count_hint)
+static int __find_energy_efficient_cpu(struct task_struct *p, int prev_cpu,
+				       int sync, int sibling_count_hint)
 {
 	unsigned long prev_energy = ULONG_MAX, best_energy = ULONG_MAX;
 	struct root_domain *rd = cpu_rq(smp_processor_id())->rd;
 	int weight, cpu = smp_processor_id(), best_energy_cpu = prev_cpu;
 	unsigned long cur_energy;
+	struct energy_env *eenv = NULL;
 	struct perf_domain *pd;
 	struct sched_domain *sd;
 	cpumask_t *candidates;
@@ -7751,6 +7926,9 @@ static int find_energy_efficient_cpu(struct task_struct *p, int prev_cpu,
 
 	fbt_env.fastpath = 0;
 	fbt_env.need_idle = need_idle;
+	fbt_env.is_rtg = is_rtg;
+	fbt_env.start_cpu = start_cpu;
+	fbt_env.pack_cpus = NULL;
 
 	if (trace_sched_task_util_enabled())
 		start_t = sched_clock();
@@ -7797,8 +7975,15 @@ static int find_energy_efficient_cpu(struct task_struct *p, int prev_cpu,
 			(task_boost == TASK_BOOST_STRICT_MAX);
 		fbt_env.skip_cpu = is_many_wakeup(sibling_count_hint) ?
 				   cpu : -1;
+		fbt_env.pack_cpus = is_rtg ? rtg_pack_cpus_of(p) : NULL;
 
 		find_best_target(NULL, candidates, p, &fbt_env);
+
+		/* The packed CPUs are a preference, fall back to all */
+		if (fbt_env.pack_cpus && cpumask_empty(candidates)) {
+			fbt_env.pack_cpus = NULL;
+			find_best_target(NULL, candidates, p, &fbt_env);
+		}
 	} else {
 		select_cpu_candidates(sd, candidates, pd, p, prev_cpu);
 	}
@@ -7841,13 +8026,18 @@ static int find_energy_efficient_cpu(struct task_struct *p, int prev_cpu,
 #endif
 	if (task_placement_boost_enabled(p) || fbt_env.need_idle || boosted ||
 	    is_rtg || __cpu_overutilized(prev_cpu, delta) ||
-	    !task_fits_max(p, prev_cpu) || cpu_isolated(prev_cpu)) {
+	    !task_fits_max(p, prev_cpu) || cpu_isolated(prev_cpu) ||
+	    cpu_parked(prev_cpu)) {
 		best_energy_cpu = cpu;
 		goto unlock;
 	}
 
+	eenv = this_cpu_ptr(&energy_env);
+	energy_env_init(eenv, p, pd);
+
 	if (cpumask_test_cpu(prev_cpu, &p->cpus_allowed))
-		prev_energy = best_energy = compute_energy(p, prev_cpu, pd);
+		prev_energy = best_energy = compute_energy(eenv, p, prev_cpu,
+							   pd);
 	else
 		prev_energy = best_energy = ULONG_MAX;
 
@@ -7855,7 +8045,7 @@ static int find_energy_efficient_cpu(struct task_struct *p, int prev_cpu,
 	for_each_cpu(cpu, candidates) {
 		if (cpu == prev_cpu)
 			continue;
-		cur_energy = compute_energy(p, cpu, pd);
+		cur_energy = compute_energy(eenv, p, cpu, pd);
 		trace_sched_compute_energy(p, cpu, cur_energy, prev_energy,
 					   best_energy, best_energy_cpu);
 		if (cur_energy < best_energy) {
@@ -7883,6 +8073,9 @@ unlock:
 		best_energy_cpu = prev_cpu;
 
 done:
+	if (sched_placement_active())
+		log_placement(p, prev_cpu, best_energy_cpu, candidates, eenv,
+			      prev_energy, best_energy, &fbt_env, sync, boosted);
 
 	trace_sched_task_util(p, cpumask_bits(candidates)[0], best_energy_cpu,
 			sync, fbt_env.need_idle, fbt_env.fastpath,
@@ -7897,6 +8090,28 @@ eas_not_ready:
 	return -1;
 }
 
+static int find_energy_efficient_cpu(struct task_struct *p, int prev_cpu,
+				     int sync, int sibling_count_hint)
+{
+	struct rq *rq;
+	u64 start;
+	int cpu;
+
+	if (!schedstat_enabled())
+		return __find_energy_efficient_cpu(p, prev_cpu, sync,
+						   sibling_count_hint);
+
+	start = sched_clock();
+	cpu = __find_energy_efficient_cpu(p, prev_cpu, sync,
+					  sibling_count_hint);
+
+	rq = this_rq();
+	schedstat_inc(rq->eas_count);
+	schedstat_add(rq->eas_time, sched_clock() - start);
+
+	return cpu;
+}
+
 /*
  * select_task_rq_fair: Select target runqueue for the waking task in domains
  * that have the 'sd_flag' flag set. In practice, this is SD_BALANCE_WAKE,
@@ -9674,6 +9889,10 @@ static inline void update_sg_lb_stats(struct lb_env *env,
 	for_each_cpu_and(i, sched_group_span(group), env->cpus) {
 		struct rq *rq = cpu_rq(i);
 
+		/*
+		 * Parked CPUs stay visible as load sources so that whatever
+		 * still runs there gets pulled off by the active CPUs.
+		 */
 		if (cpu_isolated(i))
 			continue;
 
@@ -10624,6 +10843,7 @@ static int group_balance_cpu_not_isolated(struct sched_group *sg)
 
 	cpumask_and(&cpus, sched_group_span(sg), group_balance_mask(sg));
 	cpumask_andnot(&cpus, &cpus, cpu_isolated_mask);
+	cpumask_andnot(&cpus, &cpus, cpu_parked_mask);
 	return cpumask_first(&cpus);
 }
 
@@ -10650,7 +10870,7 @@ static int should_we_balance(struct lb_env *env)
 
 	/* Try to find first idle CPU */
 	for_each_cpu_and(cpu, group_balance_mask(sg), env->cpus) {
-		if (!idle_cpu(cpu) || cpu_isolated(cpu))
+		if (!idle_cpu(cpu) || cpu_isolated(cpu) || cpu_parked(cpu))
 			continue;
 
 		balance_cpu = cpu;
@@ -11348,6 +11568,7 @@ static inline int find_energy_aware_new_ilb(void)
 	cpumask_and(&idle_cpus, nohz.idle_cpus_mask,
 			housekeeping_cpumask(HK_FLAG_MISC));
 	cpumask_andnot(&idle_cpus, &idle_cpus, cpu_isolated_mask);
+	cpumask_andnot(&idle_cpus, &idle_cpus, cpu_parked_mask);
 
 	/*
 	 * If a CPU is claimed it means that TIF_NEED_RESCHED
@@ -11497,6 +11718,7 @@ static void nohz_balancer_kick(struct rq *rq)
 	 * balancing.
 	 */
 	cpumask_andnot(&cpumask, nohz.idle_cpus_mask, cpu_isolated_mask);
+	cpumask_andnot(&cpumask, &cpumask, cpu_parked_mask);
 	if (cpumask_empty(&cpumask))
 		return;
 
@@ -11732,6 +11954,7 @@ static bool _nohz_idle_balance(struct rq *this_rq, unsigned int flags,
 	smp_mb();
 
 	cpumask_andnot(&cpus, nohz.idle_cpus_mask, cpu_isolated_mask);
+	cpumask_andnot(&cpus, &cpus, cpu_parked_mask);
 
 	for_each_cpu(balance_cpu, &cpus) {
 		if (balance_cpu == this_cpu || !idle_cpu(balance_cpu))
@@ -11910,7 +12133,7 @@ static int idle_balance(struct rq *this_rq, struct rq_flags *rf)
 				(atomic_read(&this_rq->nr_iowait) == 0));
 
 
-	if (cpu_isolated(this_cpu))
+	if (cpu_isolated(this_cpu) || cpu_parked(this_cpu))
 		return 0;
 
 	/*
@@ -12039,9 +12262,9 @@ static __latent_entropy void run_rebalance_domains(struct softirq_action *h)
 	/*
 	 * Since core isolation doesn't update nohz.idle_cpus_mask, there
 	 * is a possibility this nohz kicked cpu could be isolated. Hence
-	 * return if the cpu is isolated.
+	 * return if the cpu is isolated. A parked cpu must not pull either.
 	 */
-	if (cpu_isolated(this_rq->cpu))
+	if (cpu_isolated(this_rq->cpu) || cpu_parked(this_rq->cpu))
 		return;
 
 	/*
@@ -12066,9 +12289,10 @@ static __latent_entropy void run_rebalance_domains(struct softirq_action *h)
 void trigger_load_balance(struct rq *rq)
 {
 	/* Don't need to rebalance while attached to NULL domain or
-	 * cpu is isolated.
+	 * cpu is isolated or parked.
 	 */
-	if (unlikely(on_null_domain(rq)) || cpu_isolated(cpu_of(rq)))
+	if (unlikely(on_null_domain(rq)) || cpu_isolated(cpu_of(rq)) ||
+	    cpu_parked(cpu_of(rq)))
 		return;
 
 	if (time_after_eq(jiffies, rq->next_balance))
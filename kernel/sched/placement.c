@@ -0,0 +1,234 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Binary log of the energy aware wakeup placement decisions.
+ *
+ * find_energy_efficient_cpu() hands its inputs and outcome to
+ * sched_placement_push(), which completes the record with the state of
+ * the CPUs and appends it to a ring of the local CPU. The rings are read,
+ * and consumed, through <tracefs>/sched_placement/cpuN as an array of
+ * struct sched_placement_rec, for offline replay with tools/sched.
+ */
+#include <linux/mm.h>
+#include <linux/seq_file.h>
+#include <linux/tracefs.h>
+#include <linux/uaccess.h>
+
+#include "sched.h"
+
+/* Records per CPU, must be a power of two */
+#define PLACEMENT_RING_SIZE	256
+
+/* Records copied to userspace per ring lock hold */
+#define PLACEMENT_READ_BATCH	4
+
+struct placement_ring {
+	raw_spinlock_t lock;
+	unsigned int head;		/* next record written */
+	unsigned int tail;		/* next record read */
+	unsigned long recorded;
+	unsigned long lost;		/* overwritten before being read */
+	struct sched_placement_rec rec[PLACEMENT_RING_SIZE];
+};
+
+DEFINE_STATIC_KEY_FALSE(sched_placement_enabled);
+
+static DEFINE_PER_CPU(struct placement_ring *, placement_ring);
+static DEFINE_MUTEX(placement_mutex);
+
+void sched_placement_push(struct sched_placement_rec *rec)
+{
+	struct placement_ring *ring = this_cpu_read(placement_ring);
+	struct sched_placement_cpu *c;
+	unsigned long flags;
+	int cpu;
+
+	if (!ring)
+		return;
+
+	rec->ts = sched_clock();
+	rec->nr_cpus = min_t(int, nr_cpu_ids, SCHED_PLACEMENT_MAX_CPUS);
+	for (cpu = 0; cpu < rec->nr_cpus; cpu++) {
+		struct rq *rq = cpu_rq(cpu);
+
+		c = &rec->cpu[cpu];
+		c->util = cpu_util(cpu);
+		c->capacity = capacity_orig_of(cpu);
+		c->idle_idx = idle_cpu(cpu) ? idle_get_state_idx(rq) : -1;
+		c->nr_running = min_t(unsigned int, rq->nr_running, U8_MAX);
+	}
+
+	raw_spin_lock_irqsave(&ring->lock, flags);
+	if (ring->head - ring->tail == PLACEMENT_RING_SIZE) {
+		ring->tail++;
+		ring->lost++;
+	}
+	ring->rec[ring->head & (PLACEMENT_RING_SIZE - 1)] = *rec;
+	ring->head++;
+	ring->recorded++;
+	raw_spin_unlock_irqrestore(&ring->lock, flags);
+}
+
+static int placement_alloc_rings(void)
+{
+	struct placement_ring *ring;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		if (per_cpu(placement_ring, cpu))
+			continue;
+
+		ring = kvzalloc_node(sizeof(*ring), GFP_KERNEL,
+				     cpu_to_node(cpu));
+		if (!ring)
+			return -ENOMEM;
+
+		raw_spin_lock_init(&ring->lock);
+		per_cpu(placement_ring, cpu) = ring;
+	}
+
+	return 0;
+}
+
+static ssize_t placement_cpu_read(struct file *filp, char __user *ubuf,
+				  size_t cnt, loff_t *ppos)
+{
+	struct sched_placement_rec buf[PLACEMENT_READ_BATCH];
+	long cpu = (long)file_inode(filp)->i_private;
+	struct placement_ring *ring;
+	size_t done = 0;
+	unsigned int i, n;
+
+	ring = per_cpu(placement_ring, cpu);
+	if (!ring)
+		return 0;
+
+	if (cnt < sizeof(buf[0]))
+		return -EINVAL;
+
+	while (cnt - done >= sizeof(buf[0])) {
+		n = min_t(size_t, (cnt - done) / sizeof(buf[0]),
+			  PLACEMENT_READ_BATCH);
+
+		raw_spin_lock_irq(&ring->lock);
+		n = min(n, ring->head - ring->tail);
+		for (i = 0; i < n; i++, ring->tail++)
+			buf[i] = ring->rec[ring->tail &
+					   (PLACEMENT_RING_SIZE - 1)];
+		raw_spin_unlock_irq(&ring->lock);
+
+		if (!n)
+			break;
+
+		if (copy_to_user(ubuf + done, buf, n * sizeof(buf[0])))
+			return done ? done : -EFAULT;
+		done += n * sizeof(buf[0]);
+	}
+
+	return done;
+}
+
+static const struct file_operations placement_cpu_fops = {
+	.open		= simple_open,
+	.read		= placement_cpu_read,
+	.llseek		= no_llseek,
+};
+
+static ssize_t placement_enable_read(struct file *filp, char __user *ubuf,
+				     size_t cnt, loff_t *ppos)
+{
+	char buf[4];
+	int r;
+
+	r = scnprintf(buf, sizeof(buf), "%d\n",
+		      static_key_enabled(&sched_placement_enabled));
+	return simple_read_from_buffer(ubuf, cnt, ppos, buf, r);
+}
+
+static ssize_t placement_enable_write(struct file *filp,
+				      const char __user *ubuf,
+				      size_t cnt, loff_t *ppos)
+{
+	bool enable;
+	int ret;
+
+	ret = kstrtobool_from_user(ubuf, cnt, &enable);
+	if (ret)
+		return ret;
+
+	mutex_lock(&placement_mutex);
+	if (enable) {
+		ret = placement_alloc_rings();
+		if (!ret)
+			static_branch_enable(&sched_placement_enabled);
+	} else {
+		static_branch_disable(&sched_placement_enabled);
+	}
+	mutex_unlock(&placement_mutex);
+
+	return ret ? ret : cnt;
+}
+
+static const struct file_operations placement_enable_fops = {
+	.open		= simple_open,
+	.read		= placement_enable_read,
+	.write		= placement_enable_write,
+	.llseek		= default_llseek,
+};
+
+static int placement_stats_show(struct seq_file *m, void *v)
+{
+	struct placement_ring *ring;
+	int cpu;
+
+	seq_printf(m, "version %d record_size %zu\n",
+		   SCHED_PLACEMENT_VERSION, sizeof(struct sched_placement_rec));
+
+	for_each_possible_cpu(cpu) {
+		ring = per_cpu(placement_ring, cpu);
+		if (!ring)
+			continue;
+
+		seq_printf(m, "cpu%d recorded %lu lost %lu pending %u\n", cpu,
+			   READ_ONCE(ring->recorded), READ_ONCE(ring->lost),
+			   READ_ONCE(ring->head) - READ_ONCE(ring->tail));
+	}
+
+	return 0;
+}
+
+static int placement_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, placement_stats_show, NULL);
+}
+
+static const struct file_operations placement_stats_fops = {
+	.open		= placement_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static __init int sched_placement_init(void)
+{
+	struct dentry *dir;
+	char name[16];
+	long cpu;
+
+	dir = tracefs_create_dir("sched_placement", NULL);
+	if (!dir) {
+		pr_warn("Could not create tracefs 'sched_placement' directory\n");
+		return 0;
+	}
+
+	tracefs_create_file("enable", 0644, dir, NULL, &placement_enable_fops);
+	tracefs_create_file("stats", 0444, dir, NULL, &placement_stats_fops);
+
+	for_each_possible_cpu(cpu) {
+		snprintf(name, sizeof(name), "cpu%ld", cpu);
+		tracefs_create_file(name, 0400, dir, (void *)cpu,
+				    &placement_cpu_fops);
+	}
+
+	return 0;
+}
+fs_initcall(sched_placement_init);
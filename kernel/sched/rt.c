@@ -269,10 +269,10 @@ static inline bool need_pull_rt_task(struct rq *rq, struct task_struct *prev)
 {
 	/*
 	 * Try to pull RT tasks here if we lower this rq's prio and cpu is not
-	 * isolated
+	 * isolated or parked
 	 */
 	return rq->rt.highest_prio.curr > prev->prio &&
-	       !cpu_isolated(cpu_of(rq));
+	       !cpu_isolated(cpu_of(rq)) && !cpu_parked(cpu_of(rq));
 }
 
 static inline int rt_overloaded(struct rq *rq)
@@ -1800,7 +1800,7 @@ retry:
 
 			trace_sched_cpu_util(cpu);
 
-			if (cpu_isolated(cpu))
+			if (cpu_isolated(cpu) || cpu_parked(cpu))
 				continue;
 
 			if (sched_cpu_high_irqload(cpu))
@@ -2440,7 +2440,7 @@ static void switched_from_rt(struct rq *rq, struct task_struct *p)
 	 * now.
 	 */
 	if (!task_on_rq_queued(p) || rq->rt.rt_nr_running ||
-		cpu_isolated(cpu_of(rq)))
+		cpu_isolated(cpu_of(rq)) || cpu_parked(cpu_of(rq)))
 		return;
 
 	rt_queue_pull_task(rq);
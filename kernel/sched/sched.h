@@ -33,6 +33,7 @@
 #include <linux/sched/wake_q.h>
 #include <linux/sched/xacct.h>
 
+#include <uapi/linux/sched/placement.h>
 #include <uapi/linux/sched/types.h>
 
 #include <linux/binfmts.h>
@@ -143,6 +144,7 @@ struct sched_cluster {
 	unsigned int max_possible_freq;
 	bool freq_init_done;
 	u64 aggr_grp_load;
+	seqcount_t aggr_seq;
 };
 
 extern cpumask_t asym_cap_sibling_cpus;
@@ -1068,6 +1070,7 @@ struct rq {
 	struct load_subtractions load_subs[NUM_TRACKED_WINDOWS];
 	DECLARE_BITMAP_ARRAY(top_tasks_bitmap,
 			NUM_TRACKED_WINDOWS, NUM_LOAD_INDICES);
+	unsigned long		top_tasks_summary[NUM_TRACKED_WINDOWS];
 	u8			*top_tasks[NUM_TRACKED_WINDOWS];
 	u8			curr_table;
 	int			prev_top;
@@ -1113,6 +1116,10 @@ struct rq {
 	/* try_to_wake_up() stats */
 	unsigned int		ttwu_count;
 	unsigned int		ttwu_local;
+
+	/* find_energy_efficient_cpu() stats */
+	unsigned int		eas_count;
+	unsigned long long	eas_time;
 #endif
 
 #ifdef CONFIG_SMP
@@ -2768,6 +2775,25 @@ struct related_thread_group {
 	u64 last_update;
 	u64 downmigrate_ts;
 	u64 start_ts;
+	/* CPUs sharing a cache the group is packed on, empty if not packed */
+	cpumask_t pack_cpus;
+	u64 pack_backoff_until;
+	/* Placement of the group over the current window */
+	u64 stats_window_start;
+	cpumask_t spread_cpus;
+	atomic_t nr_migrations;
+	atomic64_t cache_misses;
+	atomic64_t instructions;
+	/* Placement over the last window and since the group was created */
+	unsigned int last_spread;
+	unsigned int last_migrations;
+	unsigned int packed_mpki;
+	unsigned int unpacked_mpki;
+	u64 nr_windows;
+	u64 nr_packed_windows;
+	u64 sum_spread;
+	u64 sum_migrations;
+	unsigned int nr_backoffs;
 };
 
 extern struct sched_cluster *sched_cluster[NR_CPUS];
@@ -2792,6 +2818,8 @@ extern int update_preferred_cluster(struct related_thread_group *grp,
 			struct task_struct *p, u32 old_load, bool from_tick);
 extern void set_preferred_cluster(struct related_thread_group *grp);
 extern void add_new_task_to_grp(struct task_struct *new);
+extern void rtg_pack_tick(struct related_thread_group *grp, int cpu);
+extern void rtg_pack_switch(struct task_struct *next, int cpu);
 
 #define NO_BOOST 0
 #define FULL_THROTTLE_BOOST 1
@@ -2957,7 +2985,7 @@ extern int preferred_cluster(struct sched_cluster *cluster,
 						struct task_struct *p);
 extern struct sched_cluster *rq_cluster(struct rq *rq);
 extern void reset_task_stats(struct task_struct *p);
-extern void clear_top_tasks_bitmap(unsigned long *bitmap);
+extern void clear_top_tasks_bitmap(struct rq *rq, int table);
 
 #if defined(CONFIG_SCHED_TUNE)
 extern bool task_sched_boost(struct task_struct *p);
@@ -3137,6 +3165,9 @@ static inline bool asym_cap_sibling_group_has_capacity(int dst_cpu, int margin)
 
 static inline void set_preferred_cluster(struct related_thread_group *grp) { }
 
+static inline void rtg_pack_tick(struct related_thread_group *grp, int cpu) { }
+static inline void rtg_pack_switch(struct task_struct *next, int cpu) { }
+
 static inline bool task_in_related_thread_group(struct task_struct *p)
 {
 	return false;
@@ -3229,3 +3260,41 @@ struct sched_avg_stats {
 	int nr_scaled;
 };
 extern void sched_get_nr_running_avg(struct sched_avg_stats *stats);
+
+#ifdef CONFIG_HOTPLUG_CPU
+extern struct cpumask __cpu_parked_mask;
+#define cpu_parked_mask ((const struct cpumask *)&__cpu_parked_mask)
+
+extern int sched_park_cpu(int cpu);
+extern void sched_unpark_cpu(int cpu);
+#else
+#define cpu_parked_mask cpu_none_mask
+
+static inline int sched_park_cpu(int cpu)
+{
+	return -EINVAL;
+}
+
+static inline void sched_unpark_cpu(int cpu) { }
+#endif
+
+/* A parked CPU keeps running its tasks but does not take new ones */
+static inline bool cpu_parked(int cpu)
+{
+	return cpumask_test_cpu(cpu, cpu_parked_mask);
+}
+
+#ifdef CONFIG_SCHED_PLACEMENT_TRACE
+DECLARE_STATIC_KEY_FALSE(sched_placement_enabled);
+extern void sched_placement_push(struct sched_placement_rec *rec);
+
+static inline bool sched_placement_active(void)
+{
+	return static_branch_unlikely(&sched_placement_enabled);
+}
+#else
+static inline bool sched_placement_active(void)
+{
+	return false;
+}
+#endif
@@ -216,6 +216,21 @@ unsigned int sched_get_cpu_util(int cpu)
 	return busy;
 }
 
+/*
+ * Returns the CPU utilization % predicted for the next window, from the
+ * WALT predicted demand (busy buckets) of the tasks enqueued on the CPU.
+ */
+unsigned int sched_get_cpu_pred_util(int cpu)
+{
+	struct rq *rq = cpu_rq(cpu);
+	unsigned long capacity = capacity_orig_of(cpu);
+	u64 util;
+
+	util = READ_ONCE(rq->walt_stats.pred_demands_sum_scaled);
+	util = (util >= capacity) ? capacity : util;
+	return div64_ul((util * 100), capacity);
+}
+
 u64 sched_lpm_disallowed_time(int cpu)
 {
 	u64 now = sched_clock();
@@ -3,6 +3,7 @@
 #include <linux/kernel.h>
 #include <linux/percpu.h>
 #include <linux/printk.h>
+#include <linux/random.h>
 #include <linux/rcupdate.h>
 #include <linux/slab.h>
 
@@ -32,7 +33,13 @@ extern struct reciprocal_value schedtune_spc_rdiv;
  * corresponding "boost_group" marked as valid on each CPU.
  * Once a CGroup is release, the corresponding "boost_group" is marked as
  * invalid on each CPU. The CPU boost value (boost_max) is aggregated by
- * considering only valid boost_groups with a non null tasks counter.
+ * considering only valid boost_groups with a non null tasks counter, or
+ * still holding the boost of their last task.
+ *
+ * Each CPU keeps a reference count of its active boost groups per boost
+ * value, with a bitmap of the referenced values. A boost group (de)activation
+ * moves one reference and boost_max is the last bit of the bitmap, so the
+ * enqueue/dequeue accounting does not depend on the number of boost groups.
  *
  * .:: Locking strategy
  *
@@ -164,6 +171,9 @@ root_schedtune = {
  */
 #define BOOSTGROUPS_COUNT 6
 
+/* Boost values range in [0..100] */
+#define SCHEDTUNE_BOOST_VALUES 101
+
 /* Array of configured boostgroups */
 static struct schedtune *allocated_group[BOOSTGROUPS_COUNT] = {
 	&root_schedtune,
@@ -181,7 +191,16 @@ static struct schedtune *allocated_group[BOOSTGROUPS_COUNT] = {
 struct boost_groups {
 	/* Maximum boost value for all RUNNABLE tasks on a CPU */
 	int boost_max;
+	/* Oldest hold activation of the held boost groups */
 	u64 boost_ts;
+	/* Boost groups accounted in boost_map */
+	unsigned long active;
+	/* Active boost groups without RUNNABLE tasks, in their hold */
+	unsigned long held;
+	/* Count of active boost groups for each boost value */
+	u8 boost_refs[SCHEDTUNE_BOOST_VALUES];
+	/* Boost values with a non null boost_refs */
+	DECLARE_BITMAP(boost_map, SCHEDTUNE_BOOST_VALUES);
 	struct {
 		/* True when this boost group maps an actual cgroup */
 		bool valid;
@@ -274,64 +293,105 @@ static inline bool schedtune_boost_timeout(u64 now, u64 ts)
 	return ((now - ts) > SCHEDTUNE_BOOST_HOLD_NS);
 }
 
-static inline bool
-schedtune_boost_group_active(int idx, struct boost_groups* bg, u64 now)
+static inline void schedtune_boost_get(struct boost_groups *bg, int boost)
 {
-	if (bg->group[idx].tasks)
-		return true;
+	if (!bg->boost_refs[boost]++)
+		__set_bit(boost, bg->boost_map);
+}
 
-	return !schedtune_boost_timeout(now, bg->group[idx].ts);
+static inline void schedtune_boost_put(struct boost_groups *bg, int boost)
+{
+	if (!--bg->boost_refs[boost])
+		__clear_bit(boost, bg->boost_map);
 }
 
-static void
-schedtune_cpu_update(int cpu, u64 now)
+static inline void schedtune_boost_max_update(struct boost_groups *bg)
 {
-	struct boost_groups *bg = &per_cpu(cpu_boost_groups, cpu);
-	int boost_max;
-	u64 boost_ts;
-	int idx;
+	int boost = find_last_bit(bg->boost_map, SCHEDTUNE_BOOST_VALUES);
 
-	/* The root boost group is always active */
-	boost_max = bg->group[0].boost;
-	boost_ts = now;
-	for (idx = 1; idx < BOOSTGROUPS_COUNT; ++idx) {
+	/* The root boost group keeps at least one value referenced */
+	if (boost == SCHEDTUNE_BOOST_VALUES)
+		boost = 0;
 
-		/* Ignore non boostgroups not mapping a cgroup */
-		if (!bg->group[idx].valid)
-			continue;
+	WRITE_ONCE(bg->boost_max, boost);
+}
 
-		/*
-		 * A boost group affects a CPU only if it has
-		 * RUNNABLE tasks on that CPU or it has hold
-		 * in effect from a previous task.
-		 */
-		if (!schedtune_boost_group_active(idx, bg, now))
-			continue;
+/*
+ * A boost group affects a CPU only if it has RUNNABLE tasks on that CPU or
+ * it has hold in effect from a previous task. The root boost group is
+ * always active.
+ */
+static void schedtune_group_activate(struct boost_groups *bg, int idx)
+{
+	if (!idx)
+		return;
 
-		/* This boost group is active */
-		if (boost_max > bg->group[idx].boost)
-			continue;
+	__clear_bit(idx, &bg->held);
+	if (__test_and_set_bit(idx, &bg->active))
+		return;
 
-		boost_max = bg->group[idx].boost;
-		boost_ts =  bg->group[idx].ts;
+	schedtune_boost_get(bg, bg->group[idx].boost);
+	schedtune_boost_max_update(bg);
+}
+
+static void schedtune_group_deactivate(struct boost_groups *bg, int idx)
+{
+	if (!idx)
+		return;
+
+	__clear_bit(idx, &bg->held);
+	if (!__test_and_clear_bit(idx, &bg->active))
+		return;
+
+	schedtune_boost_put(bg, bg->group[idx].boost);
+	schedtune_boost_max_update(bg);
+}
+
+/* The last RUNNABLE task of a boost group has left the CPU */
+static void schedtune_group_hold(struct boost_groups *bg, int idx, u64 now)
+{
+	u64 ts = bg->group[idx].ts;
+
+	if (!idx)
+		return;
+
+	if (schedtune_boost_timeout(now, ts)) {
+		schedtune_group_deactivate(bg, idx);
+		return;
 	}
 
-	/* Ensures boost_max is non-negative when all cgroup boost values
-	 * are neagtive. Avoids under-accounting of cpu capacity which may cause
-	 * task stacking and frequency spikes.*/
-	boost_max = max(boost_max, 0);
-	bg->boost_max = boost_max;
-	bg->boost_ts = boost_ts;
+	if (!bg->held || (s64)(ts - bg->boost_ts) < 0)
+		WRITE_ONCE(bg->boost_ts, ts);
+	WRITE_ONCE(bg->held, bg->held | BIT(idx));
+}
+
+/* Deactivate the held boost groups whose hold has expired */
+static void schedtune_hold_expire(struct boost_groups *bg, u64 now)
+{
+	unsigned long held = bg->held;
+	u64 oldest = now;
+	int idx;
+
+	for_each_set_bit(idx, &held, BOOSTGROUPS_COUNT) {
+		u64 ts = bg->group[idx].ts;
+
+		if (schedtune_boost_timeout(now, ts))
+			schedtune_group_deactivate(bg, idx);
+		else if ((s64)(ts - oldest) < 0)
+			oldest = ts;
+	}
+
+	WRITE_ONCE(bg->boost_ts, oldest);
 }
 
 static int
 schedtune_boostgroup_update(int idx, int boost)
 {
 	struct boost_groups *bg;
+	unsigned long irq_flags;
 	int cur_boost_max;
 	int old_boost;
 	int cpu;
-	u64 now;
 
 	/* Update per CPU boost groups */
 	for_each_possible_cpu(cpu) {
@@ -340,36 +400,27 @@ schedtune_boostgroup_update(int idx, int boost)
 		/* CGroups are never associated to non active cgroups */
 		BUG_ON(!bg->group[idx].valid);
 
-		/*
-		 * Keep track of current boost values to compute the per CPU
-		 * maximum only when it has been affected by the new value of
-		 * the updated boost group
-		 */
+		raw_spin_lock_irqsave(&bg->lock, irq_flags);
+
 		cur_boost_max = bg->boost_max;
 		old_boost = bg->group[idx].boost;
 
 		/* Update the boost value of this boost group */
 		bg->group[idx].boost = boost;
 
-		/* Check if this update increase current max */
-		now = sched_clock_cpu(cpu);
-		if (boost > cur_boost_max &&
-			schedtune_boost_group_active(idx, bg, now)) {
-			bg->boost_max = boost;
-			bg->boost_ts = bg->group[idx].ts;
-
-			trace_sched_tune_boostgroup_update(cpu, 1, bg->boost_max);
-			continue;
+		/* Move the reference of an active boost group to its new value */
+		if (idx == 0 || test_bit(idx, &bg->active)) {
+			schedtune_boost_put(bg, old_boost);
+			schedtune_boost_get(bg, boost);
+			schedtune_boost_max_update(bg);
 		}
 
-		/* Check if this update has decreased current max */
-		if (cur_boost_max == old_boost && old_boost > boost) {
-			schedtune_cpu_update(cpu, now);
-			trace_sched_tune_boostgroup_update(cpu, -1, bg->boost_max);
-			continue;
-		}
+		raw_spin_unlock_irqrestore(&bg->lock, irq_flags);
 
-		trace_sched_tune_boostgroup_update(cpu, 0, bg->boost_max);
+		trace_sched_tune_boostgroup_update(cpu,
+				(bg->boost_max > cur_boost_max) -
+				(bg->boost_max < cur_boost_max),
+				bg->boost_max);
 	}
 
 	return 0;
@@ -387,10 +438,10 @@ schedtune_update_timestamp(struct task_struct *p)
 	return task_has_rt_policy(p);
 }
 
-static inline void
-schedtune_tasks_update(struct task_struct *p, int cpu, int idx, int task_count)
+static inline int
+__schedtune_tasks_update(struct boost_groups *bg, int idx, int task_count,
+			 u64 now, bool update_ts)
 {
-	struct boost_groups *bg = &per_cpu(cpu_boost_groups, cpu);
 	int tasks = bg->group[idx].tasks + task_count;
 
 	/* Update boosted tasks count while avoiding to make it negative */
@@ -398,16 +449,30 @@ schedtune_tasks_update(struct task_struct *p, int cpu, int idx, int task_count)
 
 	/* Update timeout on enqueue */
 	if (task_count > 0) {
-		u64 now = sched_clock_cpu(cpu);
-
-		if (schedtune_update_timestamp(p))
+		if (update_ts)
 			bg->group[idx].ts = now;
 
-		/* Boost group activation or deactivation on that RQ */
+		/* Boost group activation on that RQ */
 		if (bg->group[idx].tasks == 1)
-			schedtune_cpu_update(cpu, now);
+			schedtune_group_activate(bg, idx);
+	} else if (tasks == 0) {
+		/* Boost group deactivation, possibly after its hold */
+		schedtune_group_hold(bg, idx, now);
 	}
 
+	return tasks;
+}
+
+static inline void
+schedtune_tasks_update(struct task_struct *p, int cpu, int idx, int task_count)
+{
+	struct boost_groups *bg = &per_cpu(cpu_boost_groups, cpu);
+	int tasks;
+
+	tasks = __schedtune_tasks_update(bg, idx, task_count,
+					 sched_clock_cpu(cpu),
+					 schedtune_update_timestamp(p));
+
 	trace_sched_tune_tasks_update(p, cpu, tasks, idx,
 			bg->group[idx].boost, bg->boost_max,
 			bg->group[idx].ts);
@@ -453,7 +518,6 @@ int schedtune_can_attach(struct cgroup_taskset *tset)
 	struct rq *rq;
 	int src_bg; /* Source boost group index */
 	int dst_bg; /* Destination boost group index */
-	int tasks;
 	u64 now;
 
 	if (unlikely(!schedtune_initialized))
@@ -501,16 +565,11 @@ int schedtune_can_attach(struct cgroup_taskset *tset)
 		 */
 
 		/* Move task from src to dst boost group */
-		tasks = bg->group[src_bg].tasks - 1;
-		bg->group[src_bg].tasks = max(0, tasks);
-		bg->group[dst_bg].tasks += 1;
-
-		/* Update boost hold start for this group */
 		now = sched_clock_cpu(cpu);
-		bg->group[dst_bg].ts = now;
+		__schedtune_tasks_update(bg, src_bg, DEQUEUE_TASK, now, false);
 
-		/* Force boost group re-evaluation at next boost check */
-		bg->boost_ts = now - SCHEDTUNE_BOOST_HOLD_NS;
+		/* Update boost hold start for this group */
+		__schedtune_tasks_update(bg, dst_bg, ENQUEUE_TASK, now, true);
 
 		raw_spin_unlock(&bg->lock);
 		task_rq_unlock(rq, task, &rq_flags);
@@ -605,16 +664,22 @@ void schedtune_dequeue_task(struct task_struct *p, int cpu)
 int schedtune_cpu_boost(int cpu)
 {
 	struct boost_groups *bg;
+	unsigned long irq_flags;
 	u64 now;
 
 	bg = &per_cpu(cpu_boost_groups, cpu);
-	now = sched_clock_cpu(cpu);
 
-	/* Check to see if we have a hold in effect */
-	if (schedtune_boost_timeout(now, bg->boost_ts))
-		schedtune_cpu_update(cpu, now);
+	/* Check to see if a hold in effect has expired */
+	if (READ_ONCE(bg->held)) {
+		now = sched_clock_cpu(cpu);
+		if (schedtune_boost_timeout(now, READ_ONCE(bg->boost_ts))) {
+			raw_spin_lock_irqsave(&bg->lock, irq_flags);
+			schedtune_hold_expire(bg, now);
+			raw_spin_unlock_irqrestore(&bg->lock, irq_flags);
+		}
+	}
 
-	return bg->boost_max;
+	return READ_ONCE(bg->boost_max);
 }
 
 int schedtune_task_boost(struct task_struct *p)
@@ -804,13 +869,17 @@ static void
 schedtune_boostgroup_release(struct schedtune *st)
 {
 	struct boost_groups *bg;
+	unsigned long irq_flags;
 	int cpu;
 
 	/* Reset per CPUs boost group support */
 	for_each_possible_cpu(cpu) {
 		bg = &per_cpu(cpu_boost_groups, cpu);
+		raw_spin_lock_irqsave(&bg->lock, irq_flags);
+		schedtune_group_deactivate(bg, st->idx);
 		bg->group[st->idx].valid = false;
 		bg->group[st->idx].boost = 0;
+		raw_spin_unlock_irqrestore(&bg->lock, irq_flags);
 	}
 
 	/* Keep track of allocated boost groups */
@@ -848,6 +917,8 @@ schedtune_init_cgroups(void)
 		bg = &per_cpu(cpu_boost_groups, cpu);
 		memset(bg, 0, sizeof(struct boost_groups));
 		bg->group[0].valid = true;
+		bg->active = BIT(0);
+		schedtune_boost_get(bg, bg->group[0].boost);
 		raw_spin_lock_init(&bg->lock);
 	}
 
@@ -868,3 +939,173 @@ schedtune_init(void)
 	return 0;
 }
 postcore_initcall(schedtune_init);
+
+#ifdef CONFIG_SCHED_TUNE_TEST
+/*
+ * Replay a random sequence of enqueues and dequeues of tasks of mixed boost
+ * groups on a private set of boost groups, with a fake clock so that some
+ * holds expire. Check boost_max against a scan of the boost groups and
+ * compare the cost of an update with the former scan based aggregation.
+ */
+#define STUNE_TEST_UPDATES	100000
+#define STUNE_TEST_MAX_TASKS	16
+
+struct stune_test_ref {
+	int boost_max;
+	u64 boost_ts;
+	unsigned int tasks[BOOSTGROUPS_COUNT];
+	u64 ts[BOOSTGROUPS_COUNT];
+};
+
+static bool __init stune_test_active(struct boost_groups *bg, int idx, u64 now)
+{
+	if (!idx)
+		return true;
+	if (!bg->group[idx].valid)
+		return false;
+
+	return bg->group[idx].tasks ||
+	       !schedtune_boost_timeout(now, bg->group[idx].ts);
+}
+
+static int __init stune_test_max(struct boost_groups *bg, u64 now)
+{
+	int idx, boost_max = 0;
+
+	for (idx = 0; idx < BOOSTGROUPS_COUNT; idx++)
+		if (stune_test_active(bg, idx, now))
+			boost_max = max(boost_max, bg->group[idx].boost);
+
+	return boost_max;
+}
+
+/* The aggregation of schedtune_cpu_update() before boost_map */
+static void __init stune_test_ref_update(struct stune_test_ref *ref,
+					 struct boost_groups *bg, u64 now)
+{
+	int idx, boost_max = bg->group[0].boost;
+	u64 boost_ts = now;
+
+	for (idx = 1; idx < BOOSTGROUPS_COUNT; ++idx) {
+		if (!bg->group[idx].valid)
+			continue;
+		if (!ref->tasks[idx] &&
+		    schedtune_boost_timeout(now, ref->ts[idx]))
+			continue;
+		if (boost_max > bg->group[idx].boost)
+			continue;
+
+		boost_max = bg->group[idx].boost;
+		boost_ts = ref->ts[idx];
+	}
+
+	ref->boost_max = max(boost_max, 0);
+	ref->boost_ts = boost_ts;
+}
+
+static void __init stune_test_init(struct boost_groups *bg, int *boost)
+{
+	int idx;
+
+	memset(bg, 0, sizeof(*bg));
+	for (idx = 0; idx < BOOSTGROUPS_COUNT; idx++) {
+		bg->group[idx].valid = true;
+		bg->group[idx].boost = boost[idx];
+	}
+	bg->active = BIT(0);
+	schedtune_boost_get(bg, boost[0]);
+	schedtune_boost_max_update(bg);
+}
+
+static void __init stune_test_op(struct rnd_state *rnd, u64 *now, int *idx,
+				 int *count, bool *update_ts,
+				 unsigned int *tasks)
+{
+	*now += prandom_u32_state(rnd) % (SCHEDTUNE_BOOST_HOLD_NS / 64);
+	*idx = prandom_u32_state(rnd) % BOOSTGROUPS_COUNT;
+	*update_ts = prandom_u32_state(rnd) & 1;
+
+	if (!tasks[*idx])
+		*count = ENQUEUE_TASK;
+	else if (tasks[*idx] == STUNE_TEST_MAX_TASKS)
+		*count = DEQUEUE_TASK;
+	else
+		*count = prandom_u32_state(rnd) & 1 ? ENQUEUE_TASK : DEQUEUE_TASK;
+
+	tasks[*idx] += *count;
+}
+
+static int __init schedtune_test(void)
+{
+	static struct boost_groups bg __initdata;
+	static struct stune_test_ref ref __initdata;
+	unsigned int tasks[BOOSTGROUPS_COUNT];
+	int boost[BOOSTGROUPS_COUNT] = { 0 };
+	struct rnd_state rnd, seq;
+	int i, idx, count, failed = 0;
+	u64 now, t0, ref_ns, new_ns;
+	bool update_ts;
+
+	for (idx = 1; idx < BOOSTGROUPS_COUNT; idx++)
+		boost[idx] = prandom_u32() % SCHEDTUNE_BOOST_VALUES;
+	stune_test_init(&bg, boost);
+
+	/* The same sequence of updates is replayed for the timings */
+	prandom_seed_state(&rnd, prandom_u32());
+
+	/* Start past the hold of the null timestamps */
+	seq = rnd;
+	now = 2 * SCHEDTUNE_BOOST_HOLD_NS;
+	memset(tasks, 0, sizeof(tasks));
+	for (i = 0; i < STUNE_TEST_UPDATES; i++) {
+		stune_test_op(&seq, &now, &idx, &count, &update_ts, tasks);
+		__schedtune_tasks_update(&bg, idx, count, now, update_ts);
+		if (bg.held && schedtune_boost_timeout(now, bg.boost_ts))
+			schedtune_hold_expire(&bg, now);
+
+		if (bg.boost_max != stune_test_max(&bg, now) && !failed++)
+			pr_err("schedtune_test: update %d boost_max %d expected %d\n",
+			       i, bg.boost_max, stune_test_max(&bg, now));
+	}
+
+	/* Each update is followed by a read of the CPU boost */
+	stune_test_init(&bg, boost);
+	seq = rnd;
+	now = 2 * SCHEDTUNE_BOOST_HOLD_NS;
+	memset(tasks, 0, sizeof(tasks));
+	t0 = sched_clock();
+	for (i = 0; i < STUNE_TEST_UPDATES; i++) {
+		stune_test_op(&seq, &now, &idx, &count, &update_ts, tasks);
+		ref.tasks[idx] = tasks[idx];
+		if (count > 0) {
+			if (update_ts)
+				ref.ts[idx] = now;
+			if (ref.tasks[idx] == 1)
+				stune_test_ref_update(&ref, &bg, now);
+		}
+		if (schedtune_boost_timeout(now, ref.boost_ts))
+			stune_test_ref_update(&ref, &bg, now);
+	}
+	ref_ns = sched_clock() - t0;
+
+	stune_test_init(&bg, boost);
+	seq = rnd;
+	now = 2 * SCHEDTUNE_BOOST_HOLD_NS;
+	memset(tasks, 0, sizeof(tasks));
+	t0 = sched_clock();
+	for (i = 0; i < STUNE_TEST_UPDATES; i++) {
+		stune_test_op(&seq, &now, &idx, &count, &update_ts, tasks);
+		__schedtune_tasks_update(&bg, idx, count, now, update_ts);
+		if (bg.held && schedtune_boost_timeout(now, bg.boost_ts))
+			schedtune_hold_expire(&bg, now);
+	}
+	new_ns = sched_clock() - t0;
+
+	pr_info("schedtune_test: %d mismatches in %d updates, per update: %llu ns (was %llu ns)\n",
+		failed, STUNE_TEST_UPDATES, div_u64(new_ns, STUNE_TEST_UPDATES),
+		div_u64(ref_ns, STUNE_TEST_UPDATES));
+
+	return WARN_ON(failed) ? -EINVAL : 0;
+}
+late_initcall(schedtune_test);
+#endif /* CONFIG_SCHED_TUNE_TEST */
@@ -4,10 +4,16 @@
  */
 
 #include <linux/syscore_ops.h>
+#include <linux/cacheinfo.h>
 #include <linux/cpufreq.h>
+#include <linux/debugfs.h>
 #include <linux/list_sort.h>
 #include <linux/jiffies.h>
+#include <linux/perf_event.h>
 #include <linux/sched/stat.h>
+#include <linux/seq_file.h>
+#include <linux/random.h>
+#include <asm/unaligned.h>
 #include <trace/events/sched.h>
 #include "sched.h"
 #include "walt.h"
@@ -186,6 +192,31 @@ __read_mostly unsigned int sched_load_granule =
 static const unsigned int top_tasks_bitmap_size =
 		BITS_TO_LONGS(NUM_LOAD_INDICES + 1) * sizeof(unsigned long);
 
+/*
+ * Load index i of a top task table is tracked by bit
+ * NUM_LOAD_INDICES - i - 1 of the window's bitmap, so the top index is the
+ * first set bit. Each word of the bitmap is in turn tracked by one bit of
+ * the window's summary word, which finds the first non empty word without
+ * scanning the bitmap. Bit NUM_LOAD_INDICES is always set and stands for
+ * an empty table.
+ */
+static inline void top_tasks_set_bit(struct rq *rq, int table, int index)
+{
+	int bit = NUM_LOAD_INDICES - index - 1;
+
+	__set_bit(bit, rq->top_tasks_bitmap[table]);
+	__set_bit(BIT_WORD(bit), &rq->top_tasks_summary[table]);
+}
+
+static inline void top_tasks_clear_bit(struct rq *rq, int table, int index)
+{
+	int bit = NUM_LOAD_INDICES - index - 1;
+
+	__clear_bit(bit, rq->top_tasks_bitmap[table]);
+	if (!rq->top_tasks_bitmap[table][BIT_WORD(bit)])
+		__clear_bit(BIT_WORD(bit), &rq->top_tasks_summary[table]);
+}
+
 /*
  * This governs what load needs to be used when reporting CPU busy time
  * to the cpufreq governor.
@@ -519,10 +550,28 @@ unsigned int sysctl_sched_user_hint;
 static unsigned long sched_user_hint_reset_time;
 static bool is_cluster_hosting_top_app(struct sched_cluster *cluster);
 
+/*
+ * aggr_grp_load is republished by the window rollover and the migration
+ * irq work without holding the rq locks of the cluster, so it is read
+ * through the cluster's seqcount.
+ */
+static inline u64 cluster_aggr_grp_load(struct sched_cluster *cluster)
+{
+	unsigned int seq;
+	u64 load;
+
+	do {
+		seq = read_seqcount_begin(&cluster->aggr_seq);
+		load = cluster->aggr_grp_load;
+	} while (read_seqcount_retry(&cluster->aggr_seq, seq));
+
+	return load;
+}
+
 static inline bool should_apply_suh_freq_boost(struct sched_cluster *cluster)
 {
 	if (sched_freq_aggr_en || !sysctl_sched_user_hint ||
-				  !cluster->aggr_grp_load)
+				  !cluster_aggr_grp_load(cluster))
 		return false;
 
 	return is_cluster_hosting_top_app(cluster);
@@ -532,7 +581,7 @@ static inline u64 freq_policy_load(struct rq *rq)
 {
 	unsigned int reporting_policy = sysctl_sched_freq_reporting_policy;
 	struct sched_cluster *cluster = rq->cluster;
-	u64 aggr_grp_load = cluster->aggr_grp_load;
+	u64 aggr_grp_load = cluster_aggr_grp_load(cluster);
 	u64 load, tt_load = 0;
 	struct task_struct *cpu_ksoftirqd = per_cpu(ksoftirqd, cpu_of(rq));
 
@@ -691,14 +740,17 @@ static inline void create_subtraction_entry(struct rq *rq, u64 ws, int index)
 	rq->load_subs[index].new_subs = 0;
 }
 
-static int get_top_index(unsigned long *bitmap, unsigned long old_top)
+static int get_top_index(struct rq *rq, int table)
 {
-	int index = find_next_bit(bitmap, NUM_LOAD_INDICES, old_top);
+	unsigned long *bitmap = rq->top_tasks_bitmap[table];
+	int word, bit;
 
-	if (index == NUM_LOAD_INDICES)
+	word = __ffs(rq->top_tasks_summary[table]);
+	bit = word * BITS_PER_LONG + __ffs(bitmap[word]);
+	if (bit >= NUM_LOAD_INDICES)
 		return 0;
 
-	return NUM_LOAD_INDICES - 1 - index;
+	return NUM_LOAD_INDICES - 1 - bit;
 }
 
 static bool get_subtraction_index(struct rq *rq, u64 ws)
@@ -861,20 +913,17 @@ migrate_top_tasks(struct task_struct *p, struct rq *src_rq, struct rq *dst_rq)
 		dst_table[index] += 1;
 
 		if (!src_table[index])
-			__clear_bit(NUM_LOAD_INDICES - index - 1,
-				src_rq->top_tasks_bitmap[src]);
+			top_tasks_clear_bit(src_rq, src, index);
 
 		if (dst_table[index] == 1)
-			__set_bit(NUM_LOAD_INDICES - index - 1,
-				dst_rq->top_tasks_bitmap[dst]);
+			top_tasks_set_bit(dst_rq, dst, index);
 
 		if (index > dst_rq->curr_top)
 			dst_rq->curr_top = index;
 
 		top_index = src_rq->curr_top;
 		if (index == top_index && !src_table[index])
-			src_rq->curr_top = get_top_index(
-				src_rq->top_tasks_bitmap[src], top_index);
+			src_rq->curr_top = get_top_index(src_rq, src);
 	}
 
 	if (prev_window) {
@@ -887,20 +936,17 @@ migrate_top_tasks(struct task_struct *p, struct rq *src_rq, struct rq *dst_rq)
 		dst_table[index] += 1;
 
 		if (!src_table[index])
-			__clear_bit(NUM_LOAD_INDICES - index - 1,
-				src_rq->top_tasks_bitmap[src]);
+			top_tasks_clear_bit(src_rq, src, index);
 
 		if (dst_table[index] == 1)
-			__set_bit(NUM_LOAD_INDICES - index - 1,
-				dst_rq->top_tasks_bitmap[dst]);
+			top_tasks_set_bit(dst_rq, dst, index);
 
 		if (index > dst_rq->prev_top)
 			dst_rq->prev_top = index;
 
 		top_index = src_rq->prev_top;
 		if (index == top_index && !src_table[index])
-			src_rq->prev_top = get_top_index(
-				src_rq->top_tasks_bitmap[src], top_index);
+			src_rq->prev_top = get_top_index(src_rq, src);
 	}
 }
 
@@ -1046,14 +1092,12 @@ migrate_prepare_top_tasks(struct task_struct *p, struct rq *src_rq)
 		src_table[index] -= 1;
 
 		if (!src_table[index])
-			__clear_bit(NUM_LOAD_INDICES - index - 1,
-				src_rq->top_tasks_bitmap[src]);
+			top_tasks_clear_bit(src_rq, src, index);
 
 
 		top_index = src_rq->curr_top;
 		if (index == top_index && !src_table[index])
-			src_rq->curr_top = get_top_index(
-				src_rq->top_tasks_bitmap[src], top_index);
+			src_rq->curr_top = get_top_index(src_rq, src);
 	}
 
 	if (prev_window) {
@@ -1063,13 +1107,11 @@ migrate_prepare_top_tasks(struct task_struct *p, struct rq *src_rq)
 		src_table[index] -= 1;
 
 		if (!src_table[index])
-			__clear_bit(NUM_LOAD_INDICES - index - 1,
-				src_rq->top_tasks_bitmap[src]);
+			top_tasks_clear_bit(src_rq, src, index);
 
 		top_index = src_rq->prev_top;
 		if (index == top_index && !src_table[index])
-			src_rq->prev_top = get_top_index(
-				src_rq->top_tasks_bitmap[src], top_index);
+			src_rq->prev_top = get_top_index(src_rq, src);
 	}
 }
 
@@ -1088,8 +1130,7 @@ migrate_finish_top_tasks(struct task_struct *p, struct rq *dst_rq)
 		dst_table[index] += 1;
 
 		if (dst_table[index] == 1)
-			__set_bit(NUM_LOAD_INDICES - index - 1,
-				dst_rq->top_tasks_bitmap[dst]);
+			top_tasks_set_bit(dst_rq, dst, index);
 
 		if (index > dst_rq->curr_top)
 			dst_rq->curr_top = index;
@@ -1102,8 +1143,7 @@ migrate_finish_top_tasks(struct task_struct *p, struct rq *dst_rq)
 		dst_table[index] += 1;
 
 		if (dst_table[index] == 1)
-			__set_bit(NUM_LOAD_INDICES - index - 1,
-				dst_rq->top_tasks_bitmap[dst]);
+			top_tasks_set_bit(dst_rq, dst, index);
 
 		if (index > dst_rq->prev_top)
 			dst_rq->prev_top = index;
@@ -1318,6 +1358,9 @@ void walt_finish_migrate(struct task_struct *p,
 	if (grp) {
 		struct group_cpu_time *cpu_time;
 
+		atomic_inc(&grp->nr_migrations);
+		cpumask_set_cpu(new_cpu, &grp->spread_cpus);
+
 		cpu_time = &dest_rq->grp_time;
 		dst_curr_runnable_sum = &cpu_time->curr_runnable_sum;
 		dst_prev_runnable_sum = &cpu_time->prev_runnable_sum;
@@ -1422,6 +1465,49 @@ unsigned int sysctl_sched_many_wakeup_threshold = WALT_MANY_WAKEUP_DEFAULT;
 #define DEC_STEP 2
 #define CONSISTENT_THRES 16
 #define INC_STEP_BIG 16
+
+#ifdef CONFIG_64BIT
+/*
+ * The busy buckets are processed eight at a time as bytes of a u64 so that
+ * the decay and the search for a busy bucket run without a branch per
+ * bucket. Bucket i lives in byte i of the little endian word i / 8; the
+ * padding bytes past NUM_BUSY_BUCKETS are always zero.
+ */
+#define BUSY_BUCKET_WORDS	DIV_ROUND_UP(NUM_BUSY_BUCKETS, 8)
+#define BYTES(x)		(0x0101010101010101ULL * (u8)(x))
+
+static inline void busy_buckets_load(const u8 *buckets,
+				     u64 w[BUSY_BUCKET_WORDS])
+{
+	u8 tmp[BUSY_BUCKET_WORDS * 8] = { 0 };
+	int i;
+
+	memcpy(tmp, buckets, NUM_BUSY_BUCKETS);
+	for (i = 0; i < BUSY_BUCKET_WORDS; i++)
+		w[i] = get_unaligned_le64(tmp + i * 8);
+}
+
+/* 0x80 in every non-zero byte of @x */
+static inline u64 bytes_nonzero(u64 x)
+{
+	return (((x & BYTES(0x7f)) + BYTES(0x7f)) | x) & BYTES(0x80);
+}
+
+/* Per byte max(x - DEC_STEP, 0) */
+static inline u64 bytes_decay(u64 x)
+{
+	u64 r, ge;
+
+	BUILD_BUG_ON(DEC_STEP > 0x7f);
+
+	/* bit 7 is set before the subtraction, no borrow crosses a byte */
+	r = (x | BYTES(0x80)) - BYTES(DEC_STEP);
+	/* bytes where x >= DEC_STEP */
+	ge = (x | r) & BYTES(0x80);
+
+	return (r ^ (~x & BYTES(0x80))) & ((ge >> 7) * 0xff);
+}
+
 /*
  * bucket_increase - update the count of all buckets
  *
@@ -1434,6 +1520,40 @@ unsigned int sysctl_sched_many_wakeup_threshold = WALT_MANY_WAKEUP_DEFAULT;
  * on current count in the bucket.
  */
 static inline void bucket_increase(u8 *buckets, int idx)
+{
+	u8 tmp[BUSY_BUCKET_WORDS * 8];
+	u64 w[BUSY_BUCKET_WORDS];
+	u32 old = buckets[idx];
+	int i, step;
+
+	busy_buckets_load(buckets, w);
+	for (i = 0; i < BUSY_BUCKET_WORDS; i++)
+		put_unaligned_le64(bytes_decay(w[i]), tmp + i * 8);
+	memcpy(buckets, tmp, NUM_BUSY_BUCKETS);
+
+	step = old >= CONSISTENT_THRES ? INC_STEP_BIG : INC_STEP;
+	buckets[idx] = min_t(u32, old + step, U8_MAX);
+}
+
+/* Index of the first non-empty bucket at or above @start */
+static inline int first_busy_bucket(const u8 *buckets, int start)
+{
+	u64 w[BUSY_BUCKET_WORDS], m;
+	int i, skip;
+
+	busy_buckets_load(buckets, w);
+	for (i = 0; i < BUSY_BUCKET_WORDS; i++) {
+		skip = clamp(start - i * 8, 0, 8) * 8;
+		m = bytes_nonzero(w[i]);
+		m &= skip < 64 ? ~0ULL << skip : 0;
+		if (m)
+			return i * 8 + __ffs64(m) / 8;
+	}
+
+	return NUM_BUSY_BUCKETS;
+}
+#else
+static inline void bucket_increase(u8 *buckets, int idx)
 {
 	int i, step;
 
@@ -1454,6 +1574,19 @@ static inline void bucket_increase(u8 *buckets, int idx)
 	}
 }
 
+static inline int first_busy_bucket(const u8 *buckets, int start)
+{
+	int i;
+
+	for (i = start; i < NUM_BUSY_BUCKETS; i++) {
+		if (buckets[i])
+			return i;
+	}
+
+	return NUM_BUSY_BUCKETS;
+}
+#endif
+
 static inline int busy_to_bucket(u32 normalized_rt)
 {
 	int bidx;
@@ -1472,6 +1605,66 @@ static inline int busy_to_bucket(u32 normalized_rt)
 	return bidx;
 }
 
+/*
+ * Return the most recent of the first @size entries of @hist that falls
+ * into [@dmin, @dmax), @fallback if there is none. All entries are
+ * compared, the first match is then picked from the resulting mask.
+ */
+static inline u32 first_hist_in_range(const u32 *hist, int size,
+				      u32 dmin, u32 dmax, u32 fallback)
+{
+	unsigned int mask = 0;
+	int i;
+
+	BUILD_BUG_ON(RAVG_HIST_SIZE_MAX > BITS_PER_BYTE * sizeof(mask));
+
+	for (i = 0; i < size; i++)
+		mask |= (hist[i] - dmin < dmax - dmin) << i;
+
+	return mask ? hist[__ffs(mask)] : fallback;
+}
+
+/*
+ * __get_pred_busy - the prediction of get_pred_busy() on bare arrays.
+ * @max_load is the busy time of a full window, i.e. max_task_load().
+ */
+static u32 __get_pred_busy(const u8 *buckets, const u32 *hist, int hist_size,
+			   int start, u32 runtime, u32 max_load)
+{
+	u32 dmin, dmax, ret;
+	int first, final;
+
+	/* find minimal bucket index to pick */
+	first = first_busy_bucket(buckets, start);
+
+	/* if no higher buckets are filled, predict runtime */
+	if (first >= NUM_BUSY_BUCKETS)
+		return runtime;
+
+	/*
+	 * determine demand range for the predicted bucket, the lowest two
+	 * buckets are combined
+	 */
+	final = max(first, 1);
+	dmin = first < 2 ? 0 : mult_frac(final, max_load, NUM_BUSY_BUCKETS);
+	dmax = mult_frac(final + 1, max_load, NUM_BUSY_BUCKETS);
+
+	/*
+	 * search through runtime history and return first runtime that falls
+	 * into the range of predicted bucket.
+	 */
+	ret = first_hist_in_range(hist, hist_size, dmin, dmax, runtime);
+
+	/* no historical runtime within bucket found, use average of the bin */
+	if (ret < dmin)
+		ret = (dmin + dmax) / 2;
+	/*
+	 * when updating in middle of a window, runtime could be higher
+	 * than all recorded history. Always predict at least runtime.
+	 */
+	return max(runtime, ret);
+}
+
 /*
  * get_pred_busy - calculate predicted demand for a task on runqueue
  *
@@ -1493,61 +1686,15 @@ static inline int busy_to_bucket(u32 normalized_rt)
 static u32 get_pred_busy(struct task_struct *p,
 				int start, u32 runtime)
 {
-	int i;
-	u8 *buckets = p->ravg.busy_buckets;
-	u32 *hist = p->ravg.sum_history;
-	u32 dmin, dmax;
 	u64 cur_freq_runtime = 0;
-	int first = NUM_BUSY_BUCKETS, final;
 	u32 ret = runtime;
 
 	/* skip prediction for new tasks due to lack of history */
-	if (unlikely(is_new_task(p)))
-		goto out;
-
-	/* find minimal bucket index to pick */
-	for (i = start; i < NUM_BUSY_BUCKETS; i++) {
-		if (buckets[i]) {
-			first = i;
-			break;
-		}
-	}
-	/* if no higher buckets are filled, predict runtime */
-	if (first >= NUM_BUSY_BUCKETS)
-		goto out;
+	if (likely(!is_new_task(p)))
+		ret = __get_pred_busy(p->ravg.busy_buckets,
+				      p->ravg.sum_history, sched_ravg_hist_size,
+				      start, runtime, max_task_load());
 
-	/* compute the bucket for prediction */
-	final = first;
-
-	/* determine demand range for the predicted bucket */
-	if (final < 2) {
-		/* lowest two buckets are combined */
-		dmin = 0;
-		final = 1;
-	} else {
-		dmin = mult_frac(final, max_task_load(), NUM_BUSY_BUCKETS);
-	}
-	dmax = mult_frac(final + 1, max_task_load(), NUM_BUSY_BUCKETS);
-
-	/*
-	 * search through runtime history and return first runtime that falls
-	 * into the range of predicted bucket.
-	 */
-	for (i = 0; i < sched_ravg_hist_size; i++) {
-		if (hist[i] >= dmin && hist[i] < dmax) {
-			ret = hist[i];
-			break;
-		}
-	}
-	/* no historical runtime within bucket found, use average of the bin */
-	if (ret < dmin)
-		ret = (dmin + dmax) / 2;
-	/*
-	 * when updating in middle of a window, runtime could be higher
-	 * than all recorded history. Always predict at least runtime.
-	 */
-	ret = max(runtime, ret);
-out:
 	trace_sched_update_pred_demand(p, runtime,
 		mult_frac((unsigned int)cur_freq_runtime, 100,
 			  sched_ravg_window), ret);
@@ -1612,10 +1759,14 @@ void update_task_pred_demand(struct rq *rq, struct task_struct *p, int event)
 	p->ravg.pred_demand_scaled = new_scaled;
 }
 
-void clear_top_tasks_bitmap(unsigned long *bitmap)
+void clear_top_tasks_bitmap(struct rq *rq, int table)
 {
-	memset(bitmap, 0, top_tasks_bitmap_size);
-	__set_bit(NUM_LOAD_INDICES, bitmap);
+	/* One summary word covers the whole bitmap */
+	BUILD_BUG_ON(BITS_TO_LONGS(NUM_LOAD_INDICES + 1) > BITS_PER_LONG);
+
+	memset(rq->top_tasks_bitmap[table], 0, top_tasks_bitmap_size);
+	__set_bit(NUM_LOAD_INDICES, rq->top_tasks_bitmap[table]);
+	rq->top_tasks_summary[table] = BIT(BIT_WORD(NUM_LOAD_INDICES));
 }
 
 static void update_top_tasks(struct task_struct *p, struct rq *rq,
@@ -1648,12 +1799,10 @@ static void update_top_tasks(struct task_struct *p, struct rq *rq,
 		}
 
 		if (!curr_table[old_index])
-			__clear_bit(NUM_LOAD_INDICES - old_index - 1,
-				rq->top_tasks_bitmap[curr]);
+			top_tasks_clear_bit(rq, curr, old_index);
 
 		if (curr_table[new_index] == 1)
-			__set_bit(NUM_LOAD_INDICES - new_index - 1,
-				rq->top_tasks_bitmap[curr]);
+			top_tasks_set_bit(rq, curr, new_index);
 
 		return;
 	}
@@ -1680,8 +1829,7 @@ static void update_top_tasks(struct task_struct *p, struct rq *rq,
 		}
 
 		if (prev_table[update_index] == 1)
-			__set_bit(NUM_LOAD_INDICES - update_index - 1,
-				rq->top_tasks_bitmap[prev]);
+			top_tasks_set_bit(rq, prev, update_index);
 	} else {
 		zero_index_update = !old_curr_window && prev_window;
 		if (old_index != update_index || zero_index_update) {
@@ -1694,12 +1842,10 @@ static void update_top_tasks(struct task_struct *p, struct rq *rq,
 				rq->prev_top = update_index;
 
 			if (!prev_table[old_index])
-				__clear_bit(NUM_LOAD_INDICES - old_index - 1,
-						rq->top_tasks_bitmap[prev]);
+				top_tasks_clear_bit(rq, prev, old_index);
 
 			if (prev_table[update_index] == 1)
-				__set_bit(NUM_LOAD_INDICES - update_index - 1,
-						rq->top_tasks_bitmap[prev]);
+				top_tasks_set_bit(rq, prev, update_index);
 		}
 	}
 
@@ -1710,8 +1856,7 @@ static void update_top_tasks(struct task_struct *p, struct rq *rq,
 			rq->curr_top = new_index;
 
 		if (curr_table[new_index] == 1)
-			__set_bit(NUM_LOAD_INDICES - new_index - 1,
-				rq->top_tasks_bitmap[curr]);
+			top_tasks_set_bit(rq, curr, new_index);
 	}
 }
 
@@ -1722,13 +1867,12 @@ static void rollover_top_tasks(struct rq *rq, bool full_window)
 	int curr_top = rq->curr_top;
 
 	clear_top_tasks_table(rq->top_tasks[prev_table]);
-	clear_top_tasks_bitmap(rq->top_tasks_bitmap[prev_table]);
+	clear_top_tasks_bitmap(rq, prev_table);
 
 	if (full_window) {
 		curr_top = 0;
 		clear_top_tasks_table(rq->top_tasks[curr_table]);
-		clear_top_tasks_bitmap(
-				rq->top_tasks_bitmap[curr_table]);
+		clear_top_tasks_bitmap(rq, curr_table);
 	}
 
 	rq->curr_table = prev_table;
@@ -2197,16 +2341,14 @@ static void update_history(struct rq *rq, struct task_struct *p,
 	for (; ridx >= 0; --widx, --ridx) {
 		hist[widx] = hist[ridx];
 		sum += hist[widx];
-		if (hist[widx] > max)
-			max = hist[widx];
+		max = max(max, hist[widx]);
 	}
 
 	for (widx = 0; widx < samples && widx < sched_ravg_hist_size; widx++) {
 		hist[widx] = runtime;
 		sum += hist[widx];
-		if (hist[widx] > max)
-			max = hist[widx];
 	}
+	max = max(max, runtime);
 
 	p->ravg.sum = 0;
 
@@ -2679,6 +2821,7 @@ void init_clusters(void)
 {
 	init_cluster.cpus = *cpu_possible_mask;
 	raw_spin_lock_init(&init_cluster.load_lock);
+	seqcount_init(&init_cluster.aggr_seq);
 	INIT_LIST_HEAD(&cluster_head);
 	list_add(&init_cluster.list, &cluster_head);
 }
@@ -2721,6 +2864,7 @@ static struct sched_cluster *alloc_new_cluster(const struct cpumask *cpus)
 	cluster->freq_init_done		=	false;
 
 	raw_spin_lock_init(&cluster->load_lock);
+	seqcount_init(&cluster->aggr_seq);
 	cluster->cpus = *cpus;
 	cluster->efficiency = topology_get_cpu_scale(NULL, cpumask_first(cpus));
 
@@ -3134,130 +3278,502 @@ int preferred_cluster(struct sched_cluster *cluster, struct task_struct *p)
 	return rc;
 }
 
-static void _set_preferred_cluster(struct related_thread_group *grp)
-{
-	struct task_struct *p;
-	u64 combined_demand = 0;
-	bool group_boost = false;
-	u64 wallclock;
-	bool prev_skip_min = grp->skip_min;
-
-	if (list_empty(&grp->tasks)) {
-		grp->skip_min = false;
-		goto out;
-	}
+/*
+ * Cache aware packing of related thread groups.
+ *
+ * When enabled, a group whose demand fits a few CPUs of its preferred
+ * cluster is packed on the fewest CPUs that share the smallest cache
+ * holding them all, so that the group tasks share data through that cache
+ * rather than spread over the cluster. Wakeups of group tasks look for a
+ * CPU among the packed ones first.
+ *
+ * Where the PMU allows, cache misses and instructions are sampled on the
+ * ticks of group tasks, counted from the later of the previous tick and
+ * the switch to the task so that other tasks running on the CPU are not
+ * charged to the group. A group whose cache misses per kilo instruction go
+ * up when packed, i.e. whose working set does not fit the shared cache,
+ * is not packed again for a while.
+ */
+unsigned int __read_mostly sysctl_sched_coloc_cache_pack;
+
+/* Share of the capacity of the packed CPUs the group demand may use */
+#define COLOC_PACK_FIT_PCT		80
+/* Packed over unpacked cache misses per kilo instruction, in percent */
+#define COLOC_PACK_MPKI_PCT		125
+/* Windows without packing once packing raised the cache misses */
+#define COLOC_PACK_BACKOFF_WINDOWS	16
+
+#ifdef CONFIG_PERF_EVENTS
+struct coloc_pmu {
+	struct perf_event *misses;
+	struct perf_event *instructions;
+	u64 last_misses;
+	u64 last_instructions;
+};
 
-	if (!hmp_capable()) {
-		grp->skip_min = false;
-		goto out;
-	}
+static DEFINE_PER_CPU(struct coloc_pmu, coloc_pmu);
+static bool coloc_pmu_active;
 
-	wallclock = sched_ktime_clock();
+static struct perf_event *coloc_pmu_create(int cpu, u64 config)
+{
+	struct perf_event_attr attr = {
+		.type		= PERF_TYPE_HARDWARE,
+		.size		= sizeof(struct perf_event_attr),
+		.config		= config,
+		.pinned		= 1,
+	};
+	struct perf_event *event;
 
-	/*
-	 * wakeup of two or more related tasks could race with each other and
-	 * could result in multiple calls to _set_preferred_cluster being issued
-	 * at same time. Avoid overhead in such cases of rechecking preferred
-	 * cluster
-	 */
-	if (wallclock - grp->last_update < sched_ravg_window / 10)
-		return;
+	event = perf_event_create_kernel_counter(&attr, cpu, NULL, NULL, NULL);
+	return IS_ERR(event) ? NULL : event;
+}
 
-	list_for_each_entry(p, &grp->tasks, grp_list) {
-		if (task_boost_policy(p) == SCHED_BOOST_ON_BIG) {
-			group_boost = true;
-			break;
-		}
+/* Counters are only set up on the CPUs online when packing is enabled */
+static void coloc_pmu_enable(void)
+{
+	struct perf_event *misses, *instructions;
+	struct coloc_pmu *pmu;
+	int cpu;
 
-		if (p->ravg.mark_start < wallclock -
-		    (sched_ravg_window * sched_ravg_hist_size))
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		pmu = &per_cpu(coloc_pmu, cpu);
+		if (pmu->misses)
 			continue;
 
-		combined_demand += p->ravg.coloc_demand;
-		if (!trace_sched_set_preferred_cluster_enabled()) {
-			if (combined_demand > sched_group_upmigrate)
-				break;
+		misses = coloc_pmu_create(cpu, PERF_COUNT_HW_CACHE_MISSES);
+		instructions = coloc_pmu_create(cpu,
+						PERF_COUNT_HW_INSTRUCTIONS);
+		if (!misses || !instructions) {
+			if (misses)
+				perf_event_release_kernel(misses);
+			if (instructions)
+				perf_event_release_kernel(instructions);
+			continue;
 		}
-	}
 
-	grp->last_update = wallclock;
-	update_best_cluster(grp, combined_demand, group_boost);
-	trace_sched_set_preferred_cluster(grp, combined_demand);
-out:
-	if (grp->id == DEFAULT_CGROUP_COLOC_ID
-	    && grp->skip_min != prev_skip_min) {
-		if (grp->skip_min)
-			grp->start_ts = sched_clock();
-		sched_update_hyst_times();
+		pmu->last_misses = 0;
+		pmu->last_instructions = 0;
+		pmu->instructions = instructions;
+		/* Pairs with coloc_pmu_sample() when already active */
+		smp_store_release(&pmu->misses, misses);
 	}
+	put_online_cpus();
+
+	WRITE_ONCE(coloc_pmu_active, true);
 }
 
-void set_preferred_cluster(struct related_thread_group *grp)
+static void coloc_pmu_disable(void)
 {
-	raw_spin_lock(&grp->lock);
-	_set_preferred_cluster(grp);
-	raw_spin_unlock(&grp->lock);
+	struct coloc_pmu *pmu;
+	int cpu;
+
+	/* rtg_pack_tick() samples the events under rcu_read_lock() */
+	WRITE_ONCE(coloc_pmu_active, false);
+	synchronize_rcu();
+
+	for_each_possible_cpu(cpu) {
+		pmu = &per_cpu(coloc_pmu, cpu);
+		if (pmu->misses)
+			perf_event_release_kernel(pmu->misses);
+		if (pmu->instructions)
+			perf_event_release_kernel(pmu->instructions);
+		pmu->misses = NULL;
+		pmu->instructions = NULL;
+	}
 }
 
-int update_preferred_cluster(struct related_thread_group *grp,
-		struct task_struct *p, u32 old_load, bool from_tick)
+static bool coloc_pmu_read(struct coloc_pmu *pmu, u64 *nr_misses,
+			   u64 *nr_instructions)
 {
-	u32 new_load = task_load(p);
+	struct perf_event *misses;
 
-	if (!grp)
-		return 0;
-
-	if (unlikely(from_tick && is_suh_max()))
-		return 1;
+	if (!READ_ONCE(coloc_pmu_active))
+		return false;
 
-	/*
-	 * Update if task's load has changed significantly or a complete window
-	 * has passed since we last updated preference
-	 */
-	if (abs(new_load - old_load) > sched_ravg_window / 4 ||
-		sched_ktime_clock() - grp->last_update > sched_ravg_window)
-		return 1;
+	misses = smp_load_acquire(&pmu->misses);
+	if (!misses)
+		return false;
 
-	return 0;
+	return !perf_event_read_local(misses, nr_misses, NULL, NULL) &&
+	       !perf_event_read_local(pmu->instructions, nr_instructions,
+				      NULL, NULL);
 }
 
-#define ADD_TASK	0
-#define REM_TASK	1
-
-static inline struct related_thread_group*
-lookup_related_thread_group(unsigned int group_id)
+/* Restart counting from now, a group task is switched in */
+static void coloc_pmu_reset(int cpu)
 {
-	return related_thread_groups[group_id];
+	struct coloc_pmu *pmu = &per_cpu(coloc_pmu, cpu);
+	u64 nr_misses, nr_instructions;
+
+	if (!coloc_pmu_read(pmu, &nr_misses, &nr_instructions))
+		return;
+
+	pmu->last_misses = nr_misses;
+	pmu->last_instructions = nr_instructions;
 }
 
-int alloc_related_thread_groups(void)
+static void coloc_pmu_sample(struct related_thread_group *grp, int cpu)
 {
-	int i, ret;
-	struct related_thread_group *grp;
-
-	/* groupd_id = 0 is invalid as it's special id to remove group. */
-	for (i = 1; i < MAX_NUM_CGROUP_COLOC_ID; i++) {
-		grp = kzalloc(sizeof(*grp), GFP_NOWAIT);
-		if (!grp) {
-			ret = -ENOMEM;
-			goto err;
-		}
+	struct coloc_pmu *pmu = &per_cpu(coloc_pmu, cpu);
+	u64 nr_misses, nr_instructions;
 
-		grp->id = i;
-		INIT_LIST_HEAD(&grp->tasks);
-		INIT_LIST_HEAD(&grp->list);
-		raw_spin_lock_init(&grp->lock);
+	if (!coloc_pmu_read(pmu, &nr_misses, &nr_instructions))
+		return;
 
-		related_thread_groups[i] = grp;
+	/* The first sample only sets the reference */
+	if (pmu->last_instructions) {
+		atomic64_add(nr_misses - pmu->last_misses, &grp->cache_misses);
+		atomic64_add(nr_instructions - pmu->last_instructions,
+			     &grp->instructions);
 	}
+	pmu->last_misses = nr_misses;
+	pmu->last_instructions = nr_instructions;
+}
+#else
+static inline void coloc_pmu_enable(void) { }
+static inline void coloc_pmu_disable(void) { }
+static inline void coloc_pmu_reset(int cpu) { }
+static inline void
+coloc_pmu_sample(struct related_thread_group *grp, int cpu) { }
+#endif /* CONFIG_PERF_EVENTS */
 
-	return 0;
+int sched_coloc_cache_pack_handler(struct ctl_table *table, int write,
+				   void __user *buffer, size_t *lenp,
+				   loff_t *ppos)
+{
+	static DEFINE_MUTEX(mutex);
+	int ret;
 
-err:
-	for (i = 1; i < MAX_NUM_CGROUP_COLOC_ID; i++) {
-		grp = lookup_related_thread_group(i);
-		if (grp) {
-			kfree(grp);
+	mutex_lock(&mutex);
+	ret = proc_douintvec_minmax(table, write, buffer, lenp, ppos);
+	if (!ret && write) {
+		if (sysctl_sched_coloc_cache_pack)
+			coloc_pmu_enable();
+		else
+			coloc_pmu_disable();
+	}
+	mutex_unlock(&mutex);
+
+	return ret;
+}
+
+/* Called from the tick of @cpu, with a task of @grp running */
+void rtg_pack_tick(struct related_thread_group *grp, int cpu)
+{
+	cpumask_set_cpu(cpu, &grp->spread_cpus);
+	if (sysctl_sched_coloc_cache_pack)
+		coloc_pmu_sample(grp, cpu);
+}
+
+/* Called on @cpu with its rq lock held, when @next is switched in */
+void rtg_pack_switch(struct task_struct *next, int cpu)
+{
+	if (sysctl_sched_coloc_cache_pack &&
+	    task_in_related_thread_group(next))
+		coloc_pmu_reset(cpu);
+}
+
+/*
+ * Fewest CPUs of the preferred cluster, sharing the smallest cache, that
+ * fit @demand. Anchored on a CPU of the cluster a group task last ran on,
+ * to keep what the group has in cache.
+ */
+static void rtg_pack_cpus(struct related_thread_group *grp, u64 demand,
+			  cpumask_t *pack)
+{
+	struct sched_cluster *cluster = sched_cluster[(int)grp->skip_min];
+	unsigned long util = scale_demand(demand);
+	struct cpu_cacheinfo *cci;
+	struct task_struct *p;
+	cpumask_t shared;
+	int cpu = -1, i, nr_cpus, nr_tasks = 0;
+
+	cpumask_clear(pack);
+
+	list_for_each_entry(p, &grp->tasks, grp_list) {
+		nr_tasks++;
+		if (cpu < 0 && cpumask_test_cpu(task_cpu(p), &cluster->cpus) &&
+		    cpu_active(task_cpu(p)) && !cpu_isolated(task_cpu(p)) &&
+		    !cpu_parked(task_cpu(p)))
+			cpu = task_cpu(p);
+	}
+	if (cpu < 0)
+		cpu = cpumask_first_and(&cluster->cpus, cpu_active_mask);
+	if (cpu >= nr_cpu_ids || nr_tasks < 2)
+		return;
+
+	nr_cpus = DIV_ROUND_UP(util * 100,
+			       capacity_orig_of(cpu) * COLOC_PACK_FIT_PCT);
+	nr_cpus = clamp(nr_cpus, 2, nr_tasks);
+	if (nr_cpus >= cpumask_weight(&cluster->cpus))
+		return;
+
+	/* Leaves are sorted by level, the cluster stands for the last one */
+	cci = get_cpu_cacheinfo(cpu);
+	cpumask_copy(&shared, &cluster->cpus);
+	for (i = 0; cci && cci->info_list && i < cci->num_leaves; i++) {
+		struct cacheinfo *leaf = cci->info_list + i;
+
+		if (leaf->type == CACHE_TYPE_INST)
+			continue;
+		if (cpumask_and(&shared, &leaf->shared_cpu_map,
+				&cluster->cpus) &&
+		    cpumask_weight(&shared) >= nr_cpus)
+			break;
+		cpumask_copy(&shared, &cluster->cpus);
+	}
+	cpumask_and(&shared, &shared, cpu_active_mask);
+
+	for_each_cpu_wrap(i, &shared, cpu) {
+		if (cpu_isolated(i) || cpu_parked(i))
+			continue;
+		cpumask_set_cpu(i, pack);
+		if (!--nr_cpus)
+			return;
+	}
+
+	/* Not enough CPUs left in the shared cache */
+	cpumask_clear(pack);
+}
+
+static void rtg_pack_window(struct related_thread_group *grp, u64 wallclock)
+{
+	bool packed = !cpumask_empty(&grp->pack_cpus);
+	u64 misses, instructions;
+	unsigned int mpki;
+
+	if (wallclock - grp->stats_window_start < sched_ravg_window)
+		return;
+	grp->stats_window_start = wallclock;
+
+	grp->last_spread = cpumask_weight(&grp->spread_cpus);
+	cpumask_clear(&grp->spread_cpus);
+	grp->last_migrations = atomic_xchg(&grp->nr_migrations, 0);
+
+	grp->nr_windows++;
+	grp->nr_packed_windows += packed;
+	grp->sum_spread += grp->last_spread;
+	grp->sum_migrations += grp->last_migrations;
+
+	misses = atomic64_xchg(&grp->cache_misses, 0);
+	instructions = atomic64_xchg(&grp->instructions, 0);
+	if (!instructions)
+		return;
+
+	mpki = div64_u64(misses * 1000, instructions);
+	if (!packed) {
+		grp->unpacked_mpki = mpki;
+		return;
+	}
+
+	grp->packed_mpki = mpki;
+	if (grp->unpacked_mpki &&
+	    mpki * 100 > grp->unpacked_mpki * COLOC_PACK_MPKI_PCT) {
+		grp->pack_backoff_until = wallclock +
+			(u64)sched_ravg_window * COLOC_PACK_BACKOFF_WINDOWS;
+		grp->nr_backoffs++;
+	}
+}
+
+static void rtg_update_pack(struct related_thread_group *grp, u64 demand,
+			    bool boost, u64 wallclock)
+{
+	cpumask_t pack;
+
+	rtg_pack_window(grp, wallclock);
+
+	if (!sysctl_sched_coloc_cache_pack || boost ||
+	    (s64)(wallclock - grp->pack_backoff_until) < 0)
+		cpumask_clear(&pack);
+	else
+		rtg_pack_cpus(grp, demand, &pack);
+
+	/* Read locklessly by wakeups, never expose a partial mask */
+	cpumask_copy(&grp->pack_cpus, &pack);
+}
+
+static int rtg_pack_stats_show(struct seq_file *m, void *v)
+{
+	struct related_thread_group *grp;
+	unsigned long flags;
+	u64 windows;
+
+	seq_printf(m, "cache_pack %u\n", sysctl_sched_coloc_cache_pack);
+
+	read_lock_irqsave(&related_thread_group_lock, flags);
+	list_for_each_entry(grp, &active_related_thread_groups, list) {
+		raw_spin_lock(&grp->lock);
+		windows = max_t(u64, grp->nr_windows, 1);
+		seq_printf(m, "group %d skip_min %d pack_cpus %*pbl packed_windows %llu/%llu\n",
+			   grp->id, grp->skip_min,
+			   cpumask_pr_args(&grp->pack_cpus),
+			   grp->nr_packed_windows, grp->nr_windows);
+		seq_printf(m, "  spread %u avg %llu.%02llu migrations %u avg %llu.%02llu\n",
+			   grp->last_spread,
+			   div64_u64(grp->sum_spread, windows),
+			   div64_u64(grp->sum_spread * 100, windows) % 100,
+			   grp->last_migrations,
+			   div64_u64(grp->sum_migrations, windows),
+			   div64_u64(grp->sum_migrations * 100, windows) % 100);
+		seq_printf(m, "  mpki packed %u unpacked %u backoffs %u\n",
+			   grp->packed_mpki, grp->unpacked_mpki,
+			   grp->nr_backoffs);
+		raw_spin_unlock(&grp->lock);
+	}
+	read_unlock_irqrestore(&related_thread_group_lock, flags);
+
+	return 0;
+}
+
+static int rtg_pack_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, rtg_pack_stats_show, NULL);
+}
+
+static const struct file_operations rtg_pack_stats_fops = {
+	.open		= rtg_pack_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static __init int rtg_pack_debugfs_init(void)
+{
+	debugfs_create_file("sched_coloc_stats", 0444, NULL, NULL,
+			    &rtg_pack_stats_fops);
+	return 0;
+}
+late_initcall(rtg_pack_debugfs_init);
+
+static void _set_preferred_cluster(struct related_thread_group *grp)
+{
+	struct task_struct *p;
+	u64 combined_demand = 0;
+	bool group_boost = false;
+	u64 wallclock;
+	bool prev_skip_min = grp->skip_min;
+
+	if (list_empty(&grp->tasks)) {
+		grp->skip_min = false;
+		cpumask_clear(&grp->pack_cpus);
+		goto out;
+	}
+
+	if (!hmp_capable()) {
+		grp->skip_min = false;
+		cpumask_clear(&grp->pack_cpus);
+		goto out;
+	}
+
+	wallclock = sched_ktime_clock();
+
+	/*
+	 * wakeup of two or more related tasks could race with each other and
+	 * could result in multiple calls to _set_preferred_cluster being issued
+	 * at same time. Avoid overhead in such cases of rechecking preferred
+	 * cluster
+	 */
+	if (wallclock - grp->last_update < sched_ravg_window / 10)
+		return;
+
+	list_for_each_entry(p, &grp->tasks, grp_list) {
+		if (task_boost_policy(p) == SCHED_BOOST_ON_BIG) {
+			group_boost = true;
+			break;
+		}
+
+		if (p->ravg.mark_start < wallclock -
+		    (sched_ravg_window * sched_ravg_hist_size))
+			continue;
+
+		combined_demand += p->ravg.coloc_demand;
+		if (!trace_sched_set_preferred_cluster_enabled() &&
+		    !sysctl_sched_coloc_cache_pack) {
+			if (combined_demand > sched_group_upmigrate)
+				break;
+		}
+	}
+
+	grp->last_update = wallclock;
+	update_best_cluster(grp, combined_demand, group_boost);
+	rtg_update_pack(grp, combined_demand, group_boost, wallclock);
+	trace_sched_set_preferred_cluster(grp, combined_demand);
+out:
+	if (grp->id == DEFAULT_CGROUP_COLOC_ID
+	    && grp->skip_min != prev_skip_min) {
+		if (grp->skip_min)
+			grp->start_ts = sched_clock();
+		sched_update_hyst_times();
+	}
+}
+
+void set_preferred_cluster(struct related_thread_group *grp)
+{
+	raw_spin_lock(&grp->lock);
+	_set_preferred_cluster(grp);
+	raw_spin_unlock(&grp->lock);
+}
+
+int update_preferred_cluster(struct related_thread_group *grp,
+		struct task_struct *p, u32 old_load, bool from_tick)
+{
+	u32 new_load = task_load(p);
+
+	if (!grp)
+		return 0;
+
+	if (unlikely(from_tick && is_suh_max()))
+		return 1;
+
+	/*
+	 * Update if task's load has changed significantly or a complete window
+	 * has passed since we last updated preference
+	 */
+	if (abs(new_load - old_load) > sched_ravg_window / 4 ||
+		sched_ktime_clock() - grp->last_update > sched_ravg_window)
+		return 1;
+
+	return 0;
+}
+
+#define ADD_TASK	0
+#define REM_TASK	1
+
+static inline struct related_thread_group*
+lookup_related_thread_group(unsigned int group_id)
+{
+	return related_thread_groups[group_id];
+}
+
+int alloc_related_thread_groups(void)
+{
+	int i, ret;
+	struct related_thread_group *grp;
+
+	/* groupd_id = 0 is invalid as it's special id to remove group. */
+	for (i = 1; i < MAX_NUM_CGROUP_COLOC_ID; i++) {
+		grp = kzalloc(sizeof(*grp), GFP_NOWAIT);
+		if (!grp) {
+			ret = -ENOMEM;
+			goto err;
+		}
+
+		grp->id = i;
+		INIT_LIST_HEAD(&grp->tasks);
+		INIT_LIST_HEAD(&grp->list);
+		raw_spin_lock_init(&grp->lock);
+
+		related_thread_groups[i] = grp;
+	}
+
+	return 0;
+
+err:
+	for (i = 1; i < MAX_NUM_CGROUP_COLOC_ID; i++) {
+		grp = lookup_related_thread_group(i);
+		if (grp) {
+			kfree(grp);
 			related_thread_groups[i] = NULL;
 		} else {
 			break;
@@ -3743,6 +4259,104 @@ static void walt_tunables_fixup(void)
 	walt_init_window_dep();
 }
 
+/*
+ * Roll @rq over to the current window and return its contribution to the
+ * group load of its cluster. Only this rq's lock is taken, so the other
+ * CPUs keep scheduling while their siblings are being rolled over. The
+ * longest rq lock hold is tracked in @lock_ns.
+ */
+static u64 walt_rollover_rq(struct rq *rq, u64 *lock_ns)
+{
+	struct sched_cluster *cluster = rq->cluster;
+	u64 grp_load = 0, start;
+
+	raw_spin_lock(&rq->lock);
+	start = sched_clock();
+
+	/* Serializes against update_cluster_load_subtractions() */
+	raw_spin_lock(&cluster->load_lock);
+	if (rq->curr) {
+		update_task_ravg(rq->curr, rq, TASK_UPDATE,
+				 sched_ktime_clock(), 0);
+		account_load_subtractions(rq);
+		grp_load = rq->grp_time.prev_runnable_sum;
+	}
+	raw_spin_unlock(&cluster->load_lock);
+
+	*lock_ns = max(*lock_ns, sched_clock() - start);
+	raw_spin_unlock(&rq->lock);
+
+	return grp_load;
+}
+
+static void cluster_set_aggr_grp_load(struct sched_cluster *cluster, u64 load)
+{
+	raw_spin_lock(&cluster->load_lock);
+	write_seqcount_begin(&cluster->aggr_seq);
+	cluster->aggr_grp_load = load;
+	write_seqcount_end(&cluster->aggr_seq);
+	raw_spin_unlock(&cluster->load_lock);
+}
+
+static void walt_update_asym_grp_load(u64 total_grp_load,
+				      u64 min_cluster_grp_load)
+{
+	int cpu;
+
+	if (total_grp_load) {
+		if (cpumask_weight(&asym_cap_sibling_cpus)) {
+			u64 big_grp_load =
+					  total_grp_load - min_cluster_grp_load;
+
+			for_each_cpu(cpu, &asym_cap_sibling_cpus)
+				cluster_set_aggr_grp_load(cpu_cluster(cpu),
+							  big_grp_load);
+		}
+		rtgb_active = is_rtgb_active();
+	} else {
+		rtgb_active = false;
+	}
+}
+
+/*
+ * Report the rolled over load of @cluster to the governor, one rq lock at
+ * a time. CPUs in @mig_mask, and the asym cap siblings when @asym_mig is
+ * set, are flagged as having seen an inter cluster migration.
+ */
+static void walt_cluster_cpufreq_update(struct sched_cluster *cluster,
+					const cpumask_t *mig_mask,
+					bool asym_mig, u64 *lock_ns)
+{
+	cpumask_t cluster_online_cpus;
+	unsigned int num_cpus, i = 1;
+	u64 start;
+	int cpu;
+
+	cpumask_and(&cluster_online_cpus, &cluster->cpus, cpu_online_mask);
+	num_cpus = cpumask_weight(&cluster_online_cpus);
+
+	for_each_cpu(cpu, &cluster_online_cpus) {
+		struct rq *rq = cpu_rq(cpu);
+		int flag = SCHED_CPUFREQ_WALT;
+
+		if (mig_mask && cpumask_test_cpu(cpu, mig_mask))
+			flag |= SCHED_CPUFREQ_INTERCLUSTER_MIG;
+
+		if (asym_mig && cpumask_test_cpu(cpu, &asym_cap_sibling_cpus))
+			flag |= SCHED_CPUFREQ_INTERCLUSTER_MIG;
+
+		if (i != num_cpus)
+			flag |= SCHED_CPUFREQ_CONTINUE;
+
+		raw_spin_lock(&rq->lock);
+		start = sched_clock();
+		cpufreq_update_util(rq, flag);
+		*lock_ns = max(*lock_ns, sched_clock() - start);
+		raw_spin_unlock(&rq->lock);
+		i++;
+	}
+}
+
 static inline void
 walt_irq_work_migration(struct irq_work *irq_work)
 {
@@ -3750,6 +4364,7 @@ walt_irq_work_migration(struct irq_work *irq_work)
 	bool is_asym_migration = false;
 	cpumask_t tmp_mask;
 	u64 total_grp_load = 0, min_cluster_grp_load = 0;
+	u64 lock_ns = 0;
 	int cpu;
 
 	raw_spin_lock(&speedchange_cpumask_lock);
@@ -3768,32 +4383,9 @@ walt_irq_work_migration(struct irq_work *irq_work)
 
 	for_each_sched_cluster(cluster) {
 		u64 aggr_grp_load = 0;
-		u64 wc;
-		cpumask_t cluster_online_cpus;
-		unsigned int num_cpus, i = 1;
-		struct rq *rq;
-		int level;
 
-		level = 0;
 		for_each_cpu(cpu, &cluster->cpus) {
-			if (level == 0)
-				raw_spin_lock(&cpu_rq(cpu)->lock);
-			else
-				raw_spin_lock_nested(&cpu_rq(cpu)->lock, level);
-			level++;
-		}
-
-		wc = sched_ktime_clock();
-		raw_spin_lock(&cluster->load_lock);
-
-		for_each_cpu(cpu, &cluster->cpus) {
-			rq = cpu_rq(cpu);
-			if (rq->curr) {
-				update_task_ravg(rq->curr, rq,
-						TASK_UPDATE, wc, 0);
-				account_load_subtractions(rq);
-				aggr_grp_load += rq->grp_time.prev_runnable_sum;
-			}
+			aggr_grp_load += walt_rollover_rq(cpu_rq(cpu), &lock_ns);
 
 			if (cpumask_test_cpu(cpu, &asym_cap_sibling_cpus) &&
 				cpumask_test_cpu(cpu, &tmp_mask)) {
@@ -3802,162 +4394,105 @@ walt_irq_work_migration(struct irq_work *irq_work)
 			}
 		}
 
-		cluster->aggr_grp_load = aggr_grp_load;
+		cluster_set_aggr_grp_load(cluster, aggr_grp_load);
 		total_grp_load += aggr_grp_load;
 
 		if (is_min_capacity_cluster(cluster))
 			min_cluster_grp_load = aggr_grp_load;
-		raw_spin_unlock(&cluster->load_lock);
 
-		if (total_grp_load) {
-			if (cpumask_weight(&asym_cap_sibling_cpus)) {
-				u64 big_grp_load =
-					  total_grp_load - min_cluster_grp_load;
+		walt_update_asym_grp_load(total_grp_load, min_cluster_grp_load);
+		walt_cluster_cpufreq_update(cluster, &tmp_mask,
+					    is_asym_migration, &lock_ns);
+	}
+}
 
-				for_each_cpu(cpu, &asym_cap_sibling_cpus)
-					cpu_cluster(cpu)->aggr_grp_load = big_grp_load;
-			}
-			rtgb_active = is_rtgb_active();
-		} else {
-			rtgb_active = false;
-		}
+/*
+ * Apply a pending window size change. This needs every rq to be quiescent,
+ * so unlike the rollover itself it takes all the rq locks; it only happens
+ * when the refresh rate or the window sysctl changes.
+ */
+static bool walt_update_window_size(void)
+{
+	unsigned long flags, rq_flags;
+	u64 wc;
 
-		cpumask_and(&cluster_online_cpus, &cluster->cpus, cpu_online_mask);
-		num_cpus = cpumask_weight(&cluster_online_cpus);
+	if (READ_ONCE(sched_ravg_window) == READ_ONCE(new_sched_ravg_window))
+		return false;
 
-		for_each_cpu(cpu, &cluster->cpus) {
-			int flag = SCHED_CPUFREQ_WALT;
+	acquire_rq_locks_irqsave(cpu_possible_mask, &rq_flags);
+	wc = sched_ktime_clock();
 
-			if (cpumask_test_cpu(cpu, &tmp_mask))
-				flag |= SCHED_CPUFREQ_INTERCLUSTER_MIG;
+	/*
+	 * If the current window roll over is delayed such that the
+	 * mark_start (current wallclock with which roll over is done)
+	 * of the current task went past the window start with the
+	 * updated new window size, delay the update to the next
+	 * window roll over. Otherwise the CPU counters (prs and crs) are
+	 * not rolled over properly as mark_start > window_start.
+	 */
+	spin_lock_irqsave(&sched_ravg_window_lock, flags);
 
-			if (is_asym_migration && cpumask_test_cpu(cpu, &asym_cap_sibling_cpus))
-				flag |= SCHED_CPUFREQ_INTERCLUSTER_MIG;
+	if ((sched_ravg_window != new_sched_ravg_window) &&
+	    (wc < this_rq()->window_start + new_sched_ravg_window)) {
 
-			if (i != num_cpus)
-				flag |= SCHED_CPUFREQ_CONTINUE;
+		sched_ravg_window_change_time = sched_ktime_clock();
+		printk_deferred("ALERT: changing window size from %u to %u at %lu\n",
+				sched_ravg_window,
+				new_sched_ravg_window,
+				sched_ravg_window_change_time);
+		sched_ravg_window = new_sched_ravg_window;
+		walt_tunables_fixup();
+	}
+	spin_unlock_irqrestore(&sched_ravg_window_lock, flags);
 
-			cpufreq_update_util(cpu_rq(cpu), flag);
-			i++;
-		}
+	release_rq_locks_irqrestore(cpu_possible_mask, &rq_flags);
 
-		for_each_cpu(cpu, &cluster->cpus)
-			raw_spin_unlock(&cpu_rq(cpu)->lock);
-	}
+	return true;
 }
 
-
 /*
  * Runs in hard-irq context. This should ideally run just after the latest
  * window roll-over.
+ *
+ * Each cluster is rolled over and reported to the governor on its own,
+ * taking one rq lock at a time, instead of stopping every CPU in the
+ * system for the duration of the whole rollover.
  */
 void walt_irq_work_roll_over(struct irq_work *irq_work)
 {
 	struct sched_cluster *cluster;
-	struct rq *rq;
 	int cpu;
-	u64 wc;
 	u64 total_grp_load = 0, min_cluster_grp_load = 0;
-	int level = 0;
-	unsigned long flags;
-
-	for_each_cpu(cpu, cpu_possible_mask) {
-		if (level == 0)
-			raw_spin_lock(&cpu_rq(cpu)->lock);
-		else
-			raw_spin_lock_nested(&cpu_rq(cpu)->lock, level);
-		level++;
-	}
+	u64 start = sched_clock(), lock_ns = 0;
+	bool resized;
 
-	wc = sched_ktime_clock();
 	walt_load_reported_window = atomic64_read(&walt_irq_work_lastq_ws);
 	for_each_sched_cluster(cluster) {
 		u64 aggr_grp_load = 0;
 
-		raw_spin_lock(&cluster->load_lock);
-
-		for_each_cpu(cpu, &cluster->cpus) {
-			rq = cpu_rq(cpu);
-			if (rq->curr) {
-				update_task_ravg(rq->curr, rq,
-						TASK_UPDATE, wc, 0);
-				account_load_subtractions(rq);
-				aggr_grp_load += rq->grp_time.prev_runnable_sum;
-			}
-		}
+		for_each_cpu(cpu, &cluster->cpus)
+			aggr_grp_load += walt_rollover_rq(cpu_rq(cpu), &lock_ns);
 
-		cluster->aggr_grp_load = aggr_grp_load;
+		cluster_set_aggr_grp_load(cluster, aggr_grp_load);
 		total_grp_load += aggr_grp_load;
 
 		if (is_min_capacity_cluster(cluster))
 			min_cluster_grp_load = aggr_grp_load;
-		raw_spin_unlock(&cluster->load_lock);
 	}
 
-	if (total_grp_load) {
-		if (cpumask_weight(&asym_cap_sibling_cpus)) {
-			u64 big_grp_load =
-					  total_grp_load - min_cluster_grp_load;
-
-			for_each_cpu(cpu, &asym_cap_sibling_cpus)
-				cpu_cluster(cpu)->aggr_grp_load = big_grp_load;
-		}
-		rtgb_active = is_rtgb_active();
-	} else {
-		rtgb_active = false;
-	}
+	walt_update_asym_grp_load(total_grp_load, min_cluster_grp_load);
 
 	if (sysctl_sched_user_hint && time_after(jiffies,
 					sched_user_hint_reset_time))
 		sysctl_sched_user_hint = 0;
 
-	for_each_sched_cluster(cluster) {
-		cpumask_t cluster_online_cpus;
-		unsigned int num_cpus, i = 1;
-
-		cpumask_and(&cluster_online_cpus, &cluster->cpus,
-						cpu_online_mask);
-		num_cpus = cpumask_weight(&cluster_online_cpus);
-		for_each_cpu(cpu, &cluster_online_cpus) {
-			rq = cpu_rq(cpu);
-
-			if (i == num_cpus)
-				cpufreq_update_util(cpu_rq(cpu), SCHED_CPUFREQ_WALT);
-			else
-				cpufreq_update_util(cpu_rq(cpu), SCHED_CPUFREQ_WALT |
-							SCHED_CPUFREQ_CONTINUE);
-			i++;
-		}
-	}
-
-	/*
-	 * If the window change request is in pending, good place to
-	 * change sched_ravg_window since all rq locks are acquired.
-	 *
-	 * If the current window roll over is delayed such that the
-	 * mark_start (current wallclock with which roll over is done)
-	 * of the current task went past the window start with the
-	 * updated new window size, delay the update to the next
-	 * window roll over. Otherwise the CPU counters (prs and crs) are
-	 * not rolled over properly as mark_start > window_start.
-	 */
-	spin_lock_irqsave(&sched_ravg_window_lock, flags);
-
-	if ((sched_ravg_window != new_sched_ravg_window) &&
-	    (wc < this_rq()->window_start + new_sched_ravg_window)) {
+	for_each_sched_cluster(cluster)
+		walt_cluster_cpufreq_update(cluster, NULL, false, &lock_ns);
 
-		sched_ravg_window_change_time = sched_ktime_clock();
-		printk_deferred("ALERT: changing window size from %u to %u at %lu\n",
-				sched_ravg_window,
-				new_sched_ravg_window,
-				sched_ravg_window_change_time);
-		sched_ravg_window = new_sched_ravg_window;
-		walt_tunables_fixup();
-	}
-	spin_unlock_irqrestore(&sched_ravg_window_lock, flags);
+	resized = walt_update_window_size();
 
-	for_each_cpu(cpu, cpu_possible_mask)
-		raw_spin_unlock(&cpu_rq(cpu)->lock);
+	trace_sched_walt_rollover(walt_load_reported_window,
+				  sched_clock() - start, lock_ns, resized);
 
 	core_ctl_check(this_rq()->window_start);
 }
@@ -4027,7 +4562,7 @@ fill_util:
 			break;
 
 		scale = arch_scale_cpu_capacity(NULL, fcpu);
-		data->ta_util_pct[i] = div64_u64(cluster->aggr_grp_load * 1024 *
+		data->ta_util_pct[i] = div64_u64(cluster_aggr_grp_load(cluster) * 1024 *
 				       100, (u64)sched_ravg_window * scale);
 
 		scale = arch_scale_freq_capacity(fcpu);
@@ -4134,7 +4669,7 @@ void walt_sched_init_rq(struct rq *rq)
 				sizeof(u8), GFP_NOWAIT);
 		/* No other choice */
 		BUG_ON(!rq->top_tasks[j]);
-		clear_top_tasks_bitmap(rq->top_tasks_bitmap[j]);
+		clear_top_tasks_bitmap(rq, j);
 	}
 	rq->cum_window_demand_scaled = 0;
 	rq->notif_pending = false;
@@ -4322,3 +4857,336 @@ unlock_mutex:
 	return ret;
 }
 #endif
+
+#ifdef CONFIG_SCHED_WALT_PRED_TEST
+/*
+ * Boot time check of the busy bucket helpers against the per bucket
+ * implementation they replace, plus the per task cost of one window
+ * rollover worth of prediction and bucket update with both.
+ */
+#define PRED_TEST_ROUNDS	100000
+
+static void ref_bucket_increase(u8 *buckets, int idx)
+{
+	int i, step;
+
+	for (i = 0; i < NUM_BUSY_BUCKETS; i++) {
+		if (idx != i) {
+			if (buckets[i] > DEC_STEP)
+				buckets[i] -= DEC_STEP;
+			else
+				buckets[i] = 0;
+		} else {
+			step = buckets[i] >= CONSISTENT_THRES ?
+						INC_STEP_BIG : INC_STEP;
+			if (buckets[i] > U8_MAX - step)
+				buckets[i] = U8_MAX;
+			else
+				buckets[i] += step;
+		}
+	}
+}
+
+static u32 ref_get_pred_busy(const u8 *buckets, const u32 *hist,
+			     int hist_size, int start, u32 runtime,
+			     u32 max_load)
+{
+	int i;
+	u32 dmin, dmax;
+	int first = NUM_BUSY_BUCKETS, final;
+	u32 ret = runtime;
+
+	for (i = start; i < NUM_BUSY_BUCKETS; i++) {
+		if (buckets[i]) {
+			first = i;
+			break;
+		}
+	}
+	if (first >= NUM_BUSY_BUCKETS)
+		return runtime;
+
+	final = first;
+	if (final < 2) {
+		dmin = 0;
+		final = 1;
+	} else {
+		dmin = mult_frac(final, max_load, NUM_BUSY_BUCKETS);
+	}
+	dmax = mult_frac(final + 1, max_load, NUM_BUSY_BUCKETS);
+
+	for (i = 0; i < hist_size; i++) {
+		if (hist[i] >= dmin && hist[i] < dmax) {
+			ret = hist[i];
+			break;
+		}
+	}
+	if (ret < dmin)
+		ret = (dmin + dmax) / 2;
+
+	return max(runtime, ret);
+}
+
+struct pred_test_case {
+	u8 buckets[NUM_BUSY_BUCKETS];
+	u32 hist[RAVG_HIST_SIZE_MAX];
+	u32 runtime;
+	int start;
+	int hist_size;
+};
+
+static void pred_test_fill(struct pred_test_case *t, u32 max_load)
+{
+	int i;
+
+	/* Mostly empty or decaying buckets, as seen on real tasks */
+	for (i = 0; i < NUM_BUSY_BUCKETS; i++)
+		t->buckets[i] = prandom_u32() % 4 ? 0 : prandom_u32();
+	for (i = 0; i < RAVG_HIST_SIZE_MAX; i++)
+		t->hist[i] = prandom_u32() % (max_load + 1);
+	t->runtime = prandom_u32() % (max_load + 1);
+	t->start = 1 + prandom_u32() % (NUM_BUSY_BUCKETS - 1);
+	t->hist_size = 1 + prandom_u32() % RAVG_HIST_SIZE_MAX;
+}
+
+static int __init walt_pred_test(void)
+{
+	static struct pred_test_case cases[64] __initdata;
+	u8 a[NUM_BUSY_BUCKETS], b[NUM_BUSY_BUCKETS];
+	u32 max_load = sched_ravg_window;
+	u64 t0, ref_ns, new_ns;
+	int i, idx, failed = 0;
+	u32 sink = 0;
+
+	for (i = 0; i < PRED_TEST_ROUNDS; i++) {
+		struct pred_test_case *t = &cases[i % ARRAY_SIZE(cases)];
+		u32 ref, new;
+
+		pred_test_fill(t, max_load);
+		ref = ref_get_pred_busy(t->buckets, t->hist, t->hist_size,
+					t->start, t->runtime, max_load);
+		new = __get_pred_busy(t->buckets, t->hist, t->hist_size,
+				      t->start, t->runtime, max_load);
+
+		idx = prandom_u32() % NUM_BUSY_BUCKETS;
+		memcpy(a, t->buckets, sizeof(a));
+		memcpy(b, t->buckets, sizeof(b));
+		ref_bucket_increase(a, idx);
+		bucket_increase(b, idx);
+
+		if (ref != new || memcmp(a, b, sizeof(a))) {
+			if (!failed++)
+				pr_err("walt_pred_test: mismatch start=%d runtime=%u idx=%d pred=%u expected=%u\n",
+				       t->start, t->runtime, idx, new, ref);
+		}
+	}
+
+	t0 = sched_clock();
+	for (i = 0; i < PRED_TEST_ROUNDS; i++) {
+		struct pred_test_case *t = &cases[i % ARRAY_SIZE(cases)];
+
+		sink += ref_get_pred_busy(t->buckets, t->hist, t->hist_size,
+					  t->start, t->runtime, max_load);
+		ref_bucket_increase(t->buckets, t->start);
+	}
+	ref_ns = sched_clock() - t0;
+
+	t0 = sched_clock();
+	for (i = 0; i < PRED_TEST_ROUNDS; i++) {
+		struct pred_test_case *t = &cases[i % ARRAY_SIZE(cases)];
+
+		sink += __get_pred_busy(t->buckets, t->hist, t->hist_size,
+					t->start, t->runtime, max_load);
+		bucket_increase(t->buckets, t->start);
+	}
+	new_ns = sched_clock() - t0;
+	barrier_data(&sink);
+
+	pr_info("walt_pred_test: %d mismatches in %d rounds, per update: %llu ns (was %llu ns)\n",
+		failed, PRED_TEST_ROUNDS, div_u64(new_ns, PRED_TEST_ROUNDS),
+		div_u64(ref_ns, PRED_TEST_ROUNDS));
+
+	return WARN_ON(failed) ? -EINVAL : 0;
+}
+late_initcall(walt_pred_test);
+#endif
+
+#ifdef CONFIG_SCHED_WALT_TOP_TASKS_TEST
+/*
+ * Boot time check of the top task index: random migrations of tasks
+ * between two runqueues must keep curr_top and prev_top equal to the
+ * highest non empty bucket. Also reports the cost of a migration against
+ * the flat bitmap and find_next_bit() lookup it replaces.
+ */
+#define TOP_TEST_TASKS		64
+#define TOP_TEST_ROUNDS		100000
+
+struct top_test_ref {
+	u8 table[NUM_TRACKED_WINDOWS][NUM_LOAD_INDICES];
+	DECLARE_BITMAP_ARRAY(bitmap, NUM_TRACKED_WINDOWS, NUM_LOAD_INDICES + 1);
+	int top[NUM_TRACKED_WINDOWS];
+};
+
+static int __init ref_get_top_index(unsigned long *bitmap,
+				    unsigned long old_top)
+{
+	int index = find_next_bit(bitmap, NUM_LOAD_INDICES, old_top);
+
+	if (index == NUM_LOAD_INDICES)
+		return 0;
+
+	return NUM_LOAD_INDICES - 1 - index;
+}
+
+static void __init ref_add(struct top_test_ref *dst, int t, u32 load)
+{
+	int index = load_to_index(load);
+
+	if (!load)
+		return;
+
+	dst->table[t][index] += 1;
+	if (dst->table[t][index] == 1)
+		__set_bit(NUM_LOAD_INDICES - index - 1, dst->bitmap[t]);
+	if (index > dst->top[t])
+		dst->top[t] = index;
+}
+
+static void __init ref_migrate(struct top_test_ref *src,
+			       struct top_test_ref *dst, int t, u32 load)
+{
+	int index = load_to_index(load);
+
+	if (!load)
+		return;
+
+	src->table[t][index] -= 1;
+	if (!src->table[t][index])
+		__clear_bit(NUM_LOAD_INDICES - index - 1, src->bitmap[t]);
+	if (index == src->top[t] && !src->table[t][index])
+		src->top[t] = ref_get_top_index(src->bitmap[t], src->top[t]);
+
+	ref_add(dst, t, load);
+}
+
+static int __init top_test_max(struct rq *rq, int table)
+{
+	int i;
+
+	for (i = NUM_LOAD_INDICES - 1; i > 0; i--)
+		if (rq->top_tasks[table][i])
+			break;
+
+	return i;
+}
+
+static int __init walt_top_tasks_test(void)
+{
+	static struct top_test_ref ref[2] __initdata;
+	static u32 curr[TOP_TEST_TASKS] __initdata;
+	static u32 prev[TOP_TEST_TASKS] __initdata;
+	u8 on_rq[TOP_TEST_TASKS];
+	struct rnd_state rnd, seq;
+	struct task_struct *p;
+	struct rq *rqs[2] = { };
+	u64 t0, ref_ns, new_ns;
+	int i, j, t, failed = 0;
+	int ret = -ENOMEM;
+
+	p = kzalloc(sizeof(*p), GFP_KERNEL);
+	for (i = 0; i < 2; i++) {
+		rqs[i] = kzalloc(sizeof(*rqs[i]), GFP_KERNEL);
+		if (!rqs[i])
+			goto out;
+		for (j = 0; j < NUM_TRACKED_WINDOWS; j++) {
+			rqs[i]->top_tasks[j] = kcalloc(NUM_LOAD_INDICES,
+						       sizeof(u8), GFP_KERNEL);
+			if (!rqs[i]->top_tasks[j])
+				goto out;
+			clear_top_tasks_bitmap(rqs[i], j);
+			__set_bit(NUM_LOAD_INDICES, ref[i].bitmap[j]);
+		}
+	}
+	if (!p)
+		goto out;
+
+	/* Mostly small tasks, with a few that use most of the window */
+	for (i = 0; i < TOP_TEST_TASKS; i++) {
+		curr[i] = prandom_u32() % (i % 8 ? sched_ravg_window / 8 :
+					   sched_ravg_window);
+		prev[i] = prandom_u32() % (i % 8 ? sched_ravg_window / 8 :
+					   sched_ravg_window);
+		on_rq[i] = 0;
+
+		p->ravg.curr_window = curr[i];
+		p->ravg.prev_window = prev[i];
+		migrate_finish_top_tasks(p, rqs[0]);
+		ref_add(&ref[0], 0, curr[i]);
+		ref_add(&ref[0], 1, prev[i]);
+	}
+
+	/* The same sequence of migrations is replayed for the timings */
+	prandom_seed_state(&rnd, prandom_u32());
+	seq = rnd;
+	for (i = 0; i < TOP_TEST_ROUNDS; i++) {
+		t = prandom_u32_state(&seq) % TOP_TEST_TASKS;
+		p->ravg.curr_window = curr[t];
+		p->ravg.prev_window = prev[t];
+		migrate_top_tasks(p, rqs[on_rq[t]], rqs[!on_rq[t]]);
+		on_rq[t] = !on_rq[t];
+
+		for (j = 0; j < 2; j++) {
+			if (rqs[j]->curr_top == top_test_max(rqs[j], 0) &&
+			    rqs[j]->prev_top == top_test_max(rqs[j], 1))
+				continue;
+			if (!failed++)
+				pr_err("walt_top_tasks_test: rq%d top %d/%d expected %d/%d\n",
+				       j, rqs[j]->curr_top, rqs[j]->prev_top,
+				       top_test_max(rqs[j], 0),
+				       top_test_max(rqs[j], 1));
+		}
+	}
+
+	/* ref[] is still in the initial placement, where rqs[] started */
+	memset(on_rq, 0, sizeof(on_rq));
+	seq = rnd;
+	t0 = sched_clock();
+	for (i = 0; i < TOP_TEST_ROUNDS; i++) {
+		t = prandom_u32_state(&seq) % TOP_TEST_TASKS;
+		ref_migrate(&ref[on_rq[t]], &ref[!on_rq[t]], 0, curr[t]);
+		ref_migrate(&ref[on_rq[t]], &ref[!on_rq[t]], 1, prev[t]);
+		on_rq[t] = !on_rq[t];
+	}
+	ref_ns = sched_clock() - t0;
+
+	/* Both are now in the same placement again */
+	seq = rnd;
+	t0 = sched_clock();
+	for (i = 0; i < TOP_TEST_ROUNDS; i++) {
+		t = prandom_u32_state(&seq) % TOP_TEST_TASKS;
+		p->ravg.curr_window = curr[t];
+		p->ravg.prev_window = prev[t];
+		migrate_top_tasks(p, rqs[on_rq[t]], rqs[!on_rq[t]]);
+		on_rq[t] = !on_rq[t];
+	}
+	new_ns = sched_clock() - t0;
+
+	pr_info("walt_top_tasks_test: %d mismatches in %d migrations, per migration: %llu ns (was %llu ns)\n",
+		failed, TOP_TEST_ROUNDS, div_u64(new_ns, TOP_TEST_ROUNDS),
+		div_u64(ref_ns, TOP_TEST_ROUNDS));
+	ret = WARN_ON(failed) ? -EINVAL : 0;
+out:
+	for (i = 0; i < 2; i++) {
+		if (!rqs[i])
+			continue;
+		for (j = 0; j < NUM_TRACKED_WINDOWS; j++)
+			kfree(rqs[i]->top_tasks[j]);
+		kfree(rqs[i]);
+	}
+	kfree(p);
+	if (ret == -ENOMEM)
+		pr_err("walt_top_tasks_test: allocation failed\n");
+
+	return ret;
+}
+late_initcall(walt_top_tasks_test);
+#endif
@@ -281,7 +281,7 @@ extern struct list_head cluster_head;
 
 extern void init_clusters(void);
 
-extern void clear_top_tasks_bitmap(unsigned long *bitmap);
+extern void clear_top_tasks_bitmap(struct rq *rq, int table);
 
 extern void sched_account_irqtime(int cpu, struct task_struct *curr,
 				 u64 delta, u64 wallclock);
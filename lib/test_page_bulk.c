@@ -0,0 +1,148 @@
+// SPDX-License-Identifier: GPL-2.0
+
+/*
+ * Test module for the bulk page allocator. Compares the throughput of
+ * alloc_pages_bulk_array()/alloc_pages_bulk_list() against calling
+ * alloc_page() in a loop for the same number of pages.
+ */
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/gfp.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/sched.h>
+
+#define __param(type, name, init, msg)		\
+	static type name = init;				\
+	module_param(name, type, 0444);			\
+	MODULE_PARM_DESC(name, msg)				\
+
+__param(int, nr_pages, 64,
+	"Number of pages requested per allocation round");
+
+__param(int, test_loop_count, 10000,
+	"Number of allocation rounds per test");
+
+static struct page **pages;
+
+static void free_page_array(int nr)
+{
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		__free_page(pages[i]);
+		pages[i] = NULL;
+	}
+}
+
+static int single_alloc_test(void)
+{
+	int i;
+
+	for (i = 0; i < nr_pages; i++) {
+		pages[i] = alloc_page(GFP_KERNEL);
+		if (!pages[i]) {
+			free_page_array(i);
+			return -ENOMEM;
+		}
+	}
+	free_page_array(nr_pages);
+
+	return 0;
+}
+
+static int bulk_array_alloc_test(void)
+{
+	unsigned long nr;
+
+	nr = alloc_pages_bulk_array(GFP_KERNEL, nr_pages, pages);
+	free_page_array(nr);
+
+	return nr == nr_pages ? 0 : -ENOMEM;
+}
+
+static int bulk_list_alloc_test(void)
+{
+	struct page *page, *next;
+	unsigned long nr;
+	LIST_HEAD(list);
+
+	nr = alloc_pages_bulk_list(GFP_KERNEL, nr_pages, &list);
+	list_for_each_entry_safe(page, next, &list, lru) {
+		list_del(&page->lru);
+		__free_page(page);
+	}
+
+	return nr == nr_pages ? 0 : -ENOMEM;
+}
+
+struct test_case_desc {
+	const char *test_name;
+	int (*test_func)(void);
+};
+
+static struct test_case_desc test_case_array[] = {
+	{ "single_alloc_test", single_alloc_test },
+	{ "bulk_array_alloc_test", bulk_array_alloc_test },
+	{ "bulk_list_alloc_test", bulk_list_alloc_test },
+};
+
+static void run_test(struct test_case_desc *t)
+{
+	int passed = 0, failed = 0;
+	u64 usec, rate;
+	ktime_t kt;
+	int i;
+
+	kt = ktime_get();
+	for (i = 0; i < test_loop_count; i++) {
+		if (!t->test_func())
+			passed++;
+		else
+			failed++;
+
+		cond_resched();
+	}
+	usec = max_t(u64, ktime_us_delta(ktime_get(), kt), 1);
+
+	rate = (u64)passed * nr_pages * USEC_PER_SEC;
+	do_div(rate, usec);
+
+	pr_info("Summary: %s passed: %d failed: %d loops: %d pages: %d time: %llu usec rate: %llu pages/sec\n",
+		t->test_name, passed, failed, test_loop_count, nr_pages,
+		usec, rate);
+}
+
+static int page_bulk_test_init(void)
+{
+	int i;
+
+	if (nr_pages <= 0)
+		nr_pages = 1;
+
+	if (test_loop_count <= 0)
+		test_loop_count = 1;
+
+	pages = kcalloc(nr_pages, sizeof(*pages), GFP_KERNEL);
+	if (!pages)
+		return -ENOMEM;
+
+	for (i = 0; i < ARRAY_SIZE(test_case_array); i++)
+		run_test(&test_case_array[i]);
+
+	kfree(pages);
+	return -EAGAIN; /* Fail will directly unload the module */
+}
+
+static void page_bulk_test_exit(void)
+{
+}
+
+module_init(page_bulk_test_init)
+module_exit(page_bulk_test_exit)
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("bulk page allocator test module");
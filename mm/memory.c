@@ -2371,6 +2371,7 @@ static bool pte_spinlock(struct vm_fault *vmf)
 	local_irq_disable();
 	if (vma_has_changed(vmf)) {
 		trace_spf_vma_changed(_RET_IP_, vmf->vma, vmf->address);
+		count_vm_event(SPECULATIVE_PGFAULT_VMA_CHANGED);
 		goto out;
 	}
 
@@ -2382,6 +2383,7 @@ static bool pte_spinlock(struct vm_fault *vmf)
 	pmdval = READ_ONCE(*vmf->pmd);
 	if (!pmd_same(pmdval, vmf->orig_pmd)) {
 		trace_spf_pmd_changed(_RET_IP_, vmf->vma, vmf->address);
+		count_vm_event(SPECULATIVE_PGFAULT_PGTABLE);
 		goto out;
 	}
 #endif
@@ -2389,12 +2391,14 @@ static bool pte_spinlock(struct vm_fault *vmf)
 	vmf->ptl = pte_lockptr(vmf->vma->vm_mm, vmf->pmd);
 	if (unlikely(!spin_trylock(vmf->ptl))) {
 		trace_spf_pte_lock(_RET_IP_, vmf->vma, vmf->address);
+		count_vm_event(SPECULATIVE_PGFAULT_PTE_LOCK);
 		goto out;
 	}
 
 	if (vma_has_changed(vmf)) {
 		spin_unlock(vmf->ptl);
 		trace_spf_vma_changed(_RET_IP_, vmf->vma, vmf->address);
+		count_vm_event(SPECULATIVE_PGFAULT_VMA_CHANGED);
 		goto out;
 	}
 
@@ -2429,6 +2433,7 @@ static bool pte_map_lock(struct vm_fault *vmf)
 	local_irq_disable();
 	if (vma_has_changed(vmf)) {
 		trace_spf_vma_changed(_RET_IP_, vmf->vma, vmf->address);
+		count_vm_event(SPECULATIVE_PGFAULT_VMA_CHANGED);
 		goto out;
 	}
 
@@ -2440,6 +2445,7 @@ static bool pte_map_lock(struct vm_fault *vmf)
 	pmdval = READ_ONCE(*vmf->pmd);
 	if (!pmd_same(pmdval, vmf->orig_pmd)) {
 		trace_spf_pmd_changed(_RET_IP_, vmf->vma, vmf->address);
+		count_vm_event(SPECULATIVE_PGFAULT_PGTABLE);
 		goto out;
 	}
 #endif
@@ -2456,12 +2462,14 @@ static bool pte_map_lock(struct vm_fault *vmf)
 	if (unlikely(!spin_trylock(ptl))) {
 		pte_unmap(pte);
 		trace_spf_pte_lock(_RET_IP_, vmf->vma, vmf->address);
+		count_vm_event(SPECULATIVE_PGFAULT_PTE_LOCK);
 		goto out;
 	}
 
 	if (vma_has_changed(vmf)) {
 		pte_unmap_unlock(pte, ptl);
 		trace_spf_vma_changed(_RET_IP_, vmf->vma, vmf->address);
+		count_vm_event(SPECULATIVE_PGFAULT_VMA_CHANGED);
 		goto out;
 	}
 
@@ -3197,14 +3205,15 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 		} else if (vmf->flags & FAULT_FLAG_SPECULATIVE) {
 			/*
 			 * Don't try readahead during a speculative page fault
-			 * as the VMA's boundaries may change in our back.
-			 * If the page is not in the swap cache and synchronous
-			 * read is disabled, fall back to the regular page fault
-			 * mechanism.
+			 * as the VMA's boundaries and the surrounding page
+			 * tables may change in our back. Read the faulting
+			 * page only: it lands in the swap cache, so even if
+			 * the VMA is found changed below, the regular page
+			 * fault will pick it up from there.
 			 */
-			delayacct_clear_flag(DELAYACCT_PF_SWAPIN);
-			ret = VM_FAULT_RETRY;
-			goto out;
+			page = read_swap_cache_async(entry, GFP_HIGHUSER_MOVABLE,
+						     vma, vmf->address, false);
+			swapcache = page;
 		} else {
 			page = swapin_readahead(entry, GFP_HIGHUSER_MOVABLE,
 						vmf);
@@ -3233,6 +3242,8 @@ vm_fault_t do_swap_page(struct vm_fault *vmf)
 		ret = VM_FAULT_MAJOR;
 		count_vm_event(PGMAJFAULT);
 		count_memcg_event_mm(vma->vm_mm, PGMAJFAULT);
+		mm_reclaim_refault(vma->vm_mm, NULL,
+				   linear_page_index(vma, vmf->address));
 	} else if (PageHWPoison(page)) {
 		/*
 		 * hwpoisoned dirty swapcache pages are kept for killing
@@ -4288,8 +4299,10 @@ static vm_fault_t handle_pte_fault(struct vm_fault *vmf)
 		 * again holding the mmap_sem (which implies that the collapse
 		 * operation is done).
 		 */
-		if (vmf->flags & FAULT_FLAG_SPECULATIVE)
+		if (vmf->flags & FAULT_FLAG_SPECULATIVE) {
+			count_vm_event(SPECULATIVE_PGFAULT_PGTABLE);
 			return VM_FAULT_RETRY;
+		}
 		/*
 		 * Leave __pte_alloc() until later: because vm_ops->fault may
 		 * want to allocate huge page, and if we expose page table
@@ -4477,6 +4490,22 @@ static vm_fault_t __handle_mm_fault(struct vm_area_struct *vma,
  * hodling the mmap_sem.
  */
 
+/*
+ * The speculative path gave up after the fault type was known: account the
+ * abort against the type, the reason has been accounted where it was hit.
+ */
+static enum vm_event_item spf_abort_event(enum vm_event_item event)
+{
+	switch (event) {
+	case SPECULATIVE_PGFAULT_SWAP:
+		return SPECULATIVE_PGFAULT_SWAP_ABORT;
+	case SPECULATIVE_PGFAULT_FILE:
+		return SPECULATIVE_PGFAULT_FILE_ABORT;
+	default:
+		return SPECULATIVE_PGFAULT_ANON_ABORT;
+	}
+}
+
 /*
  * Tries to handle the page fault in a speculative way, without grabbing the
  * mmap_sem.
@@ -4495,6 +4524,7 @@ int __handle_speculative_fault(struct mm_struct *mm, unsigned long address,
 	pgd_t *pgd, pgdval;
 	p4d_t *p4d, p4dval;
 	pud_t pudval;
+	enum vm_event_item event;
 	int seq, ret;
 
 	/* Clear flags that may lead to release the mmap_sem to retry */
@@ -4510,6 +4540,7 @@ int __handle_speculative_fault(struct mm_struct *mm, unsigned long address,
 	seq = raw_read_seqcount(&vmf.vma->vm_sequence);
 	if (seq & 1) {
 		trace_spf_vma_changed(_RET_IP_, vmf.vma, address);
+		count_vm_event(SPECULATIVE_PGFAULT_VMA_CHANGED);
 		return VM_FAULT_RETRY;
 	}
 
@@ -4518,19 +4549,24 @@ int __handle_speculative_fault(struct mm_struct *mm, unsigned long address,
 	 * because vm_next and vm_prev must be safe. This can't be guaranteed
 	 * in the speculative path.
 	 */
-	if (unlikely(vma_is_anonymous(vmf.vma) && !vmf.vma->anon_vma)) {
-		trace_spf_vma_notsup(_RET_IP_, vmf.vma, address);
-		return VM_FAULT_RETRY;
-	}
+	if (unlikely(vma_is_anonymous(vmf.vma) && !vmf.vma->anon_vma))
+		goto out_notsup;
 
 	vmf.vma_flags = READ_ONCE(vmf.vma->vm_flags);
 	vmf.vma_page_prot = READ_ONCE(vmf.vma->vm_page_prot);
 
 	/* Can't call userland page fault handler in the speculative path */
-	if (unlikely(vmf.vma_flags & VM_UFFD_MISSING)) {
-		trace_spf_vma_notsup(_RET_IP_, vmf.vma, address);
-		return VM_FAULT_RETRY;
-	}
+	if (unlikely(vmf.vma_flags & VM_UFFD_MISSING))
+		goto out_notsup;
+
+	/*
+	 * Driver mappings insert their PFNs or pages through
+	 * vm_insert_pfn()/vm_insert_page(), which walk and populate the
+	 * page tables without pte_map_lock() and so don't revalidate the
+	 * VMA. Only page cache backed ->fault() handlers are safe here.
+	 */
+	if (unlikely(vmf.vma_flags & (VM_PFNMAP | VM_MIXEDMAP | VM_IO)))
+		goto out_notsup;
 
 	if (vmf.vma_flags & VM_GROWSDOWN || vmf.vma_flags & VM_GROWSUP) {
 		/*
@@ -4538,13 +4574,13 @@ int __handle_speculative_fault(struct mm_struct *mm, unsigned long address,
 		 * boundaries but we want to trace it as not supported instead
 		 * of changed.
 		 */
-		trace_spf_vma_notsup(_RET_IP_, vmf.vma, address);
-		return VM_FAULT_RETRY;
+		goto out_notsup;
 	}
 
 	if (address < READ_ONCE(vmf.vma->vm_start)
 	    || READ_ONCE(vmf.vma->vm_end) <= address) {
 		trace_spf_vma_changed(_RET_IP_, vmf.vma, address);
+		count_vm_event(SPECULATIVE_PGFAULT_VMA_CHANGED);
 		return VM_FAULT_RETRY;
 	}
 
@@ -4572,10 +4608,8 @@ int __handle_speculative_fault(struct mm_struct *mm, unsigned long address,
 	if (!pol)
 		pol = get_task_policy(current);
 	if (!pol)
-		if (pol && pol->mode == MPOL_INTERLEAVE) {
-			trace_spf_vma_notsup(_RET_IP_, vmf.vma, address);
-			return VM_FAULT_RETRY;
-		}
+		if (pol && pol->mode == MPOL_INTERLEAVE)
+			goto out_notsup;
 #endif
 
 	/*
@@ -4649,9 +4683,18 @@ int __handle_speculative_fault(struct mm_struct *mm, unsigned long address,
 	 */
 	if (read_seqcount_retry(&vmf.vma->vm_sequence, seq)) {
 		trace_spf_vma_changed(_RET_IP_, vmf.vma, address);
+		count_vm_event(SPECULATIVE_PGFAULT_VMA_CHANGED);
 		return VM_FAULT_RETRY;
 	}
 
+	if (vmf.pte && is_swap_pte(vmf.orig_pte) &&
+	    !non_swap_entry(pte_to_swp_entry(vmf.orig_pte)))
+		event = SPECULATIVE_PGFAULT_SWAP;
+	else if (vma_is_anonymous(vmf.vma))
+		event = SPECULATIVE_PGFAULT_ANON;
+	else
+		event = SPECULATIVE_PGFAULT_FILE;
+
 	mem_cgroup_enter_user_fault();
 	ret = handle_pte_fault(&vmf);
 	mem_cgroup_exit_user_fault();
@@ -4660,12 +4703,11 @@ int __handle_speculative_fault(struct mm_struct *mm, unsigned long address,
 	 * If there is no need to retry, don't return the vma to the caller.
 	 */
 	if (ret != VM_FAULT_RETRY) {
-		if (vma_is_anonymous(vmf.vma))
-			count_vm_event(SPECULATIVE_PGFAULT_ANON);
-		else
-			count_vm_event(SPECULATIVE_PGFAULT_FILE);
+		count_vm_event(event);
 		put_vma(vmf.vma);
 		*vma = NULL;
+	} else {
+		count_vm_event(spf_abort_event(event));
 	}
 
 	/*
@@ -4680,9 +4722,15 @@ int __handle_speculative_fault(struct mm_struct *mm, unsigned long address,
 
 out_walk:
 	trace_spf_vma_notsup(_RET_IP_, vmf.vma, address);
+	count_vm_event(SPECULATIVE_PGFAULT_PGTABLE);
 	local_irq_enable();
 	return VM_FAULT_RETRY;
 
+out_notsup:
+	trace_spf_vma_notsup(_RET_IP_, vmf.vma, address);
+	count_vm_event(SPECULATIVE_PGFAULT_VMA_NOTSUP);
+	return VM_FAULT_RETRY;
+
 out_segv:
 	trace_spf_vma_access(_RET_IP_, vmf.vma, address);
 	/*
@@ -4816,6 +4816,176 @@ static inline void finalise_ac(gfp_t gfp_mask, struct alloc_context *ac)
 					ac->high_zoneidx, ac->nodemask);
 }
 
+#ifdef CONFIG_COMPACTION
+/*
+ * Account a costly high-order allocation that could have stalled in
+ * direct compaction and was served from the free lists at the first
+ * attempt instead, while proactive compaction is on. Compared with
+ * compact_stall, this shows whether proactive compaction moves such
+ * allocations off the slow path.
+ */
+static inline void count_costly_fastpath(gfp_t gfp_mask, unsigned int order)
+{
+	if (unlikely(order > PAGE_ALLOC_COSTLY_ORDER) &&
+	    (gfp_mask & __GFP_DIRECT_RECLAIM) &&
+	    sysctl_compaction_proactiveness)
+		count_vm_event(COMPACT_COSTLY_FASTPATH);
+}
+#else
+static inline void count_costly_fastpath(gfp_t gfp_mask, unsigned int order)
+{
+}
+#endif
+
+/*
+ * __alloc_pages_bulk - Allocate a number of order-0 pages to a list or array
+ * @gfp: GFP flags for the allocation
+ * @preferred_nid: The preferred NUMA node ID to allocate from
+ * @nodemask: Set of nodes to allocate from, may be NULL
+ * @nr_pages: The number of pages desired on the list or array
+ * @page_list: Optional list to store the allocated pages
+ * @page_array: Optional array to store the pages
+ *
+ * This is a batched version of the page allocator that attempts to
+ * allocate nr_pages quickly. Pages are taken from the per-cpu lists of
+ * the first suitable zone with interrupts disabled only once, and the
+ * per-cpu lists are refilled from the zone free lists in pcp->batch
+ * sized chunks under a single zone->lock acquisition each. Pages are
+ * added to page_list if page_list is not NULL, otherwise it is assumed
+ * that the page_array is valid.
+ *
+ * For lists, nr_pages is the number of pages that should be allocated.
+ *
+ * For arrays, only NULL elements are populated with pages and nr_pages
+ * is the maximum number of pages that will be stored in the array.
+ *
+ * Returns the number of pages on the list or array. If the fast path
+ * cannot be used, at least one page is allocated through the regular
+ * allocator so that callers make progress.
+ */
+unsigned long __alloc_pages_bulk(gfp_t gfp, int preferred_nid,
+			nodemask_t *nodemask, int nr_pages,
+			struct list_head *page_list,
+			struct page **page_array)
+{
+	struct page *page;
+	unsigned long flags;
+	struct zone *zone;
+	struct zoneref *z;
+	struct per_cpu_pages *pcp;
+	struct alloc_context ac;
+	gfp_t alloc_gfp;
+	unsigned int alloc_flags = ALLOC_WMARK_LOW;
+	int nr_populated = 0, nr_account = 0;
+
+	/*
+	 * Skip populated array elements to determine if any pages need
+	 * to be allocated before disabling IRQs.
+	 */
+	while (page_array && nr_populated < nr_pages && page_array[nr_populated])
+		nr_populated++;
+
+	/* Already populated array? */
+	if (unlikely(page_array && nr_pages - nr_populated == 0))
+		return nr_populated;
+
+	/* Use the single page allocator for one page. */
+	if (nr_pages - nr_populated == 1)
+		goto failed;
+
+	/* Bulk allocations are not charged to memcg, leave those to the slow path */
+	if (memcg_kmem_enabled() && (gfp & __GFP_ACCOUNT))
+		goto failed;
+
+	gfp &= gfp_allowed_mask;
+	alloc_gfp = gfp;
+	if (!prepare_alloc_pages(gfp, 0, preferred_nid, nodemask, &ac,
+				 &alloc_gfp, &alloc_flags))
+		return nr_populated;
+	gfp = alloc_gfp;
+	finalise_ac(gfp, &ac);
+
+	/* Find an allowed local zone that meets the low watermark. */
+	for_each_zone_zonelist_nodemask(zone, z, ac.zonelist, ac.high_zoneidx,
+					ac.nodemask) {
+		unsigned long mark;
+
+		if (cpusets_enabled() && (alloc_flags & ALLOC_CPUSET) &&
+		    !__cpuset_zone_allowed(zone, gfp))
+			continue;
+
+		if (nr_online_nodes > 1 && zone != ac.preferred_zoneref->zone &&
+		    zone_to_nid(zone) != zone_to_nid(ac.preferred_zoneref->zone))
+			goto failed;
+
+		mark = wmark_pages(zone, alloc_flags & ALLOC_WMARK_MASK) +
+			nr_pages;
+		if (zone_watermark_fast(zone, 0, mark,
+					zonelist_zone_idx(ac.preferred_zoneref),
+					alloc_flags))
+			break;
+	}
+
+	/*
+	 * If there are no allowed local zones that meets the watermarks then
+	 * try to allocate a single page and reclaim if necessary.
+	 */
+	if (unlikely(!zone))
+		goto failed;
+
+	/* Attempt the batch allocation */
+	local_irq_save(flags);
+	pcp = &this_cpu_ptr(zone->pageset)->pcp;
+
+	while (nr_populated < nr_pages) {
+
+		/* Skip existing pages */
+		if (page_array && page_array[nr_populated]) {
+			nr_populated++;
+			continue;
+		}
+
+		page = __rmqueue_pcplist(zone, ac.migratetype, alloc_flags,
+					 pcp, gfp);
+		if (unlikely(!page)) {
+			/* Try and get at least one page */
+			if (!nr_populated)
+				goto failed_irq;
+			break;
+		}
+		nr_account++;
+		zone_statistics(ac.preferred_zoneref->zone, zone);
+
+		prep_new_page(page, 0, gfp, 0);
+		if (page_list)
+			list_add(&page->lru, page_list);
+		else
+			page_array[nr_populated] = page;
+		nr_populated++;
+	}
+
+	__count_zid_vm_events(PGALLOC, zone_idx(zone), nr_account);
+	local_irq_restore(flags);
+
+	return nr_populated;
+
+failed_irq:
+	local_irq_restore(flags);
+
+failed:
+	page = __alloc_pages_nodemask(gfp, 0, preferred_nid, nodemask);
+	if (page) {
+		if (page_list)
+			list_add(&page->lru, page_list);
+		else
+			page_array[nr_populated] = page;
+		nr_populated++;
+	}
+
+	return nr_populated;
+}
+EXPORT_SYMBOL_GPL(__alloc_pages_bulk);
+
 /*
  * This is the 'heart' of the zoned buddy allocator.
  */
@@ -4852,8 +5022,10 @@ __alloc_pages_nodemask(gfp_t gfp_mask, unsigned int order, int preferred_nid,
 
 	/* First allocation attempt */
 	page = get_page_from_freelist(alloc_mask, order, alloc_flags, &ac);
-	if (likely(page))
+	if (likely(page)) {
+		count_costly_fastpath(gfp_mask, order);
 		goto out;
+	}
 
 	/*
 	 * Apply scoped allocation constraints. This is mainly about GFP_NOFS
@@ -16,6 +16,7 @@
 #include <linux/gfp.h>
 #include <linux/pagemap.h>
 #include <linux/swap.h>
+#include <linux/swapfile.h>
 #include <linux/bio.h>
 #include <linux/swapops.h>
 #include <linux/buffer_head.h>
@@ -69,6 +70,10 @@ void end_swap_bio_write(struct bio *bio)
 			 MINOR(bio_dev(bio)),
 			 (unsigned long long)bio->bi_iter.bi_sector);
 		ClearPageReclaim(page);
+	} else {
+		swap_ratio_write_done(page_swap_info(page),
+				      hpage_nr_pages(page),
+				      (unsigned long)bio->bi_private);
 	}
 	end_page_writeback(page);
 	bio_put(bio);
@@ -284,6 +289,7 @@ int __swap_writepage(struct page *page, struct writeback_control *wbc,
 	struct bio *bio;
 	int ret;
 	struct swap_info_struct *sis = page_swap_info(page);
+	u64 start;
 
 	VM_BUG_ON_PAGE(!PageSwapCache(page), page);
 	if (sis->flags & SWP_FILE) {
@@ -327,8 +333,10 @@ int __swap_writepage(struct page *page, struct writeback_control *wbc,
 		return ret;
 	}
 
+	start = swap_ratio_write_start(sis);
 	ret = bdev_write_page(sis->bdev, swap_page_sector(page), page, wbc);
 	if (!ret) {
+		swap_ratio_write_done(sis, hpage_nr_pages(page), start);
 		count_swpout_vm_event(page);
 		return 0;
 	}
@@ -342,6 +350,8 @@ int __swap_writepage(struct page *page, struct writeback_control *wbc,
 		goto out;
 	}
 	bio->bi_opf = REQ_OP_WRITE | REQ_SWAP | wbc_to_write_flags(wbc);
+	/* Completion time is accounted in end_swap_bio_write() */
+	bio->bi_private = (void *)(unsigned long)start;
 	bio_associate_blkcg_from_page(bio, page);
 	count_swpout_vm_event(page);
 	set_page_writeback(page);
@@ -63,6 +63,19 @@ module_param_named(swap_eff_win, swap_eff_win, int, 0644);
 static int swap_opt_eff = 50;
 module_param_named(swap_opt_eff, swap_opt_eff, int, 0644);
 
+/*
+ * Tasks whose reclaimed pages come back quickly gain nothing from
+ * process reclaim but the swap I/O. The reclaim target of a task is
+ * scaled down by its refault ratio, the percentage of its reclaimed
+ * pages that refaulted, and the task is skipped altogether once the
+ * ratio reaches refault_skip_ratio.
+ */
+static int refault_skip_ratio = 60;
+module_param_named(refault_skip_ratio, refault_skip_ratio, int, 0644);
+
+static unsigned long skipped_refault;
+module_param_named(skipped_refault, skipped_refault, ulong, 0444);
+
 static atomic_t skip_reclaim = ATOMIC_INIT(0);
 /* Not atomic since only a single instance of swap_fn run at a time */
 static int monitor_eff;
@@ -119,6 +132,7 @@ static void swap_fn(struct work_struct *work)
 	int total_reclaimed = 0;
 	int nr_to_reclaim;
 	int efficiency;
+	int refault_ratio;
 
 	if (!tsk_nomap_swap_sz && !per_swap_size)
 		return;
@@ -186,11 +200,20 @@ static void swap_fn(struct work_struct *work)
 	rcu_read_unlock();
 
 	while (si--) {
+		refault_ratio = reclaim_task_refault_ratio(selected[si].p);
+		trace_process_reclaim_refault(selected[si].p->pid,
+				refault_ratio, refault_skip_ratio);
+		if (refault_ratio >= refault_skip_ratio) {
+			skipped_refault++;
+			goto put;
+		}
+
 		if (!per_swap_size)
 			goto nomap;
 
 		nr_to_reclaim =
 			(selected[si].tasksize * per_swap_size) / total_sz;
+		nr_to_reclaim -= (nr_to_reclaim * refault_ratio) / 100;
 		/* scan atleast a page */
 		if (!nr_to_reclaim)
 			nr_to_reclaim = 1;
@@ -205,13 +228,15 @@ static void swap_fn(struct work_struct *work)
 		total_reclaimed += rp.nr_reclaimed;
 		reclaimed_anon += rp.nr_reclaimed;
 nomap:
-		if (tsk_nomap_swap_sz)
+		if (tsk_nomap_swap_sz) {
 			nr_to_reclaim = tsk_nomap_swap_sz;
+			nr_to_reclaim -= (nr_to_reclaim * refault_ratio) / 100;
+		}
 		rp = reclaim_task_nomap(selected[si].p, nr_to_reclaim);
 		total_scan += rp.nr_scanned;
 		total_reclaimed += rp.nr_reclaimed;
 		reclaimed_nomap += rp.nr_reclaimed;
-
+put:
 		put_task_struct(selected[si].p);
 	}
 
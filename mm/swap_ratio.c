@@ -6,12 +6,23 @@
 #include <linux/mm_types.h>
 #include <linux/swapfile.h>
 #include <linux/swap.h>
+#include <linux/percpu.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #define SWAP_RATIO_GROUP_START (SWAP_FLAG_PRIO_MASK - 9) /* 32758 */
 #define SWAP_RATIO_GROUP_END (SWAP_FLAG_PRIO_MASK) /* 32767 */
-#define SWAP_FAST_WRITES	\
-	((SWAPFILE_CLUSTER * (SWAP_CLUSTER_MAX / 8)) / SWAP_BATCH)
-#define SWAP_SLOW_WRITES (SWAPFILE_CLUSTER / SWAP_BATCH)
+
+/*
+ * Number of slots a CPU allocates from the device it was handed before
+ * it goes back to the group for a new pick. Device selection, and with
+ * it swap_avail_lock, is only taken once per batch.
+ */
+#define SWAP_RATIO_BATCH	(SWAP_BATCH * 4)
+
+/* Scale of the adaptive weights, see swap_ratio_weight() */
+#define SWAP_RATIO_WEIGHT_SCALE	(NSEC_PER_MSEC * 16)
 
 /*
  * The fast/slow swap write ratio.
@@ -23,170 +34,239 @@ int sysctl_swap_ratio = 100;
 /* Enable the swap ratio feature */
 int sysctl_swap_ratio_enable;
 
-static bool is_same_group(struct swap_info_struct *a,
-		struct swap_info_struct *b)
+/*
+ * Weight the devices of a swap ratio group by their measured swap out
+ * latency instead of the static sysctl_swap_ratio split.
+ */
+int sysctl_swap_ratio_adaptive;
+
+/*
+ * A NULL device with budget left caches the lack of a swap ratio group,
+ * so that plain allocations do not take swap_avail_lock either.
+ */
+struct swap_ratio_pcp {
+	struct swap_info_struct *si;	/* device handed to this CPU */
+	int budget;			/* slots left in the current batch */
+};
+
+static DEFINE_PER_CPU(struct swap_ratio_pcp, swap_ratio_pcp);
+
+bool is_swap_ratio_group(int prio)
 {
-	if (!sysctl_swap_ratio_enable)
-		return false;
+	return ((prio >= SWAP_RATIO_GROUP_START) &&
+		(prio <= SWAP_RATIO_GROUP_END)) ? true : false;
+}
 
-	if (!is_swap_ratio_group(a->prio))
-		return false;
+static bool swap_ratio_active(struct swap_info_struct *si)
+{
+	return sysctl_swap_ratio_enable && is_swap_ratio_group(si->prio);
+}
 
-	if (a->prio == b->prio)
-		return true;
+/*
+ * Static weights split sysctl_swap_ratio between the fast
+ * (SWP_SYNCHRONOUS_IO) and slow devices. Adaptive weights are the
+ * inverse of the average swap out latency, so each device receives
+ * slots in proportion to the rate at which it can write them. Devices
+ * without samples get the minimum weight so they do get measured.
+ */
+static int swap_ratio_weight(struct swap_info_struct *si, int ratio)
+{
+	unsigned long lat;
+
+	if (!sysctl_swap_ratio_adaptive)
+		return (si->flags & SWP_SYNCHRONOUS_IO) ? ratio : 100 - ratio;
+
+	lat = READ_ONCE(si->write_lat_ns);
+	if (!lat)
+		return 1;
 
-	return false;
+	return max_t(unsigned long, SWAP_RATIO_WEIGHT_SCALE / lat, 1);
 }
 
-/* Caller must hold swap_avail_lock */
-static int calculate_write_pending(struct swap_info_struct *si,
-			struct swap_info_struct *n)
+/*
+ * Smooth weighted round robin over the devices sharing the priority of
+ * the head of the node's avail list. Caller must hold swap_avail_lock.
+ */
+static struct swap_info_struct *swap_ratio_pick(int node)
 {
+	struct plist_head *head = &swap_avail_heads[node];
+	struct swap_info_struct *si, *best = NULL;
 	int ratio = sysctl_swap_ratio;
+	int total = 0, nr = 0;
+	int prio, weight;
 
 	if ((ratio < 0) || (ratio > 100))
-		return -EINVAL;
+		return NULL;
 
-	if (WARN_ON(!(si->flags & SWP_SYNCHRONOUS_IO)))
-		return -ENODEV;
+	if (plist_head_empty(head))
+		return NULL;
 
-	if ((n->flags & SWP_SYNCHRONOUS_IO) || !is_same_group(si, n))
-		return -ENODEV;
+	si = plist_first_entry(head, struct swap_info_struct,
+			       avail_lists[node]);
+	if (!swap_ratio_active(si))
+		return NULL;
 
-	si->max_writes = ratio ? SWAP_FAST_WRITES : 0;
-	n->max_writes  = ratio ? (SWAP_FAST_WRITES * 100) /
-			ratio - SWAP_FAST_WRITES : SWAP_SLOW_WRITES;
+	prio = si->prio;
+	plist_for_each_entry(si, head, avail_lists[node]) {
+		if (si->prio != prio || ++nr == 2)
+			break;
+	}
 
-	si->write_pending = si->max_writes;
-	n->write_pending = n->max_writes;
+	/* No other swap device */
+	if (nr < 2)
+		return NULL;
 
-	return 0;
+	plist_for_each_entry(si, head, avail_lists[node]) {
+		if (si->prio != prio)
+			break;
+
+		weight = swap_ratio_weight(si, ratio);
+		if (!weight)
+			continue;
+
+		si->ratio_credit += weight;
+		total += weight;
+		if (!best || si->ratio_credit > best->ratio_credit)
+			best = si;
+	}
+
+	if (!best)
+		return NULL;
+
+	best->ratio_credit -= total;
+	best->ratio_picks++;
+
+	return best;
 }
 
-static int swap_ratio_slow(struct swap_info_struct **si, int node)
+/*
+ * Select the device of the swap ratio group that @n_goal slots are
+ * allocated from. Called without swap_avail_lock; the lock is only
+ * taken when the per-CPU batch runs out.
+ */
+int swap_ratio(struct swap_info_struct **si, int node, int n_goal)
 {
-	struct swap_info_struct *n = NULL;
+	struct swap_ratio_pcp *pcp;
+	struct swap_info_struct *n;
 	int ret = 0;
 
-	spin_lock(&(*si)->lock);
-	spin_lock(&swap_avail_lock);
-	if (&(*si)->avail_lists[node] == plist_last(&swap_avail_heads[node])) {
-		/* just to make skip work */
-		n = *si;
+	if (!sysctl_swap_ratio_enable)
+		return -ENODEV;
+
+	pcp = get_cpu_ptr(&swap_ratio_pcp);
+	n = pcp->si;
+	if (!n && pcp->budget > 0) {
+		pcp->budget -= n_goal;
 		ret = -ENODEV;
-		goto skip;
+		goto out;
 	}
-	n = plist_next_entry(&(*si)->avail_lists[node],
-			struct swap_info_struct,
-			avail_lists[node]);
-	if (n == *si) {
-		/* No other swap device */
-		ret = -ENODEV;
-		goto skip;
+	if (n && pcp->budget > 0 && (n->flags & SWP_WRITEOK) &&
+	    !plist_node_empty(&n->avail_lists[node]) &&
+	    swap_ratio_active(n)) {
+		pcp->budget -= n_goal;
+		*si = n;
+		goto out;
 	}
 
-	spin_unlock(&swap_avail_lock);
-	spin_lock(&n->lock);
 	spin_lock(&swap_avail_lock);
+	n = swap_ratio_pick(node);
+	spin_unlock(&swap_avail_lock);
 
-	if ((*si)->flags & SWP_SYNCHRONOUS_IO) {
-		if ((*si)->write_pending) {
-			(*si)->write_pending--;
-			goto exit;
-		} else {
-			if ((n->flags & SWP_SYNCHRONOUS_IO) ||
-			     !is_same_group(*si, n)) {
-				/* Should never happen */
-				ret = -ENODEV;
-			} else if (n->write_pending) {
-				/*
-				 * Requeue fast device, since there are pending
-				 * writes for slow device.
-				 */
-				plist_requeue(&(*si)->avail_lists[node],
-					&swap_avail_heads[node]);
-				n->write_pending--;
-				spin_unlock(&(*si)->lock);
-				*si = n;
-				goto skip;
-			} else {
-				if (calculate_write_pending(*si, n) < 0) {
-					ret = -ENODEV;
-					goto exit;
-				}
-				/* Restart from fast device */
-				(*si)->write_pending--;
-			}
-		}
-	} else {
-		if (!(n->flags & SWP_SYNCHRONOUS_IO) ||
-		      !is_same_group(*si, n)) {
-			/* Should never happen */
-			ret = -ENODEV;
-		} else if (n->write_pending) {
-			/*
-			 * Pending writes for fast device.
-			 * We reach here when slow device is swapped on first,
-			 * before fast device.
-			 */
-			/* requeue slow device to the end */
-			plist_requeue(&(*si)->avail_lists[node],
-					&swap_avail_heads[node]);
-			n->write_pending--;
-			spin_unlock(&(*si)->lock);
-			*si = n;
-			goto skip;
-		} else {
-			if ((*si)->write_pending) {
-				(*si)->write_pending--;
-			} else {
-				if (calculate_write_pending(n, *si) < 0) {
-					ret = -ENODEV;
-					goto exit;
-				}
-				n->write_pending--;
-				plist_requeue(&(*si)->avail_lists[node],
-					&swap_avail_heads[node]);
-				spin_unlock(&(*si)->lock);
-				*si = n;
-				goto skip;
-			}
-		}
+	pcp->si = n;
+	pcp->budget = SWAP_RATIO_BATCH - n_goal;
+	if (!n) {
+		ret = -ENODEV;
+		goto out;
 	}
-exit:
-	spin_unlock(&(*si)->lock);
-skip:
-	spin_unlock(&swap_avail_lock);
-	/* n and si would have got interchanged */
-	spin_unlock(&n->lock);
+	*si = n;
+out:
+	put_cpu_ptr(&swap_ratio_pcp);
 	return ret;
 }
 
-bool is_swap_ratio_group(int prio)
-{
-	return ((prio >= SWAP_RATIO_GROUP_START) &&
-		(prio <= SWAP_RATIO_GROUP_END)) ? true : false;
-}
-
 void setup_swap_ratio(struct swap_info_struct *p, int prio)
 {
 	/* Used only if sysctl_swap_ratio_enable is set */
 	if (is_swap_ratio_group(prio)) {
-		if (p->flags & SWP_SYNCHRONOUS_IO)
-			p->write_pending = SWAP_FAST_WRITES;
-		else
-			p->write_pending = SWAP_SLOW_WRITES;
-		p->max_writes =  p->write_pending;
+		p->ratio_credit = 0;
+		p->ratio_picks = 0;
+		p->write_lat_ns = 0;
+		atomic64_set(&p->write_bytes, 0);
 	}
 }
 
-int swap_ratio(struct swap_info_struct **si, int node)
+/* Returns the start time of a swap out to be timed, 0 if not tracked */
+u64 swap_ratio_write_start(struct swap_info_struct *si)
 {
-	if (!sysctl_swap_ratio_enable)
-		return -ENODEV;
+	if (!swap_ratio_active(si))
+		return 0;
 
-	if (is_swap_ratio_group((*si)->prio))
-		return swap_ratio_slow(si, node);
-	else
-		return -ENODEV;
+	return ktime_get_ns();
+}
+
+void swap_ratio_write_done(struct swap_info_struct *si, int nr_pages,
+			   u64 start)
+{
+	unsigned long lat, avg;
+
+	if (!start)
+		return;
+
+	atomic64_add((u64)nr_pages << PAGE_SHIFT, &si->write_bytes);
+
+	/*
+	 * Per page latency, averaged with a 1/8 weight for the new sample.
+	 * @start may have been truncated to a long by the bio path, so the
+	 * delta is taken modulo unsigned long as well.
+	 */
+	lat = (unsigned long)(ktime_get_ns() - start) / nr_pages;
+	lat = max(lat, 1UL);
+	avg = READ_ONCE(si->write_lat_ns);
+	avg = avg ? avg - (avg >> 3) + (lat >> 3) : lat;
+	WRITE_ONCE(si->write_lat_ns, avg);
+}
+
+#ifdef CONFIG_DEBUG_FS
+static int swap_ratio_stats_show(struct seq_file *m, void *v)
+{
+	struct swap_info_struct *si;
+	int ratio = sysctl_swap_ratio;
+
+	seq_puts(m, "type\tprio\tsync\tbytes\t\tlat_ns\tweight\tpicks\n");
+	spin_lock(&swap_lock);
+	plist_for_each_entry(si, &swap_active_head, list) {
+		if (!is_swap_ratio_group(si->prio))
+			continue;
+
+		seq_printf(m, "%d\t%d\t%d\t%-16lld%lu\t%d\t%lu\n",
+			   si->type, si->prio,
+			   !!(si->flags & SWP_SYNCHRONOUS_IO),
+			   (long long)atomic64_read(&si->write_bytes),
+			   READ_ONCE(si->write_lat_ns),
+			   swap_ratio_weight(si, ratio), si->ratio_picks);
+	}
+	spin_unlock(&swap_lock);
+
+	return 0;
+}
+
+static int swap_ratio_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, swap_ratio_stats_show, NULL);
+}
+
+static const struct file_operations swap_ratio_stats_fops = {
+	.open		= swap_ratio_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init swap_ratio_debugfs_init(void)
+{
+	debugfs_create_file("swap_ratio", 0444, NULL, NULL,
+			    &swap_ratio_stats_fops);
+	return 0;
 }
+late_initcall(swap_ratio_debugfs_init);
+#endif
@@ -956,7 +956,6 @@ int get_swap_pages(int n_goal, swp_entry_t swp_entries[], int entry_size)
 	long avail_pgs;
 	int n_ret = 0;
 	int node;
-	int swap_ratio_off = 0;
 
 	/* Only single cluster request supported */
 	WARN_ON_ONCE(n_goal > 1 && size == SWAPFILE_CLUSTER);
@@ -973,30 +972,21 @@ int get_swap_pages(int n_goal, swp_entry_t swp_entries[], int entry_size)
 
 	atomic_long_sub(n_goal * size, &nr_swap_pages);
 
-lock_and_start:
+	/*
+	 * Let the swap ratio group pick the device. Should it fail to
+	 * provide slots, the list walk below is used as a fallback.
+	 */
+	node = numa_node_id();
+	if (sysctl_swap_ratio_enable && !swap_ratio(&si, node, n_goal * size)) {
+		next = si;
+		goto start;
+	}
+
 	spin_lock(&swap_avail_lock);
 
 start_over:
 	node = numa_node_id();
 	plist_for_each_entry_safe(si, next, &swap_avail_heads[node], avail_lists[node]) {
-
-		if (sysctl_swap_ratio && !swap_ratio_off) {
-			int ret;
-
-			spin_unlock(&swap_avail_lock);
-			ret = swap_ratio(&si, node);
-			if (ret < 0) {
-				/*
-				 * Error. Start again with swap
-				 * ratio disabled.
-				 */
-				swap_ratio_off = 1;
-				goto lock_and_start;
-			} else {
-				goto start;
-			}
-		}
-
 		/* requeue si to after same-priority siblings */
 		plist_requeue(&si->avail_lists[node], &swap_avail_heads[node]);
 		spin_unlock(&swap_avail_lock);
@@ -1584,14 +1584,23 @@ unsigned long reclaim_pages_from_list(struct list_head *page_list,
 	unsigned long nr_reclaimed;
 	struct page *page;
 
-	list_for_each_entry(page, page_list, lru)
+	/*
+	 * Pages evicted from a task's mappings are remembered in its mm,
+	 * so that their refaults can be told from the others.
+	 */
+	list_for_each_entry(page, page_list, lru) {
 		ClearPageActive(page);
+		if (vma)
+			mm_reclaim_mark(vma->vm_mm, page, true);
+	}
 
 	nr_reclaimed = shrink_page_list(page_list, NULL, &sc,
 			TTU_IGNORE_ACCESS, NULL, true);
 
 	while (!list_empty(page_list)) {
 		page = lru_to_page(page_list);
+		if (vma)
+			mm_reclaim_mark(vma->vm_mm, page, false);
 		list_del(&page->lru);
 		dec_node_page_state(page, NR_ISOLATED_ANON +
 				page_is_file_cache(page));
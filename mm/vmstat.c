@@ -1081,6 +1081,24 @@ int fragmentation_index(struct zone *zone, unsigned int order)
 	fill_contig_page_info(zone, order, &info);
 	return __fragmentation_index(order, &info);
 }
+
+/*
+ * Calculates external fragmentation within a zone wrt the given order.
+ * It is defined as the percentage of pages found in blocks of size
+ * less than 1 << order. It returns values in range [0, 100].
+ */
+unsigned int extfrag_for_order(struct zone *zone, unsigned int order)
+{
+	struct contig_page_info info;
+
+	fill_contig_page_info(zone, order, &info);
+	if (info.free_pages == 0)
+		return 0;
+
+	return div_u64((info.free_pages -
+			(info.free_blocks_suitable << order)) * 100,
+			info.free_pages);
+}
 #endif
 
 #if defined(CONFIG_PROC_FS) || defined(CONFIG_SYSFS) || defined(CONFIG_NUMA)
@@ -1240,6 +1258,9 @@ const char * const vmstat_text[] = {
 	"compact_daemon_wake",
 	"compact_daemon_migrate_scanned",
 	"compact_daemon_free_scanned",
+	"compact_daemon_proactive_wake",
+	"compact_daemon_proactive_throttle",
+	"compact_costly_fastpath",
 #endif
 
 #ifdef CONFIG_HUGETLB_PAGE
@@ -1298,6 +1319,14 @@ const char * const vmstat_text[] = {
 #ifdef CONFIG_SPECULATIVE_PAGE_FAULT
 	"speculative_pgfault_anon",
 	"speculative_pgfault_file",
+	"speculative_pgfault_swap",
+	"speculative_pgfault_anon_abort",
+	"speculative_pgfault_file_abort",
+	"speculative_pgfault_swap_abort",
+	"speculative_pgfault_vma_changed",
+	"speculative_pgfault_vma_notsup",
+	"speculative_pgfault_pgtable",
+	"speculative_pgfault_pte_lock",
 #endif
 #endif /* CONFIG_VM_EVENT_COUNTERS */
 };
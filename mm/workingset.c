@@ -305,6 +305,7 @@ void workingset_refault(struct page *page, void *shadow)
 	refault_distance = (refault - eviction) & EVICTION_MASK;
 
 	inc_lruvec_state(lruvec, WORKINGSET_REFAULT);
+	mm_reclaim_refault(current->mm, page->mapping, page->index);
 
 	/*
 	 * Compare the distance to the existing workingset size. We
@@ -0,0 +1,55 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0
+#
+# Throughput of the blk-crypto fallback, with and without spreading the
+# en/decryption of large bios over CPUs.
+#
+# A dm-default-key device is set up over a null_blk device, which has no
+# inline encryption support, so that every bio goes through the fallback.
+# Sequential reads and writes are then timed for each value of the
+# parallel_units parameter given, 0 meaning one CPU per bio.
+#
+# Usage: blk_crypto_fallback_bench.sh [size_mb [bs_kb [parallel_units...]]]
+
+. "$(dirname "$0")/common.sh"
+
+SIZE_MB=${1:-1024}
+BS_KB=${2:-1024}
+[ $# -gt 2 ] && shift 2 && UNITS=$*
+UNITS=${UNITS:-"0 32"}
+
+PARAM=/sys/module/blk_crypto_fallback/parameters/parallel_units
+DM=blk-crypto-bench
+
+cleanup()
+{
+	[ -n "$SAVED" ] && echo "$SAVED" > $PARAM
+	dmsetup remove $DM 2>/dev/null
+	cleanup_null_blk
+}
+
+require dmsetup
+[ -w $PARAM ] || die "$PARAM: not found, is CONFIG_BLK_INLINE_ENCRYPTION_FALLBACK set?"
+
+SAVED=$(cat $PARAM)
+trap cleanup EXIT
+
+setup_null_blk gb=$(( (SIZE_MB + 1023) / 1024 )) irqmode=0
+setup_default_key $DM $DEV
+
+run()
+{
+	# dd prints the throughput last on its summary line
+	dd "$@" 2>&1 | awk 'END { print $(NF - 1), $NF }'
+}
+
+printf "%-16s %-16s %s\n" parallel_units write read
+for units in $UNITS; do
+	echo "$units" > $PARAM || die "cannot set parallel_units to $units"
+
+	w=$(run if=/dev/zero of=$DEV bs=${BS_KB}k \
+		count=$(( SIZE_MB * 1024 / BS_KB )) oflag=direct)
+	r=$(run if=$DEV of=/dev/null bs=${BS_KB}k iflag=direct)
+
+	printf "%-16s %-16s %s\n" "$units" "$w" "$r"
+done
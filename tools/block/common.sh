@@ -0,0 +1,107 @@
+# SPDX-License-Identifier: GPL-2.0
+#
+# Helpers shared by the block layer benchmarks, sourced with
+#
+#	. "$(dirname "$0")/common.sh"
+#
+# Scripts define their own cleanup() and set the EXIT trap once the state
+# it undoes exists.
+
+die()
+{
+	echo "$*" >&2
+	exit 1
+}
+
+# Fail unless run as root with all the given commands available
+require()
+{
+	[ "$(id -u)" = 0 ] || die "must be run as root"
+	for cmd in "$@"; do
+		command -v $cmd >/dev/null || die "$cmd not found"
+	done
+}
+
+# Load null_blk with one 4k blk-mq device, extra parameters appended, and
+# point DEV at it. NULLB is set so that cleanup_null_blk() unloads it.
+setup_null_blk()
+{
+	modprobe null_blk nr_devices=1 bs=4096 queue_mode=2 "$@" ||
+		die "cannot load null_blk"
+	NULLB=1
+	DEV=/dev/nullb0
+}
+
+cleanup_null_blk()
+{
+	[ -n "$NULLB" ] && modprobe -r null_blk 2>/dev/null
+	NULLB=
+}
+
+# Set up dm-default-key device $1 with a fixed AES-XTS key over device $2,
+# and point DEV at it
+setup_default_key()
+{
+	key=$(printf "%064d%064d" 0 1)
+	sectors=$(blockdev --getsz $2)
+	echo "0 $sectors default-key aes-xts-plain64 $key 0 $2 0 2 sector_size:4096 iv_large_sectors" |
+		dmsetup create $1 || die "cannot create the dm-default-key device"
+	DEV=/dev/mapper/$1
+}
+
+# IOPS of all the jobs of a fio run with --rw=$1, the other fio options
+# following, taken from the read or the write part of its terse output
+fio_iops()
+{
+	rw=$1
+	shift
+	field=8
+	case $rw in
+	*write)
+		field=49
+		;;
+	esac
+
+	fio --name=bench --rw=$rw "$@" --group_reporting --minimal |
+		cut -d';' -f$field
+}
+
+# Name of the disk of block device $1, a partition resolving to its disk
+disk_name()
+{
+	name=$(basename $(readlink -f $1))
+	[ -d /sys/block/$name ] ||
+		name=$(basename $(readlink -f /sys/class/block/$name/..))
+	echo $name
+}
+
+# Set CGROOT to the cgroup2 root if it has the io controller, to the root
+# of the v1 blkio hierarchy otherwise, and CGPFX to the prefix of the
+# files of the controller
+cgroup_setup()
+{
+	if grep -qw io /sys/fs/cgroup/cgroup.controllers 2>/dev/null; then
+		CGROOT=/sys/fs/cgroup
+		echo +io > $CGROOT/cgroup.subtree_control
+		CGPFX=io
+	else
+		CGROOT=$(awk '$3 == "cgroup" && $4 ~ /blkio/ { print $2; exit }' /proc/mounts)
+		CGPFX=blkio
+	fi
+	[ -n "$CGROOT" ] || die "no blkio cgroup hierarchy mounted"
+}
+
+# Run a command in cgroup $1 below CGROOT
+run_in()
+{
+	cg=$1
+	shift
+	sh -c 'echo $$ > '$CGROOT/$cg'/cgroup.procs && exec "$@"' sh "$@"
+}
+
+# Completion latency percentile $2 (e.g. 99.000000) of the terse fio
+# output $1, in usec
+fio_percentile()
+{
+	echo "$1" | tr ';' '\n' | grep -m1 "^$2%=" | cut -d= -f2
+}
@@ -0,0 +1,54 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0
+#
+# IOPS scaling of concurrent submitters sharing one inline encryption key.
+#
+# A dm-default-key device is set up over a null_blk device, so that every
+# bio gets its keyslot from the keyslot manager of the blk-crypto fallback,
+# and 4k random reads and writes are issued by an increasing number of fio
+# jobs, each one bound to its own CPU. With keys in use grabbed without the
+# keyslot manager lock, IOPS should grow about linearly with the number of
+# jobs until the CPUs or the fallback crypto are saturated.
+#
+# Usage: keyslot_scaling.sh [runtime_s [jobs...]]
+
+. "$(dirname "$0")/common.sh"
+
+RUNTIME=${1:-10}
+[ $# -gt 1 ] && shift && JOBS=$*
+NR_CPUS=$(nproc)
+JOBS=${JOBS:-$(n=1; while [ $n -le $NR_CPUS ]; do echo $n; n=$((n * 2)); done)}
+
+DM=keyslot-scaling
+
+cleanup()
+{
+	dmsetup remove $DM 2>/dev/null
+	cleanup_null_blk
+}
+
+require dmsetup fio
+
+trap cleanup EXIT
+
+setup_null_blk gb=4 irqmode=0 submit_queues=$NR_CPUS
+setup_default_key $DM $DEV
+
+iops()
+{
+	fio_iops $1 --filename=$DEV --bs=4k --direct=1 --ioengine=libaio \
+		--iodepth=16 --numjobs=$2 --cpus_allowed_policy=split \
+		--cpus_allowed=0-$((NR_CPUS - 1)) --time_based \
+		--runtime=$RUNTIME
+}
+
+printf "%-6s %-12s %-8s %-12s %s\n" jobs read scaling write scaling
+for jobs in $JOBS; do
+	r=$(iops randread $jobs)
+	w=$(iops randwrite $jobs)
+	[ -z "$r1" ] && r1=$r && w1=$w
+
+	printf "%-6s %-12s %-8s %-12s %s\n" $jobs $r \
+		$(awk "BEGIN { printf \"%.2f\", $r / ($r1 ? $r1 : 1) }") $w \
+		$(awk "BEGIN { printf \"%.2f\", $w / ($w1 ? $w1 : 1) }")
+done
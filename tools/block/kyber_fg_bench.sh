@@ -0,0 +1,66 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0
+#
+# Latency of foreground reads under background write saturation with kyber.
+#
+# Random 4k reads at queue depth 1 run in a "fg" blkcg while direct
+# sequential writers saturate the device from a "bg" blkcg, first with fg
+# in the best effort priority class then in the foreground one. The p50
+# and p99 completion latencies of the reads are reported for both.
+#
+# Without a device, a null_blk device is set up with a timer completion
+# and a shallow queue, so that writes and reads contend for it.
+#
+# Usage: kyber_fg_bench.sh [device [runtime_s]]
+
+. "$(dirname "$0")/common.sh"
+
+DEV=$1
+RUNTIME=${2:-30}
+
+cleanup()
+{
+	[ -n "$BG_PID" ] && kill $BG_PID 2>/dev/null && wait $BG_PID 2>/dev/null
+	rmdir $CGROOT/fg $CGROOT/bg 2>/dev/null
+	cleanup_null_blk
+}
+
+require fio
+
+[ -z "$DEV" ] && setup_null_blk gb=8 irqmode=2 completion_nsec=100000 \
+	hw_queue_depth=32
+
+NAME=$(disk_name $DEV)
+echo kyber > /sys/block/$NAME/queue/scheduler ||
+	die "$NAME: cannot switch to kyber"
+
+cgroup_setup
+PRIO=$CGPFX.kyber.prio_class
+
+trap cleanup EXIT
+mkdir -p $CGROOT/fg $CGROOT/bg
+[ -f $CGROOT/fg/$PRIO ] || die "$PRIO: not found, is kyber built with CONFIG_BLK_CGROUP?"
+
+printf "%-12s %-10s %s\n" prio_class p50_usec p99_usec
+for class in 0 1; do
+	echo $class > $CGROOT/fg/$PRIO || die "cannot set $PRIO"
+
+	run_in bg fio --name=bg --filename=$DEV --rw=write --bs=128k --direct=1 \
+		--ioengine=libaio --iodepth=32 --numjobs=4 --offset_increment=1g \
+		--size=1g --time_based --runtime=$((RUNTIME + 5)) \
+		>/dev/null 2>&1 &
+	BG_PID=$!
+	sleep 2
+
+	out=$(run_in fg fio --name=fg --filename=$DEV --rw=randread --bs=4k \
+		--direct=1 --ioengine=psync --time_based --runtime=$RUNTIME \
+		--minimal)
+
+	kill $BG_PID 2>/dev/null
+	wait $BG_PID 2>/dev/null
+	BG_PID=
+
+	printf "%-12s %-10s %s\n" $class \
+		"$(fio_percentile "$out" 50.000000)" \
+		"$(fio_percentile "$out" 99.000000)"
+done
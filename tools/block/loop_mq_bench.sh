@@ -0,0 +1,62 @@
+#!/bin/sh
+# SPDX-License-Identifier: GPL-2.0
+#
+# 4k random read and write IOPS at queue depth 32 on a loop device in direct
+# I/O mode, with one hardware queue and worker and then with several.
+#
+# A backing file is created in dir, which should be on a fast device, and
+# the loop driver is reloaded with each hw_queues value given. The load is
+# spread over 4 fio jobs bound to different CPUs, so that their requests
+# are mapped to different hardware queues.
+#
+# Usage: loop_mq_bench.sh dir [size_mb [runtime_s [hw_queues...]]]
+
+. "$(dirname "$0")/common.sh"
+
+DIR=$1
+SIZE_MB=${2:-1024}
+RUNTIME=${3:-10}
+[ $# -gt 3 ] && shift 3 && QUEUES=$*
+QUEUES=${QUEUES:-"1 $(nproc)"}
+
+JOBS=4
+FILE=$DIR/loop-mq-bench.img
+
+cleanup()
+{
+	[ -n "$LOOP" ] && losetup -d $LOOP 2>/dev/null
+	rm -f $FILE
+}
+
+require fio losetup
+[ -d "$DIR" ] || die "usage: $0 dir [size_mb [runtime_s [hw_queues...]]]"
+[ -d /sys/module/loop ] && [ ! -f /sys/module/loop/initstate ] &&
+	die "loop is built in, it cannot be reloaded with another hw_queues"
+
+trap cleanup EXIT
+dd if=/dev/zero of=$FILE bs=1M count=$SIZE_MB status=none ||
+	die "cannot create $FILE"
+
+iops()
+{
+	fio_iops $1 --filename=$LOOP --bs=4k --direct=1 --ioengine=libaio \
+		--iodepth=$((32 / JOBS)) --numjobs=$JOBS \
+		--cpus_allowed=0-$(($(nproc) - 1)) --cpus_allowed_policy=split \
+		--time_based --runtime=$RUNTIME
+}
+
+printf "%-10s %-12s %s\n" hw_queues read write
+for queues in $QUEUES; do
+	modprobe -r loop 2>/dev/null
+	modprobe loop hw_queues=$queues || die "cannot load loop"
+	[ "$(cat /sys/module/loop/parameters/hw_queues)" = "$queues" ] ||
+		echo "hw_queues clamped to $(cat /sys/module/loop/parameters/hw_queues)" >&2
+
+	LOOP=$(losetup --direct-io=on --show -f $FILE) ||
+		die "cannot set up a loop device on $FILE"
+
+	printf "%-10s %-12s %s\n" $queues $(iops randread) $(iops randwrite)
+
+	losetup -d $LOOP
+	LOOP=
+done
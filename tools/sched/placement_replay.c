@@ -0,0 +1,379 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Replay of the energy aware wakeup placement log.
+ *
+ * Reads the records of <tracefs>/sched_placement/cpuN, as saved by e.g.
+ *
+ *	cat /sys/kernel/tracing/sched_placement/cpu0 > cpu0.bin
+ *
+ * and re-runs the energy minimizing choice over the recorded candidate
+ * CPUs against an energy model description. The recorded and replayed
+ * placements are compared on the estimated energy and on two latency
+ * proxies: placements on a CPU that was not idle and placements that
+ * leave the CPU over utilized.
+ *
+ * The energy model file lists the performance domains, each one with its
+ * CPUs followed by its capacity states, in increasing frequency order:
+ *
+ *	pd 0-3
+ *	300000 12
+ *	1000000 80
+ *	pd 4-7
+ *	...
+ *
+ * The estimates mirror em_pd_energy() and map_util_freq() of the kernel.
+ */
+#include <errno.h>
+#include <getopt.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../../include/uapi/linux/sched/placement.h"
+
+#define MAX_PD		SCHED_PLACEMENT_MAX_CPUS
+#define MAX_CAP_STATES	32
+
+/* Same margin as capacity_margin in kernel/sched/fair.c */
+#define CAPACITY_MARGIN	1280
+
+struct cap_state {
+	unsigned long frequency;
+	unsigned long power;
+	unsigned long cost;
+};
+
+struct perf_domain {
+	uint64_t cpus;
+	int nr_cap_states;
+	struct cap_state table[MAX_CAP_STATES];
+};
+
+struct replay_stats {
+	unsigned long records;
+	unsigned long skipped;
+	unsigned long differ;
+	unsigned long long energy;
+	unsigned long busy;
+	unsigned long overutil;
+};
+
+static struct perf_domain pds[MAX_PD];
+static int nr_pds;
+static int opt_verbose;
+static int opt_margin = 1;
+
+static void fatal(const char *x, ...)
+{
+	va_list ap;
+
+	va_start(ap, x);
+	vfprintf(stderr, x, ap);
+	va_end(ap);
+	exit(EXIT_FAILURE);
+}
+
+static uint64_t parse_cpus(const char *s, int line)
+{
+	uint64_t mask = 0;
+	char *end;
+	long a, b;
+
+	while (*s) {
+		a = strtol(s, &end, 10);
+		if (end == s)
+			fatal("line %d: bad CPU list\n", line);
+		b = a;
+		if (*end == '-') {
+			s = end + 1;
+			b = strtol(s, &end, 10);
+			if (end == s)
+				fatal("line %d: bad CPU range\n", line);
+		}
+		if (a < 0 || b < a || b >= SCHED_PLACEMENT_MAX_CPUS)
+			fatal("line %d: CPU out of range\n", line);
+		for (; a <= b; a++)
+			mask |= 1ULL << a;
+		s = end;
+		if (*s == ',')
+			s++;
+		else if (*s && *s != '\n')
+			fatal("line %d: bad CPU list\n", line);
+		else
+			break;
+	}
+
+	return mask;
+}
+
+static void parse_model(const char *path)
+{
+	struct perf_domain *pd = NULL;
+	unsigned long freq, power, fmax;
+	char buf[256];
+	int line = 0;
+	FILE *f;
+	int i, j;
+
+	f = fopen(path, "r");
+	if (!f)
+		fatal("%s: %s\n", path, strerror(errno));
+
+	while (fgets(buf, sizeof(buf), f)) {
+		line++;
+		if (buf[0] == '#' || buf[0] == '\n')
+			continue;
+
+		if (!strncmp(buf, "pd ", 3)) {
+			if (nr_pds == MAX_PD)
+				fatal("line %d: too many domains\n", line);
+			pd = &pds[nr_pds++];
+			pd->cpus = parse_cpus(buf + 3, line);
+			continue;
+		}
+
+		if (!pd)
+			fatal("line %d: capacity state outside a domain\n",
+			      line);
+		if (sscanf(buf, "%lu %lu", &freq, &power) != 2 || !freq)
+			fatal("line %d: expected \"freq power\"\n", line);
+		if (pd->nr_cap_states == MAX_CAP_STATES)
+			fatal("line %d: too many capacity states\n", line);
+		if (pd->nr_cap_states &&
+		    freq <= pd->table[pd->nr_cap_states - 1].frequency)
+			fatal("line %d: frequencies must increase\n", line);
+
+		pd->table[pd->nr_cap_states].frequency = freq;
+		pd->table[pd->nr_cap_states].power = power;
+		pd->nr_cap_states++;
+	}
+	fclose(f);
+
+	if (!nr_pds)
+		fatal("%s: no performance domain\n", path);
+
+	/* Same as em_create_pd() */
+	for (i = 0; i < nr_pds; i++) {
+		pd = &pds[i];
+		if (!pd->nr_cap_states)
+			fatal("%s: domain %d has no capacity state\n", path, i);
+		fmax = pd->table[pd->nr_cap_states - 1].frequency;
+		for (j = 0; j < pd->nr_cap_states; j++)
+			pd->table[j].cost = fmax * pd->table[j].power /
+					    pd->table[j].frequency;
+	}
+}
+
+static unsigned long map_util_freq(unsigned long util, unsigned long freq,
+				   unsigned long cap)
+{
+	return (freq + (freq >> 2)) * util / cap;
+}
+
+static unsigned long pd_energy(struct perf_domain *pd, unsigned long scale_cpu,
+			       unsigned long max_util, unsigned long sum_util)
+{
+	struct cap_state *cs;
+	unsigned long freq;
+	int i;
+
+	if (!sum_util || !scale_cpu)
+		return 0;
+
+	cs = &pd->table[pd->nr_cap_states - 1];
+	freq = map_util_freq(max_util, cs->frequency, scale_cpu);
+
+	for (i = 0; i < pd->nr_cap_states; i++) {
+		cs = &pd->table[i];
+		if (cs->frequency >= freq)
+			break;
+	}
+
+	return cs->cost * sum_util / scale_cpu;
+}
+
+/* Energy of the system with the task of @rec on @dst_cpu */
+static unsigned long compute_energy(const struct sched_placement_rec *rec,
+				    int dst_cpu)
+{
+	unsigned long energy = 0, util, cap, max_util, sum_util, scale_cpu;
+	int i, cpu;
+
+	for (i = 0; i < nr_pds; i++) {
+		max_util = sum_util = scale_cpu = 0;
+
+		for (cpu = 0; cpu < rec->nr_cpus; cpu++) {
+			if (!(pds[i].cpus & (1ULL << cpu)))
+				continue;
+
+			cap = rec->cpu[cpu].capacity;
+			util = rec->cpu[cpu].util;
+			if (cpu == dst_cpu)
+				util += rec->task_util;
+
+			scale_cpu = cap;
+			sum_util += util < cap ? util : cap;
+			if (util > max_util)
+				max_util = util;
+		}
+
+		energy += pd_energy(&pds[i], scale_cpu, max_util, sum_util);
+	}
+
+	return energy;
+}
+
+static int replay_cpu(const struct sched_placement_rec *rec)
+{
+	unsigned long prev_energy, best_energy, energy;
+	int cpu, prev_cpu = rec->prev_cpu, best_cpu;
+
+	if (prev_cpu < 0 || prev_cpu >= rec->nr_cpus)
+		return rec->target_cpu;
+
+	prev_energy = best_energy = compute_energy(rec, prev_cpu);
+	best_cpu = prev_cpu;
+
+	for (cpu = 0; cpu < rec->nr_cpus; cpu++) {
+		if (cpu == prev_cpu || !(rec->candidates & (1ULL << cpu)))
+			continue;
+
+		energy = compute_energy(rec, cpu);
+		if (energy < best_energy) {
+			best_energy = energy;
+			best_cpu = cpu;
+		}
+	}
+
+	/* Same bias towards prev_cpu as find_energy_efficient_cpu() */
+	if (opt_margin && (prev_energy - best_energy) <= prev_energy >> 4)
+		best_cpu = prev_cpu;
+
+	return best_cpu;
+}
+
+static void account(struct replay_stats *s,
+		    const struct sched_placement_rec *rec, int cpu)
+{
+	const struct sched_placement_cpu *c = &rec->cpu[cpu];
+
+	s->records++;
+	s->energy += compute_energy(rec, cpu);
+	if (c->idle_idx < 0 || c->nr_running)
+		s->busy++;
+	if ((unsigned long)(c->util + rec->task_util) * CAPACITY_MARGIN >
+	    (unsigned long)c->capacity * 1024)
+		s->overutil++;
+}
+
+static void replay_file(const char *path, struct replay_stats *recorded,
+			struct replay_stats *replayed)
+{
+	struct sched_placement_rec rec;
+	int target, cpu;
+	FILE *f;
+
+	f = fopen(path, "rb");
+	if (!f)
+		fatal("%s: %s\n", path, strerror(errno));
+
+	while (fread(&rec, sizeof(rec), 1, f) == 1) {
+		target = rec.target_cpu;
+		if (!(rec.flags & SCHED_PLACEMENT_F_ENERGY) ||
+		    rec.nr_cpus > SCHED_PLACEMENT_MAX_CPUS ||
+		    target < 0 || target >= rec.nr_cpus) {
+			/* Fast path decisions: nothing to replay */
+			recorded->skipped++;
+			continue;
+		}
+
+		cpu = replay_cpu(&rec);
+		account(recorded, &rec, target);
+		account(replayed, &rec, cpu);
+		if (cpu != target)
+			replayed->differ++;
+
+		if (opt_verbose)
+			printf("%llu pid %d util %u prev %d target %d replay %d energy %lu/%lu\n",
+			       (unsigned long long)rec.ts, rec.pid,
+			       rec.task_util, rec.prev_cpu, target, cpu,
+			       compute_energy(&rec, target),
+			       compute_energy(&rec, cpu));
+	}
+
+	if (ferror(f))
+		fatal("%s: read error\n", path);
+	fclose(f);
+}
+
+static void show_stats(const char *name, const struct replay_stats *s)
+{
+	unsigned long n = s->records ? s->records : 1;
+
+	printf("%-10s energy %-14llu busy %-8lu (%3lu%%) overutil %-8lu (%3lu%%)\n",
+	       name, s->energy, s->busy, s->busy * 100 / n, s->overutil,
+	       s->overutil * 100 / n);
+}
+
+static void usage(void)
+{
+	printf(
+"placement_replay [options] cpuN...\n"
+"            -m|--model FILE    Energy model description\n"
+"            -n|--no-margin     Do not bias towards prev_cpu\n"
+"            -v|--verbose       Show every replayed decision\n"
+"            -h|--help          Show this usage message\n");
+}
+
+static const struct option opts[] = {
+	{ "model",	1, NULL, 'm' },
+	{ "no-margin",	0, NULL, 'n' },
+	{ "verbose",	0, NULL, 'v' },
+	{ "help",	0, NULL, 'h' },
+	{ NULL,		0, NULL, 0 }
+};
+
+int main(int argc, char *argv[])
+{
+	struct replay_stats recorded = { 0 }, replayed = { 0 };
+	const char *model = NULL;
+	int c;
+
+	while ((c = getopt_long(argc, argv, "m:nvh", opts, NULL)) != -1) {
+		switch (c) {
+		case 'm':
+			model = optarg;
+			break;
+		case 'n':
+			opt_margin = 0;
+			break;
+		case 'v':
+			opt_verbose = 1;
+			break;
+		case 'h':
+			usage();
+			return 0;
+		default:
+			usage();
+			return 1;
+		}
+	}
+
+	if (!model || optind == argc) {
+		usage();
+		return 1;
+	}
+
+	parse_model(model);
+	for (; optind < argc; optind++)
+		replay_file(argv[optind], &recorded, &replayed);
+
+	printf("records %lu skipped %lu differ %lu\n", recorded.records,
+	       recorded.skipped, replayed.differ);
+	show_stats("recorded", &recorded);
+	show_stats("replayed", &replayed);
+
+	return 0;
+}